@@ -27,6 +27,7 @@ using CryptoPP::StringStore;
 
 #include "Zerocash.h"
 #include "Address.h"
+#include "PRF.h"
 
 namespace libzerocash {
 
@@ -39,18 +40,7 @@ PublicAddress::PublicAddress(const std::vector<unsigned char>& a_sk, const std::
 }
 
 void PublicAddress::createPublicAddress(const std::vector<unsigned char>& a_sk, const std::string sk_enc) {
-    std::vector<bool> a_sk_bool(a_sk_size * 8);
-    convertBytesVectorToVector(a_sk, a_sk_bool);
-
-    std::vector<bool> zeros_256(256, 0);
-
-    std::vector<bool> a_pk_internal;
-    concatenateVectors(a_sk_bool, zeros_256, a_pk_internal);
-
-    std::vector<bool> a_pk_bool(a_pk_size * 8);
-    hashVector(a_pk_internal, a_pk_bool);
-
-    convertVectorToBytesVector(a_pk_bool, this->a_pk);
+    PRF(a_sk).addr(this->a_pk);
 
     ECIES<ECP>::PublicKey publicKey;
 
@@ -11,6 +11,8 @@
  * @copyright  MIT license (see LICENSE file)
  *****************************************************************************/
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 #include "Zerocash.h"
@@ -18,56 +20,133 @@
 
 namespace libzerocash {
 
-Coin::Coin(): addr_pk(), cm(), rho(rho_size), r(zc_r_size), coinValue(v_size) {
+Coin::Coin(): addr_pk(), cm(), rho(), r(), k(), coinValue() {
 
 }
 
-Coin::Coin(const PublicAddress& addr, uint64_t value): addr_pk(addr), cm(), rho(rho_size), r(zc_r_size), k(k_size), coinValue(v_size)
+Coin::Coin(const PublicAddress& addr, uint64_t value): addr_pk(addr), cm(), rho(), r(), k(), coinValue()
 {
-    convertIntToBytesVector(value, this->coinValue);
+    convertIntToBytes(value, this->coinValue.data(), v_size);
 
-    std::vector<unsigned char> a_pk = addr.getPublicAddressSecret();
+    getRandBytes(this->rho.data(), rho_size);
+    getRandBytes(this->r.data(), zc_r_size);
 
-    unsigned char rho_bytes[rho_size];
-    getRandBytes(rho_bytes, rho_size);
-    convertBytesToBytesVector(rho_bytes, this->rho);
-
-    unsigned char r_bytes[zc_r_size];
-    getRandBytes(r_bytes, zc_r_size);
-    convertBytesToBytesVector(r_bytes, this->r);
-
-	this->computeCommitments(a_pk);
+	this->computeCommitments(addr.getPublicAddressSecret());
 }
 
 
 Coin::Coin(const PublicAddress& addr, uint64_t value,
-		   const std::vector<unsigned char>& rho, const std::vector<unsigned char>& r): addr_pk(addr), rho(rho), r(r), k(k_size), coinValue(v_size)
+		   const std::vector<unsigned char>& rho, const std::vector<unsigned char>& r): addr_pk(addr), rho(rho), r(r), k(), coinValue()
 {
-    convertIntToBytesVector(value, this->coinValue);
-
-    std::vector<unsigned char> a_pk = addr.getPublicAddressSecret();
+    convertIntToBytes(value, this->coinValue.data(), v_size);
 
-	this->computeCommitments(a_pk);
+	this->computeCommitments(addr.getPublicAddressSecret());
 }
 
 void
-Coin::computeCommitments(std::vector<unsigned char>& a_pk)
+Coin::computeCommitments(const std::vector<unsigned char>& a_pk)
 {
-    std::vector<unsigned char> k_internal;
-    std::vector<unsigned char> k_internalhash_trunc(16);
+    HashSiteScope site(SHA256_SITE_COMMITMENT);
+    SHA256_CTX_mod ctx256;
 
-    std::vector<unsigned char> k_internalhash_internal;
-    concatenateVectors(a_pk, this->rho, k_internalhash_internal);
+    // k = H(r || H(a_pk || rho)[0..128])
+    unsigned char k_internalhash[k_size];
+    hashBytes(&ctx256, a_pk.data(), a_pk.size(), this->rho.data(), rho_size, k_internalhash);
+    hashBytes(&ctx256, this->r.data(), zc_r_size, k_internalhash, 16, this->k.data());
 
-    std::vector<unsigned char> k_internalhash(k_size);
-    hashVector(k_internalhash_internal, k_internalhash);
+    this->cm = CoinCommitment(this->coinValue, this->k);
+}
 
-    copy(k_internalhash.begin(), k_internalhash.begin()+16, k_internalhash_trunc.begin());
-    concatenateVectors(this->r, k_internalhash_trunc, k_internal);
-    hashVector(k_internal, this->k);
+void
+Coin::computeCommitments(const std::vector< std::vector<unsigned char> >& a_pks,
+                         const std::vector<CoinNonce>& rhos,
+                         const std::vector<CommitmentTrapdoor>& rs,
+                         const std::vector<uint64_t>& values,
+                         std::vector<InternalCommitment>& ks,
+                         std::vector<MerkleDigest>& cms)
+{
+    size_t count = a_pks.size();
+    if (rhos.size() != count || rs.size() != count || values.size() != count) {
+        throw std::runtime_error("Coin: one a_pk, rho, r and value are needed per coin");
+    }
+    for (size_t j = 0; j < count; j++) {
+        if (a_pks[j].size() != a_pk_size) {
+            throw std::runtime_error("Coin: a_pk is 32 bytes");
+        }
+    }
+
+    ks.resize(count);
+    cms.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    // Vectors of k and of leaves are contiguous arrays of hashes
+    static_assert(sizeof(InternalCommitment) == k_size, "InternalCommitment must hold its bytes only");
+    static_assert(sizeof(MerkleDigest) == cm_size, "MerkleDigest must hold its bytes only");
+
+    HashSiteScope site(SHA256_SITE_COMMITMENT);
+    std::vector<unsigned char> blocks(64 * count), hashes(SHA256_BLOCK_SIZE * count);
+
+    // H(a_pk || rho)
+    for (size_t j = 0; j < count; j++) {
+        unsigned char *block = &blocks[64 * j];
+        memcpy(block, a_pks[j].data(), a_pk_size);
+        memcpy(block + a_pk_size, rhos[j].data(), rho_size);
+    }
+    sha256_compress_blocks(blocks.data(), hashes.data(), count);
+
+    // k = H(r || H(a_pk || rho)[0..128])
+    for (size_t j = 0; j < count; j++) {
+        unsigned char *block = &blocks[64 * j];
+        memcpy(block, rs[j].data(), zc_r_size);
+        memcpy(block + zc_r_size, &hashes[SHA256_BLOCK_SIZE * j], 16);
+    }
+    sha256_compress_blocks(blocks.data(), ks[0].data(), count);
+
+    // cm = H(k || 0^192 || value)
+    for (size_t j = 0; j < count; j++) {
+        unsigned char *block = &blocks[64 * j];
+        memcpy(block, ks[j].data(), k_size);
+        memset(block + k_size, 0, 192 / 8);
+        convertIntToBytes(values[j], block + k_size + 192 / 8, v_size);
+    }
+    sha256_compress_blocks(blocks.data(), cms[0].data(), count);
+}
 
-    CoinCommitment com(this->coinValue, this->k);
-    this->cm = com;
+void
+Coin::createCoins(const std::vector<PublicAddress>& addrs,
+                  const std::vector<uint64_t>& values,
+                  std::vector<Coin>& coins,
+                  std::vector<MerkleDigest>& cms)
+{
+    size_t count = addrs.size();
+    if (values.size() != count) {
+        throw std::runtime_error("Coin: one value is needed per address");
+    }
+
+    std::vector< std::vector<unsigned char> > a_pks(count);
+    std::vector<CoinNonce> rhos(count);
+    std::vector<CommitmentTrapdoor> rs(count);
+    std::vector<InternalCommitment> ks;
+    for (size_t j = 0; j < count; j++) {
+        a_pks[j] = addrs[j].getPublicAddressSecret();
+        getRandBytes(rhos[j].data(), rho_size);
+        getRandBytes(rs[j].data(), zc_r_size);
+    }
+
+    computeCommitments(a_pks, rhos, rs, values, ks, cms);
+
+    coins.resize(count);
+    for (size_t j = 0; j < count; j++) {
+        Coin& c = coins[j];
+        c.addr_pk = addrs[j];
+        c.rho = rhos[j];
+        c.r = rs[j];
+        c.k = ks[j];
+        convertIntToBytes(values[j], c.coinValue.data(), v_size);
+        std::copy(cms[j].begin(), cms[j].end(), c.cm.commitmentValue.begin());
+    }
 }
 
 bool Coin::operator==(const Coin& rhs) const {
@@ -86,20 +165,20 @@ const CoinCommitment& Coin::getCoinCommitment() const {
 	return this->cm;
 }
 
-const std::vector<unsigned char>& Coin::getInternalCommitment() const {
+const InternalCommitment& Coin::getInternalCommitment() const {
 	return this->k;
 }
 
-const std::vector<unsigned char>& Coin::getRho() const {
+const CoinNonce& Coin::getRho() const {
     return this->rho;
 }
 
-const std::vector<unsigned char>& Coin::getR() const {
+const CommitmentTrapdoor& Coin::getR() const {
     return this->r;
 }
 
 uint64_t Coin::getValue() const {
-    return convertBytesVectorToInt(this->coinValue);
+    return convertBytesToInt(this->coinValue.data(), v_size);
 }
 
 } /* namespace libzerocash */
@@ -17,6 +17,8 @@
 #include "serialize.h"
 #include "Address.h"
 #include "CoinCommitment.h"
+#include "EmptySubtreeTable.h"
+#include "FixedBytes.h"
 
 namespace libzerocash {
 
@@ -45,6 +47,31 @@ public:
 
 	const CoinCommitment& getCoinCommitment() const;
 
+	/**
+	 * Computes the commitments of many coins at once. Coin j has value
+	 * 'values[j]', nonce 'rhos[j]' and trapdoor 'rs[j]' and belongs to the
+	 * address with a_pk 'a_pks[j]'. Every step of the commitment is a single
+	 * block, so each step hashes all the coins in one lane-parallel run.
+	 * 'cms' holds the commitments as tree leaves, in order.
+	 */
+	static void computeCommitments(const std::vector< std::vector<unsigned char> >& a_pks,
+	                               const std::vector<CoinNonce>& rhos,
+	                               const std::vector<CommitmentTrapdoor>& rs,
+	                               const std::vector<uint64_t>& values,
+	                               std::vector<InternalCommitment>& ks,
+	                               std::vector<MerkleDigest>& cms);
+
+	/**
+	 * Creates a fresh coin of value 'values[j]' for each address 'addrs[j]',
+	 * as the two argument constructor would, with all the commitments
+	 * computed together. 'cms' holds the commitments of 'coins', ready to
+	 * be appended to a tree.
+	 */
+	static void createCoins(const std::vector<PublicAddress>& addrs,
+	                        const std::vector<uint64_t>& values,
+	                        std::vector<Coin>& coins,
+	                        std::vector<MerkleDigest>& cms);
+
 	bool operator==(const Coin& rhs) const;
 	bool operator!=(const Coin& rhs) const;
 
@@ -61,17 +88,17 @@ public:
 private:
 	PublicAddress addr_pk;
     CoinCommitment cm;
-	std::vector<unsigned char> rho;
-    std::vector<unsigned char> r;
-	std::vector<unsigned char> k;
-	std::vector<unsigned char> coinValue;
+	CoinNonce rho;
+    CommitmentTrapdoor r;
+	InternalCommitment k;
+	ValueBytes coinValue;
 
-	const std::vector<unsigned char>& getInternalCommitment() const;
+	const InternalCommitment& getInternalCommitment() const;
 
-    const std::vector<unsigned char>& getRho() const;
+    const CoinNonce& getRho() const;
 
-    const std::vector<unsigned char>& getR() const;
-    void computeCommitments(std::vector<unsigned char>& a_pk);
+    const CommitmentTrapdoor& getR() const;
+    void computeCommitments(const std::vector<unsigned char>& a_pk);
 
 	uint64_t getValue() const;
 };
@@ -11,6 +11,7 @@
  * @copyright  MIT license (see LICENSE file)
  *****************************************************************************/
 
+#include <algorithm>
 #include <stdexcept>
 #include <stdint.h>
 
@@ -19,11 +20,16 @@
 
 namespace libzerocash {
 
-CoinCommitment::CoinCommitment() : commitmentValue(cm_size)
+CoinCommitment::CoinCommitment() : commitmentValue()
 { }
 
 CoinCommitment::CoinCommitment(const std::vector<unsigned char>& val,
-                               const std::vector<unsigned char>& k) : commitmentValue(cm_size)
+                               const std::vector<unsigned char>& k) : commitmentValue()
+{
+	this->constructCommitment(val, k);
+}
+
+CoinCommitment::CoinCommitment(const ValueBytes& val, const InternalCommitment& k) : commitmentValue()
 {
 	this->constructCommitment(val, k);
 }
@@ -46,8 +52,21 @@ CoinCommitment::constructCommitment(const std::vector<unsigned char>& val,
 
     libzerocash::concatenateVectors(k_bool, zeros_192, value_bool, cm_internal);
     std::vector<bool> cm_bool(cm_size * 8);
+    HashSiteScope site(SHA256_SITE_COMMITMENT);
     libzerocash::hashVector(cm_internal, cm_bool);
-    libzerocash::convertVectorToBytesVector(cm_bool, this->commitmentValue);
+    libzerocash::convertVectorToBytes(cm_bool, this->commitmentValue.data());
+}
+
+void
+CoinCommitment::constructCommitment(const ValueBytes& val, const InternalCommitment& k)
+{
+    // k || 0^192 || val is exactly one block
+    unsigned char padded_val[192 / 8 + v_size] = {0};
+    std::copy(val.begin(), val.end(), padded_val + 192 / 8);
+
+    HashSiteScope site(SHA256_SITE_COMMITMENT);
+    SHA256_CTX_mod ctx256;
+    libzerocash::hashBytes(&ctx256, k.data(), k_size, padded_val, sizeof(padded_val), this->commitmentValue.data());
 }
 
 bool CoinCommitment::operator==(const CoinCommitment& rhs) const {
@@ -58,7 +77,7 @@ bool CoinCommitment::operator!=(const CoinCommitment& rhs) const {
 	return !(*this == rhs);
 }
 
-const std::vector<unsigned char>& CoinCommitment::getCommitmentValue() const {
+const CommitmentValue& CoinCommitment::getCommitmentValue() const {
     return this->commitmentValue;
 }
 
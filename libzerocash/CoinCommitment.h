@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "serialize.h"
+#include "FixedBytes.h"
 
 namespace libzerocash {
 
@@ -22,6 +23,7 @@ namespace libzerocash {
 
 class CoinCommitment {
 
+friend class Coin;
 friend class PourTransaction;
 
 public:
@@ -30,10 +32,14 @@ public:
 	CoinCommitment(const std::vector<unsigned char>& val,
                    const std::vector<unsigned char>& k);
 
+	CoinCommitment(const ValueBytes& val, const InternalCommitment& k);
+
 	void constructCommitment(const std::vector<unsigned char>& val,
                              const std::vector<unsigned char>& k);
 
-    const std::vector<unsigned char>& getCommitmentValue() const;
+	void constructCommitment(const ValueBytes& val, const InternalCommitment& k);
+
+    const CommitmentValue& getCommitmentValue() const;
 
 	bool operator==(const CoinCommitment& rhs) const;
 	bool operator!=(const CoinCommitment& rhs) const;
@@ -44,7 +50,7 @@ public:
 	)
 
 private:
-    std::vector<unsigned char> commitmentValue;
+    CommitmentValue commitmentValue;
 };
 
 } /* namespace libzerocash */
@@ -0,0 +1,109 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class CommitmentIndex.
+
+ See CommitmentIndex.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "CommitmentIndex.h"
+
+namespace libzerocash {
+
+// The table is kept at most half full, and its size is a power of two.
+#define COMMITMENT_INDEX_MIN_SLOTS  16
+
+CommitmentIndex::CommitmentIndex(size_t expectedSize) : count(0)
+{
+    this->reserve(expectedSize);
+}
+
+void
+CommitmentIndex::clear()
+{
+    this->slots.clear();
+    this->count = 0;
+}
+
+void
+CommitmentIndex::reserve(size_t expectedSize)
+{
+    size_t numSlots = COMMITMENT_INDEX_MIN_SLOTS;
+    while (numSlots < 2 * expectedSize) {
+        numSlots *= 2;
+    }
+
+    if (numSlots > this->slots.size()) {
+        this->rehash(numSlots);
+    }
+}
+
+// Returns the slot holding 'commitment', or the empty slot where it belongs.
+size_t
+CommitmentIndex::slotFor(const MerkleDigest &commitment) const
+{
+    size_t mask = this->slots.size() - 1;
+    size_t i = MerkleDigestHasher()(commitment) & mask;
+
+    while (this->slots[i].value != 0 && this->slots[i].key != commitment) {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+void
+CommitmentIndex::rehash(size_t numSlots)
+{
+    std::vector<Slot> old;
+    old.swap(this->slots);
+
+    Slot empty;
+    empty.key.fill(0);
+    empty.value = 0;
+    this->slots.assign(numSlots, empty);
+
+    for (size_t i = 0; i < old.size(); i++) {
+        if (old[i].value != 0) {
+            this->slots[this->slotFor(old[i].key)] = old[i];
+        }
+    }
+}
+
+void
+CommitmentIndex::insert(const MerkleDigest &commitment, uint64_t position)
+{
+    if (2 * (this->count + 1) > this->slots.size()) {
+        this->rehash(this->slots.empty() ? COMMITMENT_INDEX_MIN_SLOTS : 2 * this->slots.size());
+    }
+
+    Slot &slot = this->slots[this->slotFor(commitment)];
+    if (slot.value == 0) {
+        slot.key = commitment;
+        this->count++;
+    }
+    slot.value = position + 1;
+}
+
+bool
+CommitmentIndex::find(const MerkleDigest &commitment, uint64_t &position) const
+{
+    if (this->slots.empty()) {
+        return false;
+    }
+
+    const Slot &slot = this->slots[this->slotFor(commitment)];
+    if (slot.value == 0) {
+        return false;
+    }
+
+    position = slot.value - 1;
+    return true;
+}
+
+} /* namespace libzerocash */
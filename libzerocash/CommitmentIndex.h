@@ -0,0 +1,59 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class CommitmentIndex.
+
+ CommitmentIndex maps 32-byte coin commitments to their leaf position. It is
+ an open-addressing hash table with linear probing. Commitments are
+ uniformly distributed, so their first eight bytes serve as the hash.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef COMMITMENTINDEX_H_
+#define COMMITMENTINDEX_H_
+
+#include "EmptySubtreeTable.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace libzerocash {
+
+/**************************** Commitment index *******************************/
+
+class CommitmentIndex {
+public:
+    CommitmentIndex(size_t expectedSize = 0);
+
+    // Maps 'commitment' to 'position', replacing any previous mapping.
+    void insert(const MerkleDigest &commitment, uint64_t position);
+
+    // Returns false if 'commitment' is not in the index.
+    bool find(const MerkleDigest &commitment, uint64_t &position) const;
+
+    // Makes room for 'expectedSize' commitments without rehashing.
+    void reserve(size_t expectedSize);
+
+    size_t size() const { return count; }
+    void clear();
+
+private:
+    struct Slot {
+        MerkleDigest key;
+        uint64_t value;         // position + 1; 0 marks an empty slot
+    };
+
+    std::vector<Slot> slots;
+    size_t count;
+
+    size_t slotFor(const MerkleDigest &commitment) const;
+    void rehash(size_t numSlots);
+};
+
+} /* namespace libzerocash */
+
+#endif /* COMMITMENTINDEX_H_ */
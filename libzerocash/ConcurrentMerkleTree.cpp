@@ -0,0 +1,294 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class ConcurrentMerkleTree.
+
+ See ConcurrentMerkleTree.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "ConcurrentMerkleTree.h"
+#include "FlatMerkleTree.h"
+#include "MerkleTreeBuilder.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace libzerocash {
+
+    // Shift helper: positions are 64-bit but trees may be taller than 64 levels.
+    static inline uint64_t shiftRight(uint64_t value, uint32_t bits) {
+        return (bits >= 64) ? 0 : (value >> bits);
+    }
+
+    // Hashes the nodes lo ... hi of a level from the populated nodes of the
+    // level below. Missing right children are empty subtrees.
+    static void hashRange(const std::vector<MerkleDigest> &below, std::vector<MerkleDigest> &above,
+                          uint64_t lo, uint64_t hi, const MerkleDigest &empty)
+    {
+        if (above.size() < hi + 1) {
+            above.resize(hi + 1);
+        }
+
+        uint64_t full = (2 * hi + 1 < below.size()) ? hi + 1 : hi;
+        if (full > lo) {
+            hashMerklePairs(&below[2 * lo], full - lo, &above[lo], EmptySubtreeTable::ZERO_SENTINEL);
+        }
+        if (full == hi) {
+            FlatMerkleTree::hashNode(below[2 * hi], empty, above[hi]);
+        }
+    }
+
+    /////////////////////////////////////////////
+    // ConcurrentMerkleTree::Snapshot class
+    /////////////////////////////////////////////
+
+    uint64_t
+    ConcurrentMerkleTree::Snapshot::levelCount(uint32_t level) const
+    {
+        if (this->numLeaves == 0) {
+            return 0;
+        }
+        return shiftRight(this->numLeaves - 1, level) + 1;
+    }
+
+    const MerkleDigest&
+    ConcurrentMerkleTree::Snapshot::getNode(uint32_t level, uint64_t index) const
+    {
+        if (index >= this->levelCount(level)) {
+            return this->emptySubtrees->digest(level);
+        }
+
+        if (level >= this->shardHeight) {
+            return this->upper[level - this->shardHeight][index];
+        }
+
+        uint32_t shift = this->shardHeight - level;
+        const Shard &shard = *this->shards[index >> shift];
+        return shard.levels[level][index & ((uint64_t(1) << shift) - 1)];
+    }
+
+    void
+    ConcurrentMerkleTree::Snapshot::getRoot(MerkleDigest &r) const
+    {
+        r = this->getNode(this->treeHeight, 0);
+    }
+
+    bool
+    ConcurrentMerkleTree::Snapshot::getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const
+    {
+        if (position >= this->numLeaves) {
+            return false;
+        }
+
+        witness.resize(this->treeHeight);
+        for (uint32_t depth = 0; depth < this->treeHeight; depth++) {
+            uint32_t level = this->treeHeight - 1 - depth;
+            witness[depth] = this->getNode(level, shiftRight(position, level) ^ 1);
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////
+    // ConcurrentMerkleTree::ReadGuard class
+    /////////////////////////////////////////////
+
+    ConcurrentMerkleTree::ReadGuard::ReadGuard(const ConcurrentMerkleTree &tree) : slot(NULL), snapshot(NULL)
+    {
+        // Claim a free slot, starting at one picked by the thread id so that
+        // concurrent readers rarely compete for the same slot.
+        size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+        for (size_t attempt = 0; this->slot == NULL; attempt++) {
+            std::atomic<uint64_t> &candidate = tree.readerSlots[(start + attempt) % CONCURRENT_MERKLE_READER_SLOTS].epoch;
+            uint64_t expected = 0;
+
+            if (candidate.load(std::memory_order_relaxed) == 0 &&
+                candidate.compare_exchange_strong(expected, tree.globalEpoch.load())) {
+                this->slot = &candidate;
+            } else if ((attempt + 1) % CONCURRENT_MERKLE_READER_SLOTS == 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        // The snapshot is loaded after the slot is published, so the writer
+        // either sees this reader or has already swapped in a newer snapshot.
+        this->snapshot = tree.current.load();
+    }
+
+    ConcurrentMerkleTree::ReadGuard::~ReadGuard()
+    {
+        this->slot->store(0, std::memory_order_release);
+    }
+
+    /////////////////////////////////////////////
+    // ConcurrentMerkleTree class
+    /////////////////////////////////////////////
+
+    ConcurrentMerkleTree::ConcurrentMerkleTree(uint32_t height, uint32_t shardHeight, ThreadPool &pool) :
+                treeHeight(height), shardHeight(std::min(std::min(shardHeight, height), 63u)), pool(pool),
+                current(NULL), globalEpoch(1)
+    {
+        for (size_t i = 0; i < CONCURRENT_MERKLE_READER_SLOTS; i++) {
+            this->readerSlots[i].epoch.store(0);
+        }
+
+        Snapshot *empty = new Snapshot();
+        empty->version = 0;
+        empty->numLeaves = 0;
+        empty->treeHeight = this->treeHeight;
+        empty->shardHeight = this->shardHeight;
+        empty->emptySubtrees = &EmptySubtreeTable::get(this->treeHeight, EmptySubtreeTable::ZERO_SENTINEL);
+        empty->upper.resize(this->treeHeight - this->shardHeight + 1);
+
+        this->current.store(empty);
+    }
+
+    ConcurrentMerkleTree::~ConcurrentMerkleTree()
+    {
+        // No reader may be active any more
+        delete this->current.load();
+        for (size_t i = 0; i < this->retired.size(); i++) {
+            delete this->retired[i].first;
+        }
+    }
+
+    bool
+    ConcurrentMerkleTree::append(const MerkleDigest &leaf, uint64_t &position)
+    {
+        return this->appendBatch(std::vector<MerkleDigest>(1, leaf), position);
+    }
+
+    bool
+    ConcurrentMerkleTree::appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition)
+    {
+        // Only the writer replaces the current snapshot, so it stays valid here
+        const Snapshot *prev = this->current.load();
+
+        firstPosition = prev->numLeaves;
+        if (leaves.empty()) {
+            return true;
+        }
+
+        uint64_t capacity = (this->treeHeight >= 64) ? UINT64_MAX : (uint64_t(1) << this->treeHeight);
+        if (leaves.size() > capacity - prev->numLeaves) {
+            return false;
+        }
+
+        // The copy shares every shard with the previous version
+        std::unique_ptr<Snapshot> next(new Snapshot(*prev));
+        next->version = prev->version + 1;
+        next->numLeaves += leaves.size();
+
+        const EmptySubtreeTable &empty = *next->emptySubtrees;
+        uint32_t shardHeight = this->shardHeight;
+        uint64_t shardSize = uint64_t(1) << shardHeight;
+        uint64_t first = firstPosition, last = firstPosition + leaves.size() - 1;
+        uint64_t firstShard = first >> shardHeight, lastShard = last >> shardHeight;
+
+        next->shards.resize(lastShard + 1);
+
+        // Touched shards are copied (or created), filled and rehashed independently
+        this->pool.parallelFor(firstShard, lastShard + 1, 1, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; s++) {
+                std::shared_ptr<Snapshot::Shard> shard;
+                if (s < prev->shards.size()) {
+                    shard = std::make_shared<Snapshot::Shard>(*prev->shards[s]);
+                } else {
+                    shard = std::make_shared<Snapshot::Shard>();
+                    shard->levels.resize(shardHeight + 1);
+                }
+
+                uint64_t base = uint64_t(s) << shardHeight;
+                uint64_t lo = std::max(first, base) - base;
+                uint64_t hi = std::min(last, base + shardSize - 1) - base;
+
+                shard->levels[0].resize(hi + 1);
+                std::copy(leaves.begin() + (base + lo - first), leaves.begin() + (base + hi - first) + 1,
+                          shard->levels[0].begin() + lo);
+
+                for (uint32_t level = 1; level <= shardHeight; level++) {
+                    hashRange(shard->levels[level - 1], shard->levels[level],
+                              lo >> level, hi >> level, empty.digest(level - 1));
+                }
+
+                next->shards[s] = shard;
+            }
+        });
+
+        // Then the levels above the shards
+        next->upper[0].resize(lastShard + 1);
+        for (uint64_t s = firstShard; s <= lastShard; s++) {
+            next->upper[0][s] = next->shards[s]->levels[shardHeight][0];
+        }
+        for (uint32_t k = 1; k < next->upper.size(); k++) {
+            hashRange(next->upper[k - 1], next->upper[k], shiftRight(firstShard, k), shiftRight(lastShard, k),
+                      empty.digest(shardHeight + k - 1));
+        }
+
+        this->publish(next.release());
+        return true;
+    }
+
+    void
+    ConcurrentMerkleTree::publish(const Snapshot *next)
+    {
+        // A reader that still holds the old snapshot entered before this
+        // epoch began, so its slot shows an epoch older than 'retiredAt'.
+        const Snapshot *old = this->current.exchange(next);
+        uint64_t retiredAt = this->globalEpoch.fetch_add(1) + 1;
+
+        this->retired.push_back(std::make_pair(old, retiredAt));
+        this->reclaim();
+    }
+
+    void
+    ConcurrentMerkleTree::reclaim()
+    {
+        uint64_t oldestReader = UINT64_MAX;
+        for (size_t i = 0; i < CONCURRENT_MERKLE_READER_SLOTS; i++) {
+            uint64_t epoch = this->readerSlots[i].epoch.load();
+            if (epoch != 0) {
+                oldestReader = std::min(oldestReader, epoch);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < this->retired.size(); i++) {
+            if (this->retired[i].second <= oldestReader) {
+                delete this->retired[i].first;
+            } else {
+                this->retired[kept++] = this->retired[i];
+            }
+        }
+        this->retired.resize(kept);
+    }
+
+    uint64_t
+    ConcurrentMerkleTree::size() const
+    {
+        ReadGuard guard(*this);
+        return guard->size();
+    }
+
+    void
+    ConcurrentMerkleTree::getRoot(MerkleDigest &r) const
+    {
+        ReadGuard guard(*this);
+        guard->getRoot(r);
+    }
+
+    bool
+    ConcurrentMerkleTree::getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const
+    {
+        ReadGuard guard(*this);
+        return guard->getWitness(position, witness);
+    }
+
+} /* namespace libzerocash */
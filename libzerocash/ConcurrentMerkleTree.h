@@ -0,0 +1,158 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class ConcurrentMerkleTree.
+
+ ConcurrentMerkleTree is an append-only Merkle tree (same roots and
+ witnesses as FlatMerkleTree) that one writer thread updates while any
+ number of reader threads query it.
+
+ The leaves are split into shards of 2^shardHeight leaves. A shard holds
+ every level of its subtree and is immutable once published. The levels
+ above the shards are small and are copied on every update. Each batch
+ produces a new Snapshot that shares the untouched shards with the
+ previous one, and is published with a single atomic pointer swap.
+
+ Readers pin the current snapshot with a ReadGuard, which takes no lock.
+ Replaced snapshots are reclaimed by the writer once no reader that could
+ have seen them is still active (epoch-based reclamation).
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef CONCURRENTMERKLETREE_H_
+#define CONCURRENTMERKLETREE_H_
+
+#include "Zerocash.h"
+#include "EmptySubtreeTable.h"
+#include "IncrementalMerkleTree.h"
+#include "utils/ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#define CONCURRENT_MERKLE_SHARD_HEIGHT 10
+#define CONCURRENT_MERKLE_READER_SLOTS 64
+
+namespace libzerocash {
+
+/************************* Concurrent Merkle tree ****************************/
+
+class ConcurrentMerkleTree {
+public:
+    // One immutable version of the tree.
+    class Snapshot {
+    public:
+        uint64_t getVersion() const { return version; }
+        uint64_t size() const { return numLeaves; }
+
+        void getRoot(MerkleDigest &r) const;
+
+        // Fills 'witness' with the authentication path of the leaf at 'position',
+        // ordered from the root downwards, as FlatMerkleTree::getWitness does.
+        // Returns false if the leaf does not exist in this snapshot.
+        bool getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const;
+
+    private:
+        friend class ConcurrentMerkleTree;
+
+        struct Shard {
+            // levels[l] holds the populated nodes of level l of the shard subtree.
+            std::vector< std::vector<MerkleDigest> > levels;
+        };
+
+        uint64_t version;
+        uint64_t numLeaves;
+        uint32_t treeHeight;
+        uint32_t shardHeight;
+        const EmptySubtreeTable *emptySubtrees;
+
+        std::vector< std::shared_ptr<const Shard> > shards;
+
+        // upper[k] holds the populated nodes of level shardHeight + k;
+        // upper[0] are the shard roots.
+        std::vector< std::vector<MerkleDigest> > upper;
+
+        uint64_t levelCount(uint32_t level) const;
+        const MerkleDigest& getNode(uint32_t level, uint64_t index) const;
+    };
+
+    // Pins the snapshot that is current when it is created, for as long as
+    // it lives. Never blocks the writer. Must not outlive the tree.
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ConcurrentMerkleTree &tree);
+        ~ReadGuard();
+
+        const Snapshot& operator*() const { return *snapshot; }
+        const Snapshot* operator->() const { return snapshot; }
+
+    private:
+        ReadGuard(const ReadGuard&);
+        ReadGuard& operator=(const ReadGuard&);
+
+        std::atomic<uint64_t> *slot;
+        const Snapshot *snapshot;
+    };
+
+    ConcurrentMerkleTree(uint32_t height = ZEROCASH_DEFAULT_TREE_SIZE,
+                         uint32_t shardHeight = CONCURRENT_MERKLE_SHARD_HEIGHT,
+                         ThreadPool &pool = ThreadPool::getDefault());
+    ~ConcurrentMerkleTree();
+
+    // Writer interface. Only one thread may call these at a time.
+
+    // Appends a leaf and publishes the new version.
+    bool append(const MerkleDigest &leaf, uint64_t &position);
+
+    // Appends all leaves, hashing the touched shards in parallel, and then
+    // publishes a single new version. The leaves get consecutive positions
+    // starting at 'firstPosition'. Returns false (and appends nothing) if
+    // they do not fit.
+    bool appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition);
+
+    // Number of replaced snapshots still waiting for readers to finish.
+    size_t numRetiredSnapshots() const { return retired.size(); }
+
+    // Reader interface. Each call pins the current snapshot for its duration;
+    // use a ReadGuard to run several queries against the same version.
+    uint64_t size() const;
+    void getRoot(MerkleDigest &r) const;
+    bool getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const;
+
+    uint32_t getHeight() const { return treeHeight; }
+
+private:
+    ConcurrentMerkleTree(const ConcurrentMerkleTree&);
+    ConcurrentMerkleTree& operator=(const ConcurrentMerkleTree&);
+
+    // The epoch a reader entered in, or 0 for a free slot. Padded to a cache
+    // line so that readers on different slots do not contend.
+    struct ReaderSlot {
+        alignas(64) std::atomic<uint64_t> epoch;
+    };
+
+    uint32_t treeHeight;
+    uint32_t shardHeight;
+    ThreadPool &pool;
+
+    std::atomic<const Snapshot*> current;
+    std::atomic<uint64_t> globalEpoch;
+    mutable ReaderSlot readerSlots[CONCURRENT_MERKLE_READER_SLOTS];
+
+    // Replaced snapshots and the epoch they were retired in (writer only)
+    std::vector< std::pair<const Snapshot*, uint64_t> > retired;
+
+    void publish(const Snapshot *next);
+    void reclaim();
+};
+
+} /* namespace libzerocash */
+
+#endif /* CONCURRENTMERKLETREE_H_ */
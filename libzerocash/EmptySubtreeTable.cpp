@@ -0,0 +1,62 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class EmptySubtreeTable.
+
+ See EmptySubtreeTable.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "EmptySubtreeTable.h"
+#include "utils/util.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace libzerocash {
+
+EmptySubtreeTable::EmptySubtreeTable(uint32_t height, Convention convention) : height(height),
+            digests(height + 1), digestsBits(height + 1)
+{
+    HashSiteScope site(SHA256_SITE_TREE);
+
+    digests[0].fill(0);
+    for (uint32_t level = 1; level <= height; level++) {
+        if (convention == ZERO_SENTINEL) {
+            digests[level].fill(0);
+        } else {
+            sha256_two_to_one(digests[level - 1].data(), digests[level - 1].data(), digests[level].data());
+        }
+    }
+
+    for (uint32_t level = 0; level <= height; level++) {
+        digestsBits[level].resize(SHA256_BLOCK_SIZE * 8);
+        convertBytesToVector(digests[level].data(), digestsBits[level]);
+    }
+}
+
+const EmptySubtreeTable&
+EmptySubtreeTable::get(uint32_t height, Convention convention)
+{
+    typedef std::map< std::pair<uint32_t, Convention>, std::unique_ptr<EmptySubtreeTable> > TableMap;
+
+    static std::mutex tablesMutex;
+    static TableMap tables;
+
+    std::lock_guard<std::mutex> lock(tablesMutex);
+
+    std::unique_ptr<EmptySubtreeTable> &table = tables[std::make_pair(height, convention)];
+    if (!table) {
+        table.reset(new EmptySubtreeTable(height, convention));
+    }
+
+    return *table;
+}
+
+} /* namespace libzerocash */
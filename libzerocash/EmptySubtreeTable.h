@@ -0,0 +1,77 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class EmptySubtreeTable.
+
+ An EmptySubtreeTable holds the digest of an empty subtree for every level
+ of a Merkle tree of a given height (level 0 is a leaf, level 'height' is
+ the root). Tables are computed once per (height, convention) pair and
+ shared by every tree instance, so trees never rehash empty subtrees.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef EMPTYSUBTREETABLE_H_
+#define EMPTYSUBTREETABLE_H_
+
+#include "utils/sha256.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+namespace libzerocash {
+
+typedef std::array<uint8_t, SHA256_BLOCK_SIZE> MerkleDigest;
+
+// Hash-table hasher for digests. They are already uniformly distributed,
+// so the first eight bytes are used as is.
+struct MerkleDigestHasher {
+    size_t operator()(const MerkleDigest &d) const {
+        uint64_t prefix;
+        memcpy(&prefix, d.data(), sizeof(prefix));
+        return (size_t)prefix;
+    }
+};
+
+/************************** Empty subtree table ******************************/
+
+class EmptySubtreeTable {
+public:
+    enum Convention {
+        // The hash of two empty children is itself empty (all-zero). Used by
+        // IncrementalMerkleTree and FlatMerkleTree.
+        ZERO_SENTINEL,
+
+        // Empty leaves are all-zero and are hashed like any other node. Used
+        // for the padding subtrees of MerkleTree.
+        HASHED
+    };
+
+    // Returns the shared table for the given height and convention, computing
+    // it on first use. The returned reference stays valid for the lifetime of
+    // the program. Thread safe.
+    static const EmptySubtreeTable& get(uint32_t height, Convention convention);
+
+    uint32_t getHeight() const { return height; }
+
+    const MerkleDigest& digest(uint32_t level) const { return digests.at(level); }
+    const std::vector<bool>& digestBits(uint32_t level) const { return digestsBits.at(level); }
+
+private:
+    EmptySubtreeTable(uint32_t height, Convention convention);
+    EmptySubtreeTable(const EmptySubtreeTable&);
+    EmptySubtreeTable& operator=(const EmptySubtreeTable&);
+
+    uint32_t height;
+    std::vector<MerkleDigest> digests;
+    std::vector< std::vector<bool> > digestsBits;
+};
+
+} /* namespace libzerocash */
+
+#endif /* EMPTYSUBTREETABLE_H_ */
@@ -0,0 +1,105 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of the class template FixedBytes and the field types built on it.
+
+ FixedBytes<N, Tag> is N bytes held inline, so objects made of them need no
+ heap allocations. The tag keeps fields of the same size apart, e.g. a serial
+ number cannot be passed where a coin commitment is expected.
+
+ A FixedBytes serializes exactly as a std::vector<unsigned char> of N bytes
+ (a compact size followed by the bytes), so the wire and file formats of the
+ classes that use it are unchanged. Unserializing a different length fails.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef FIXEDBYTES_H_
+#define FIXEDBYTES_H_
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+#include <stddef.h>
+
+#include "serialize.h"
+#include "Zerocash.h"
+
+namespace libzerocash {
+
+/******************************* Fixed bytes *********************************/
+
+template<size_t N, typename Tag>
+class FixedBytes {
+public:
+    FixedBytes() { bytes.fill(0); }
+
+    // Throws if 'v' is not N bytes long
+    explicit FixedBytes(const std::vector<unsigned char>& v) { assign(v); }
+
+    void assign(const std::vector<unsigned char>& v) {
+        if (v.size() != N) {
+            throw std::runtime_error("FixedBytes: wrong number of bytes");
+        }
+        std::copy(v.begin(), v.end(), bytes.begin());
+    }
+
+    std::vector<unsigned char> toVector() const { return std::vector<unsigned char>(bytes.begin(), bytes.end()); }
+
+    static size_t size() { return N; }
+
+    unsigned char* data() { return bytes.data(); }
+    const unsigned char* data() const { return bytes.data(); }
+
+    unsigned char* begin() { return bytes.data(); }
+    unsigned char* end() { return bytes.data() + N; }
+    const unsigned char* begin() const { return bytes.data(); }
+    const unsigned char* end() const { return bytes.data() + N; }
+
+    unsigned char& operator[](size_t i) { return bytes[i]; }
+    const unsigned char& operator[](size_t i) const { return bytes[i]; }
+
+    bool operator==(const FixedBytes& rhs) const { return bytes == rhs.bytes; }
+    bool operator!=(const FixedBytes& rhs) const { return bytes != rhs.bytes; }
+    bool operator<(const FixedBytes& rhs) const { return bytes < rhs.bytes; }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return GetSizeOfCompactSize(N) + N;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        WriteCompactSize(s, N);
+        s.write((const char*)bytes.data(), N);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        if (ReadCompactSize(s) != N) {
+            throw std::ios_base::failure("FixedBytes: wrong number of bytes");
+        }
+        s.read((char*)bytes.data(), N);
+    }
+
+private:
+    std::array<unsigned char, N> bytes;
+};
+
+/****************************** Field types **********************************/
+
+typedef FixedBytes<v_size, struct ValueTag>                     ValueBytes;          // a coin or public value
+typedef FixedBytes<rho_size, struct RhoTag>                     CoinNonce;           // rho
+typedef FixedBytes<zc_r_size, struct TrapdoorTag>               CommitmentTrapdoor;  // r
+typedef FixedBytes<k_size, struct InternalCommitmentTag>        InternalCommitment;  // k
+typedef FixedBytes<cm_size, struct CommitmentTag>               CommitmentValue;     // cm
+typedef FixedBytes<sn_size, struct SerialNumberTag>             SerialNumber;        // sn
+typedef FixedBytes<h_size, struct SignatureHashTag>             SignatureHash;       // h_S
+typedef FixedBytes<h_size, struct MACTag>                       PourMAC;             // h_1, h_2
+
+} /* namespace libzerocash */
+
+#endif /* FIXEDBYTES_H_ */
@@ -0,0 +1,596 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the classes FlatMerkleTree and
+ FlatIncrementalMerkleTree.
+
+ See FlatMerkleTree.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "FlatMerkleTree.h"
+#include "MerkleTreeBuilder.h"
+#include "Zerocash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace libzerocash {
+
+    // Shift helper: positions are 64-bit but trees may be taller than 64 levels.
+    static inline uint64_t shiftRight(uint64_t value, uint32_t bits) {
+        return (bits >= 64) ? 0 : (value >> bits);
+    }
+
+    /////////////////////////////////////////////
+    // FlatMerkleTree class
+    /////////////////////////////////////////////
+
+    FlatMerkleTree::FlatMerkleTree(uint32_t height) : treeHeight(height), numLeaves(0),
+                levels(height + 1), levelBase(height + 1, 0),
+                emptySubtrees(&EmptySubtreeTable::get(height, EmptySubtreeTable::ZERO_SENTINEL))
+    {
+    }
+
+    void
+    FlatMerkleTree::hashNode(const MerkleDigest &left, const MerkleDigest &right, MerkleDigest &out)
+    {
+        // The hash of (0 || 0) is 0, matching IncrementalMerkleNode::updateHashValue.
+        if (isZero(left) && isZero(right)) {
+            out.fill(0);
+            return;
+        }
+
+        HashSiteScope site(SHA256_SITE_TREE);
+        sha256_two_to_one(left.data(), right.data(), out.data());
+    }
+
+    bool
+    FlatMerkleTree::isZero(const MerkleDigest &d)
+    {
+        for (size_t i = 0; i < d.size(); i++) {
+            if (d[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool
+    FlatMerkleTree::isFull() const
+    {
+        if (this->treeHeight >= 64) {
+            return (this->numLeaves == UINT64_MAX);
+        }
+        return (this->numLeaves == (uint64_t(1) << this->treeHeight));
+    }
+
+    uint64_t
+    FlatMerkleTree::levelCount(uint32_t level) const
+    {
+        // Number of nodes on this level whose subtree holds at least one leaf.
+        if (this->numLeaves == 0) {
+            return 0;
+        }
+        return shiftRight(this->numLeaves - 1, level) + 1;
+    }
+
+    bool
+    FlatMerkleTree::getNode(uint32_t level, uint64_t index, MerkleDigest &out) const
+    {
+        // Nodes to the right of the frontier are empty subtrees.
+        if (index >= this->levelCount(level)) {
+            out = this->emptySubtrees->digest(level);
+            return true;
+        }
+
+        // Nodes to the left of the retained window have been pruned.
+        if (index < this->levelBase[level]) {
+            return false;
+        }
+
+        out = this->levels[level][index - this->levelBase[level]];
+        return true;
+    }
+
+    void
+    FlatMerkleTree::setNode(uint32_t level, uint64_t index, const MerkleDigest &value)
+    {
+        std::vector<MerkleDigest> &row = this->levels[level];
+        uint64_t offset = index - this->levelBase[level];
+
+        if (offset < row.size()) {
+            row[offset] = value;
+        } else {
+            row.push_back(value);
+        }
+    }
+
+    void
+    FlatMerkleTree::updateNode(uint32_t level, uint64_t index)
+    {
+        MerkleDigest left, right, hash;
+
+        // Both children are always retained for nodes on the frontier.
+        if (!this->getNode(level - 1, 2 * index, left) || !this->getNode(level - 1, 2 * index + 1, right)) {
+            throw std::logic_error("FlatMerkleTree: frontier node has been pruned");
+        }
+
+        hashNode(left, right, hash);
+        this->setNode(level, index, hash);
+    }
+
+    bool
+    FlatMerkleTree::append(const MerkleDigest &leaf, uint64_t &position)
+    {
+        if (this->isFull()) {
+            return false;
+        }
+
+        position = this->numLeaves++;
+        this->setNode(0, position, leaf);
+
+        // Recompute the path from the new leaf up to the root
+        for (uint32_t level = 1; level <= this->treeHeight; level++) {
+            this->updateNode(level, shiftRight(position, level));
+        }
+
+        return true;
+    }
+
+    bool
+    FlatMerkleTree::appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition)
+    {
+        if (leaves.empty()) {
+            firstPosition = this->numLeaves;
+            return true;
+        }
+
+        // Make sure every leaf fits before touching the tree
+        uint64_t capacity = (this->treeHeight >= 64) ? UINT64_MAX : (uint64_t(1) << this->treeHeight);
+        if (leaves.size() > capacity - this->numLeaves) {
+            return false;
+        }
+
+        firstPosition = this->numLeaves;
+        uint64_t last = firstPosition + leaves.size() - 1;
+
+        this->numLeaves += leaves.size();
+        for (size_t i = 0; i < leaves.size(); i++) {
+            this->setNode(0, firstPosition + i, leaves[i]);
+        }
+
+        // Each level only needs the parents of the range touched on the level below.
+        // Parents with both children present are hashed together; only the last
+        // one can have its right child missing.
+        for (uint32_t level = 1; level <= this->treeHeight; level++) {
+            uint64_t lo = shiftRight(firstPosition, level);
+            uint64_t hi = shiftRight(last, level);
+            const std::vector<MerkleDigest> &children = this->levels[level - 1];
+            std::vector<MerkleDigest> &parents = this->levels[level];
+            uint64_t childBase = this->levelBase[level - 1], parentBase = this->levelBase[level];
+
+            if (parents.size() < hi + 1 - parentBase) {
+                parents.resize(hi + 1 - parentBase);
+            }
+
+            uint64_t full = (2 * hi + 1 - childBase < children.size()) ? hi + 1 : hi;
+            if (full > lo) {
+                hashMerklePairs(&children[2 * lo - childBase], full - lo, &parents[lo - parentBase],
+                                EmptySubtreeTable::ZERO_SENTINEL);
+            }
+            if (full == hi) {
+                this->updateNode(level, hi);
+            }
+        }
+
+        return true;
+    }
+
+    bool
+    FlatMerkleTree::assign(const std::vector<MerkleDigest> &leaves, ThreadPool &pool)
+    {
+        uint64_t capacity = (this->treeHeight >= 64) ? UINT64_MAX : (uint64_t(1) << this->treeHeight);
+        if (leaves.size() > capacity) {
+            return false;
+        }
+
+        buildMerkleLevels(leaves, this->treeHeight, EmptySubtreeTable::ZERO_SENTINEL, pool, this->levels);
+        this->levelBase.assign(this->treeHeight + 1, 0);
+        this->numLeaves = leaves.size();
+
+        return true;
+    }
+
+    bool
+    FlatMerkleTree::getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const
+    {
+        if (position >= this->numLeaves) {
+            return false;
+        }
+
+        witness.resize(this->treeHeight);
+
+        // witness[depth] holds the sibling of the path node at depth + 1,
+        // which lives on level (treeHeight - 1 - depth).
+        for (uint32_t depth = 0; depth < this->treeHeight; depth++) {
+            uint32_t level = this->treeHeight - 1 - depth;
+            if (!this->getNode(level, shiftRight(position, level) ^ 1, witness.at(depth))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void
+    FlatMerkleTree::getRoot(MerkleDigest &r) const
+    {
+        if (!this->getNode(this->treeHeight, 0, r)) {
+            r.fill(0);
+        }
+    }
+
+    void
+    FlatMerkleTree::prune()
+    {
+        // On each level keep only the pair the next leaf will hash into:
+        // a completed left sibling (if any) and the partially filled node.
+        for (uint32_t level = 0; level <= this->treeHeight; level++) {
+            uint64_t newBase = shiftRight(this->numLeaves, level) & ~uint64_t(1);
+
+            if (newBase > this->levelBase[level]) {
+                std::vector<MerkleDigest> &row = this->levels[level];
+                uint64_t drop = std::min<uint64_t>(newBase - this->levelBase[level], row.size());
+
+                row.erase(row.begin(), row.begin() + drop);
+                std::vector<MerkleDigest>(row).swap(row);
+                this->levelBase[level] = newBase;
+            }
+        }
+    }
+
+    size_t
+    FlatMerkleTree::storedDigests() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < this->levels.size(); i++) {
+            total += this->levels[i].size();
+        }
+        return total;
+    }
+
+    void
+    FlatMerkleTree::getCompactRepresentation(IncrementalMerkleTreeCompact &rep) const
+    {
+        rep.clear();
+        rep.treeHeight = this->treeHeight;
+        rep.hashList.assign(this->treeHeight, false);
+
+        // Walk down the frontier exactly as IncrementalMerkleNode::getCompactRepresentation
+        // does: at every depth where the left child is full, record its hash and go right.
+        uint64_t base = 0;
+        for (uint32_t depth = 0; depth < this->treeHeight; depth++) {
+            uint32_t level = this->treeHeight - 1 - depth;
+            uint64_t remaining = this->numLeaves - base;
+
+            if (remaining == 0) {
+                break;
+            }
+
+            if (level < 64 && remaining >= (uint64_t(1) << level)) {
+                MerkleDigest left;
+                if (!this->getNode(level, shiftRight(base, level), left)) {
+                    throw std::logic_error("FlatMerkleTree: frontier node has been pruned");
+                }
+
+                rep.hashList.at(depth) = true;
+                rep.hashVec.push_back(std::vector<unsigned char>(left.begin(), left.end()));
+
+                if (remaining == (uint64_t(1) << level)) {
+                    break;
+                }
+                base += (uint64_t(1) << level);
+            }
+        }
+
+        // Convert the hashList into a bytesVector. First pad it to a multiple of 8 bits.
+        if (rep.hashList.size() % 8 != 0) {
+            rep.hashList.insert(rep.hashList.begin(), 8 - (rep.hashList.size() % 8), false);
+        }
+        rep.hashListBytes.resize(ceil(rep.hashList.size() / 8.0));
+        convertVectorToBytesVector(rep.hashList, rep.hashListBytes);
+    }
+
+    bool
+    FlatMerkleTree::fromCompactRepresentation(const IncrementalMerkleTreeCompact &rep)
+    {
+        uint32_t height = rep.treeHeight;
+
+        // The serialized form only carries hashListBytes. Keep its trailing 'height' bits.
+        std::vector<bool> hashList;
+        convertBytesVectorToVector(rep.hashListBytes, hashList);
+        if (hashList.size() > height) {
+            hashList.erase(hashList.begin(), hashList.begin() + (hashList.size() - height));
+        } else if (hashList.size() < height) {
+            hashList.insert(hashList.begin(), height - hashList.size(), false);
+        }
+
+        // Each set bit marks a full left subtree on the frontier.
+        uint64_t leaves = 0;
+        size_t numHashes = 0;
+        for (uint32_t depth = 0; depth < height; depth++) {
+            if (hashList.at(depth)) {
+                if (height - 1 - depth >= 64) {
+                    return false;
+                }
+                leaves += (uint64_t(1) << (height - 1 - depth));
+                numHashes++;
+            }
+        }
+
+        if (numHashes != rep.hashVec.size()) {
+            return false;
+        }
+
+        this->treeHeight = height;
+        this->numLeaves = leaves;
+        this->emptySubtrees = &EmptySubtreeTable::get(height, EmptySubtreeTable::ZERO_SENTINEL);
+        this->levels.assign(height + 1, std::vector<MerkleDigest>());
+        this->levelBase.resize(height + 1);
+        for (uint32_t level = 0; level <= height; level++) {
+            this->levelBase[level] = shiftRight(leaves, level);
+        }
+
+        size_t pos = 0;
+        for (uint32_t depth = 0; depth < height; depth++) {
+            if (hashList.at(depth)) {
+                uint32_t level = height - 1 - depth;
+                const std::vector<unsigned char> &hash = rep.hashVec.at(pos++);
+                if (hash.size() != SHA256_BLOCK_SIZE) {
+                    return false;
+                }
+
+                MerkleDigest digest;
+                std::copy(hash.begin(), hash.end(), digest.begin());
+                this->levelBase[level] = shiftRight(leaves, level) - 1;
+                this->levels[level].push_back(digest);
+            }
+        }
+
+        // Recompute the partially filled nodes on the frontier, bottom-up.
+        for (uint32_t level = 1; level <= height; level++) {
+            uint64_t mask = (level >= 64) ? UINT64_MAX : ((uint64_t(1) << level) - 1);
+            if ((leaves & mask) != 0) {
+                this->updateNode(level, shiftRight(leaves, level));
+            }
+        }
+
+        return true;
+    }
+
+    /////////////////////////////////////////////
+    // FlatIncrementalMerkleTree class
+    /////////////////////////////////////////////
+
+    // Converts a leaf position into the MSB-first index vector used by IncrementalMerkleTree.
+    static void positionToIndex(uint64_t position, uint32_t height, std::vector<bool> &index) {
+        index.resize(height);
+        for (uint32_t depth = 0; depth < height; depth++) {
+            index.at(depth) = (shiftRight(position, height - 1 - depth) & 1);
+        }
+    }
+
+    FlatIncrementalMerkleTree::FlatIncrementalMerkleTree(uint32_t height) : tree(height) {
+    }
+
+    FlatIncrementalMerkleTree::FlatIncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height,
+                                                         ThreadPool &pool) : tree(height)
+    {
+        // Build all levels at once in parallel when possible
+        std::vector<MerkleDigest> leaves;
+        if (convertVectorsToDigests(valueVector, leaves, pool) && this->tree.assign(leaves, pool)) {
+            return;
+        }
+
+        // Load the tree with all the given values
+        if (this->insertVector(valueVector) == false) {
+            throw std::runtime_error("Could not insert vector into Merkle Tree: too many elements");
+        }
+    }
+
+    FlatIncrementalMerkleTree::FlatIncrementalMerkleTree(IncrementalMerkleTreeCompact &compact) : tree(compact.getHeight())
+    {
+        // Reconstitute tree from compact representation
+        this->fromCompactRepresentation(compact);
+    }
+
+    bool
+    FlatIncrementalMerkleTree::insertElement(const std::vector<bool> &hashV, std::vector<bool> &index) {
+
+        if (hashV.size() != SHA256_BLOCK_SIZE * 8) {
+            return false;
+        }
+
+        MerkleDigest leaf;
+        convertVectorToBytes(hashV, leaf.data());
+
+        uint64_t position;
+        if (this->tree.append(leaf, position) == false) {
+            return false;
+        }
+
+        positionToIndex(position, this->tree.getHeight(), index);
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::insertElement(const std::vector<unsigned char> &hashV, std::vector<unsigned char> &index) {
+
+        if (hashV.size() != SHA256_BLOCK_SIZE) {
+            return false;
+        }
+
+        MerkleDigest leaf;
+        std::copy(hashV.begin(), hashV.end(), leaf.begin());
+
+        uint64_t position;
+        if (this->tree.append(leaf, position) == false) {
+            return false;
+        }
+
+        std::vector<bool> indexBool;
+        positionToIndex(position, this->tree.getHeight(), indexBool);
+
+        index.resize(ceil(indexBool.size() / 8.0));
+        convertVectorToBytesVector(indexBool, index);
+
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::insertElements(const std::vector< std::vector<bool> > &values, std::vector< std::vector<bool> > &indices)
+    {
+        std::vector<MerkleDigest> leaves(values.size());
+        uint64_t firstPosition;
+
+        indices.clear();
+
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i].size() != SHA256_BLOCK_SIZE * 8) {
+                return false;
+            }
+            convertVectorToBytes(values[i], leaves[i].data());
+        }
+
+        if (this->tree.appendBatch(leaves, firstPosition) == false) {
+            // Not enough room for all of them: insert as many as fit, one by one
+            std::vector<bool> index;
+            for (size_t i = 0; i < values.size(); i++) {
+                if (this->insertElement(values[i], index) == false) {
+                    return false;
+                }
+                indices.push_back(index);
+            }
+            return true;
+        }
+
+        indices.resize(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            positionToIndex(firstPosition + i, this->tree.getHeight(), indices[i]);
+        }
+
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::insertVector(std::vector< std::vector<bool> > &valueVector)
+    {
+        std::vector< std::vector<bool> > indices;
+
+        return this->insertElements(valueVector, indices);
+    }
+
+    bool
+    FlatIncrementalMerkleTree::getWitness(const std::vector<bool> &index, merkle_authentication_path &witness) {
+
+        uint32_t height = this->tree.getHeight();
+
+        // Resize the witness if necessary
+        if (witness.size() < height) {
+            witness.resize(height);
+        }
+
+        // Discard leading bits of the index, or pad the leftmost bits with 0,
+        // so that it is exactly 'height' bits long.
+        std::vector<bool> indexPadded = index;
+        if (indexPadded.size() > height) {
+            indexPadded.erase(indexPadded.begin(), indexPadded.begin() + (indexPadded.size() - height));
+        } else if (indexPadded.size() < height) {
+            indexPadded.insert(indexPadded.begin(), height - indexPadded.size(), false);
+        }
+
+        uint64_t position = 0;
+        for (uint32_t depth = 0; depth < height; depth++) {
+            if (indexPadded.at(depth)) {
+                if (height - 1 - depth >= 64) {
+                    return false;
+                }
+                position |= (uint64_t(1) << (height - 1 - depth));
+            }
+        }
+
+        std::vector<MerkleDigest> path;
+        if (this->tree.getWitness(position, path) == false) {
+            return false;
+        }
+
+        for (uint32_t depth = 0; depth < height; depth++) {
+            witness.at(depth).resize(SHA256_BLOCK_SIZE * 8);
+            convertBytesToVector(path.at(depth).data(), witness.at(depth));
+        }
+
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::getRootValue(std::vector<bool>& r) {
+
+        MerkleDigest root;
+        this->tree.getRoot(root);
+
+        r.resize(SHA256_BLOCK_SIZE * 8);
+        convertBytesToVector(root.data(), r);
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::getRootValue(std::vector<unsigned char>& r) {
+
+        MerkleDigest root;
+        this->tree.getRoot(root);
+
+        r.assign(root.begin(), root.end());
+        return true;
+    }
+
+    std::vector<unsigned char>
+    FlatIncrementalMerkleTree::getRoot(){
+        std::vector<unsigned char> temp(SHA256_BLOCK_SIZE);
+        this->getRootValue(temp);
+        return temp;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::prune()
+    {
+        this->tree.prune();
+        return true;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::getCompactRepresentation(IncrementalMerkleTreeCompact &rep)
+    {
+        this->tree.getCompactRepresentation(rep);
+        return true;
+    }
+
+    IncrementalMerkleTreeCompact FlatIncrementalMerkleTree::getCompactRepresentation(){
+        IncrementalMerkleTreeCompact rep;
+        this->getCompactRepresentation(rep);
+        return rep;
+    }
+
+    bool
+    FlatIncrementalMerkleTree::fromCompactRepresentation(IncrementalMerkleTreeCompact &rep)
+    {
+        return this->tree.fromCompactRepresentation(rep);
+    }
+
+} /* namespace libzerocash */
@@ -0,0 +1,136 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the classes FlatMerkleTree and
+ FlatIncrementalMerkleTree.
+
+ FlatMerkleTree is an array-backed engine for the incremental Merkle tree.
+ Each level of the tree is a contiguous array of 32-byte digests, so an
+ insert touches one digest per level instead of chasing heap-allocated
+ nodes. Pruning drops every filled subtree and keeps only the frontier.
+
+ FlatIncrementalMerkleTree wraps the engine behind the interface of
+ IncrementalMerkleTree (same roots, witnesses and compact representation),
+ so existing callers can switch engines without further changes.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef FLATMERKLETREE_H_
+#define FLATMERKLETREE_H_
+
+#include "utils/sha256.h"
+
+#include "Zerocash.h"
+#include "EmptySubtreeTable.h"
+#include "IncrementalMerkleTree.h"
+#include "utils/ThreadPool.h"
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+#include "libsnark/common/data_structures/merkle_tree.hpp"
+
+namespace libzerocash {
+
+/***************************** Flat Merkle tree ******************************/
+
+class FlatMerkleTree {
+public:
+    FlatMerkleTree(uint32_t height = ZEROCASH_DEFAULT_TREE_SIZE);
+
+    // Appends a leaf and returns its position (insertion order) in 'position'.
+    // Returns false if the tree is full.
+    bool append(const MerkleDigest &leaf, uint64_t &position);
+
+    // Appends all leaves, then rehashes every touched interior node once,
+    // level by level. The leaves get consecutive positions starting at
+    // 'firstPosition'. Returns false (and appends nothing) if they do not fit.
+    bool appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition);
+
+    // Replaces the contents of the tree with 'leaves', hashing each level in
+    // parallel on 'pool'. Returns false (and leaves the tree unchanged) if
+    // they do not fit.
+    bool assign(const std::vector<MerkleDigest> &leaves, ThreadPool &pool);
+
+    // Fills 'witness' with the authentication path of the leaf at 'position',
+    // ordered from the root downwards (witness[0] is the sibling just below the root).
+    // Returns false if the leaf does not exist or its path has been pruned.
+    bool getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const;
+
+    void getRoot(MerkleDigest &r) const;
+
+    // Drops every filled subtree; only the frontier needed for appends is kept.
+    void prune();
+
+    void getCompactRepresentation(IncrementalMerkleTreeCompact &rep) const;
+    bool fromCompactRepresentation(const IncrementalMerkleTreeCompact &rep);
+
+    uint32_t getHeight() const { return treeHeight; }
+    uint64_t size() const { return numLeaves; }
+    bool isFull() const;
+
+    // Number of digests currently held in memory (for memory accounting).
+    size_t storedDigests() const;
+
+    // The hash of an interior node. As in IncrementalMerkleNode, the hash of
+    // two all-zero children is defined to be all-zero.
+    static void hashNode(const MerkleDigest &left, const MerkleDigest &right, MerkleDigest &out);
+    static bool isZero(const MerkleDigest &d);
+
+protected:
+    uint32_t treeHeight;
+    uint64_t numLeaves;
+
+    // levels[0] holds the leaves and levels[treeHeight] the root. Level l
+    // holds the digests of nodes levelBase[l] ... levelBase[l] + levels[l].size() - 1;
+    // nodes before levelBase[l] have been pruned.
+    std::vector< std::vector<MerkleDigest> > levels;
+    std::vector<uint64_t> levelBase;
+
+    // Digests of empty subtrees, returned for nodes right of the frontier.
+    const EmptySubtreeTable *emptySubtrees;
+
+    uint64_t levelCount(uint32_t level) const;
+    bool getNode(uint32_t level, uint64_t index, MerkleDigest &out) const;
+    void setNode(uint32_t level, uint64_t index, const MerkleDigest &value);
+    void updateNode(uint32_t level, uint64_t index);
+};
+
+/********************* Flat incremental Merkle tree **************************/
+
+class FlatIncrementalMerkleTree {
+protected:
+
+    FlatMerkleTree tree;
+
+public:
+    FlatIncrementalMerkleTree(uint32_t height = ZEROCASH_DEFAULT_TREE_SIZE);
+    FlatIncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height,
+                              ThreadPool &pool = ThreadPool::getDefault());
+    FlatIncrementalMerkleTree(IncrementalMerkleTreeCompact &compact);
+
+    bool insertElement(const std::vector<bool> &hashV, std::vector<bool> &index);
+    bool insertElement(const std::vector<unsigned char> &hashV, std::vector<unsigned char> &index);
+    bool insertElements(const std::vector< std::vector<bool> > &values, std::vector< std::vector<bool> > &indices);
+    bool insertVector(std::vector< std::vector<bool> > &valueVector);
+    bool getWitness(const std::vector<bool> &index, merkle_authentication_path &witness);
+    bool getRootValue(std::vector<bool>& r);
+    bool getRootValue(std::vector<unsigned char>& r);
+    std::vector<unsigned char> getRoot();
+    bool prune();
+    bool getCompactRepresentation(IncrementalMerkleTreeCompact &rep);
+    IncrementalMerkleTreeCompact getCompactRepresentation();
+
+    bool fromCompactRepresentation(IncrementalMerkleTreeCompact &rep);
+
+    const FlatMerkleTree& getEngine() const { return tree; }
+};
+
+} /* namespace libzerocash */
+
+#endif /* FLATMERKLETREE_H_ */
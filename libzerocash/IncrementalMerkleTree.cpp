@@ -13,8 +13,10 @@
  *****************************************************************************/
 
 #include "IncrementalMerkleTree.h"
+#include "MerkleTreeBuilder.h"
 #include "Zerocash.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -26,16 +28,29 @@ namespace libzerocash {
     /////////////////////////////////////////////
 
     // Custom tree constructor (initialize tree of specified height)
-    IncrementalMerkleTree::IncrementalMerkleTree(uint32_t height) : root(0, height) {
+    IncrementalMerkleTree::IncrementalMerkleTree(uint32_t height) : root(0, height, &EmptySubtreeTable::get(height, EmptySubtreeTable::ZERO_SENTINEL)), numLeaves(0),
+                rootHistoryLimit(ZEROCASH_DEFAULT_ROOT_HISTORY),
+                checkpointLimit(ZEROCASH_DEFAULT_CHECKPOINTS), nextCheckpointId(0) {
         treeHeight = height;
+        this->recordRoot();
     }
 
     // Vector constructor. Initializes and inserts a list of elements.
-    IncrementalMerkleTree::IncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height) : root(0, height)
+    IncrementalMerkleTree::IncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height,
+                                                 ThreadPool &pool) : root(0, height, &EmptySubtreeTable::get(height, EmptySubtreeTable::ZERO_SENTINEL)), numLeaves(0),
+                rootHistoryLimit(ZEROCASH_DEFAULT_ROOT_HISTORY),
+                checkpointLimit(ZEROCASH_DEFAULT_CHECKPOINTS), nextCheckpointId(0)
     {
         // Initialize the tree
         treeHeight = height;
 
+        // Build all levels at once in parallel when possible
+        if (this->buildFromVector(valueVector, pool) == true) {
+            this->numLeaves = valueVector.size();
+            this->recordRoot();
+            return;
+        }
+
         // Load the tree with all the given values
         if (this->insertVector(valueVector) == false) {
 			throw std::runtime_error("Could not insert vector into Merkle Tree: too many elements");
@@ -44,12 +59,15 @@ namespace libzerocash {
 
     // Custom tree constructor (initialize tree from compact representation)
     //
-    IncrementalMerkleTree::IncrementalMerkleTree(IncrementalMerkleTreeCompact &compact) : root(0, 0)
+    IncrementalMerkleTree::IncrementalMerkleTree(IncrementalMerkleTreeCompact &compact) : root(0, 0, NULL), numLeaves(0),
+                rootHistoryLimit(ZEROCASH_DEFAULT_ROOT_HISTORY),
+                checkpointLimit(ZEROCASH_DEFAULT_CHECKPOINTS), nextCheckpointId(0)
 	{
 
 		// Initialize the tree
 		this->treeHeight = compact.getHeight();
 		root.treeHeight = treeHeight;
+		root.emptySubtrees = &EmptySubtreeTable::get(treeHeight, EmptySubtreeTable::ZERO_SENTINEL);
 
 		// Make sure we convert from the integer vector to the bool vector
 		libzerocash::convertBytesVectorToVector(compact.hashListBytes, compact.hashList);
@@ -72,7 +90,14 @@ namespace libzerocash {
         index.resize(this->treeHeight);
 
         // Insert the element
-        return this->root.insertElement(hashV, index);
+        if (this->root.insertElement(hashV, index) == false) {
+            return false;
+        }
+
+        this->numLeaves++;
+        this->updateTrackedWitnesses(index);
+        this->recordRoot();
+        return true;
     }
 
 	bool
@@ -103,7 +128,23 @@ namespace libzerocash {
 			witness.resize(treeHeight);
 		}
 
-		std::vector<bool> indexPadded = index;
+		std::vector<bool> indexPadded;
+		this->normalizeIndex(index, indexPadded);
+
+		// Tracked leaves are served from the cache
+		std::map< std::vector<bool>, merkle_authentication_path >::iterator it = this->trackedWitnesses.find(indexPadded);
+		if (it != this->trackedWitnesses.end()) {
+			std::copy(it->second.begin(), it->second.end(), witness.begin());
+			return true;
+		}
+
+        return this->root.getWitness(indexPadded, witness);
+    }
+
+    void
+    IncrementalMerkleTree::normalizeIndex(const std::vector<bool> &index, std::vector<bool> &indexPadded)
+    {
+		indexPadded = index;
 
 		// Discard leading bits of the index if necessary
 		if (indexPadded.size() > this->treeHeight) {
@@ -114,24 +155,130 @@ namespace libzerocash {
 		// This is to deal with the situation where somebody encodes e.g., a 32-bit integer as an index
 		// into a 64 height tree and does not explicitly pad to length.
 		if (indexPadded.size() < this->treeHeight) {
-			indexPadded.insert(indexPadded.begin(), (this->treeHeight - 1) - indexPadded.size(), false);
+			indexPadded.insert(indexPadded.begin(), this->treeHeight - indexPadded.size(), false);
 		}
+    }
 
-        return this->root.getWitness(indexPadded, witness);
+    bool
+    IncrementalMerkleTree::trackWitness(const std::vector<bool> &index)
+    {
+		std::vector<bool> indexPadded;
+		this->normalizeIndex(index, indexPadded);
+
+		if (this->trackedWitnesses.count(indexPadded) != 0) {
+			return true;
+		}
+
+		merkle_authentication_path witness(this->treeHeight);
+		if (this->root.getWitness(indexPadded, witness) == false) {
+			return false;
+		}
+
+		this->trackedWitnesses[indexPadded] = witness;
+		return true;
+    }
+
+    void
+    IncrementalMerkleTree::untrackWitness(const std::vector<bool> &index)
+    {
+		std::vector<bool> indexPadded;
+		this->normalizeIndex(index, indexPadded);
+
+		this->trackedWitnesses.erase(indexPadded);
+    }
+
+    // Called after leaves were appended starting at 'firstIndex'. For a tracked
+    // leaf, only the right siblings of its path that received new leaves
+    // change; they all hang off its path at or above the depth where it splits
+    // from 'firstIndex'. Those path nodes were not full before the insert, so
+    // they cannot have been pruned.
+    void
+    IncrementalMerkleTree::updateTrackedWitnesses(const std::vector<bool> &firstIndex)
+    {
+		std::map< std::vector<bool>, merkle_authentication_path >::iterator it;
+
+		for (it = this->trackedWitnesses.begin(); it != this->trackedWitnesses.end(); ++it) {
+			const std::vector<bool> &index = it->first;
+			merkle_authentication_path &witness = it->second;
+			IncrementalMerkleNode *node = &this->root;
+
+			for (uint32_t depth = 0; depth < this->treeHeight && node != NULL; depth++) {
+				if (index.at(depth) == false) {
+					if (node->right) {
+						node->right->getValue(witness.at(depth));
+					} else {
+						witness.at(depth) = node->emptySubtrees->digestBits(this->treeHeight - depth - 1);
+					}
+				}
+
+				// Below the split point nothing on this path has changed
+				if (index.at(depth) != firstIndex.at(depth)) {
+					break;
+				}
+
+				node = (index.at(depth) == false) ? node->left : node->right;
+			}
+		}
+    }
+
+    // Batch insert. All values are placed first and every interior node on
+    // the touched paths is rehashed exactly once. The index of each inserted
+    // value is returned in 'indices'. Returns false if the tree filled up
+    // before all values were inserted.
+    bool
+    IncrementalMerkleTree::insertElements(const std::vector< std::vector<bool> > &values, std::vector< std::vector<bool> > &indices)
+    {
+        std::vector<bool> index(this->treeHeight, false);
+        size_t pos = 0;
+
+        indices.clear();
+        indices.reserve(values.size());
+
+        this->root.insertElements(values, pos, index, indices);
+
+        if (indices.empty() == false) {
+            this->numLeaves += indices.size();
+            this->updateTrackedWitnesses(indices.front());
+            this->recordRoot();
+        }
+
+        return (pos == values.size());
     }
 
     bool
     IncrementalMerkleTree::insertVector(std::vector< std::vector<bool> > &valueVector)
     {
-        std::vector<bool> index;
+        std::vector< std::vector<bool> > indices;
 
-        for (std::vector< std::vector<bool> >::iterator iter = valueVector.begin();
-             iter != valueVector.end(); ++iter) {
+        return this->insertElements(valueVector, indices);
+    }
 
-            if (this->insertElement(*iter, index) == false) {
-				return false;
-			}
+    // Hashes the tree level by level on 'pool', then creates the nodes and
+    // fills in their values. Only applies to an empty tree and 256-bit values.
+    bool
+    IncrementalMerkleTree::buildFromVector(const std::vector< std::vector<bool> > &valueVector, ThreadPool &pool)
+    {
+        if (valueVector.empty() || this->root.left || this->root.right || this->root.isLeaf() ||
+            (this->treeHeight < 64 && valueVector.size() > (uint64_t(1) << this->treeHeight))) {
+            return false;
+        }
+
+        std::vector<MerkleDigest> leaves;
+        if (convertVectorsToDigests(valueVector, leaves, pool) == false) {
+            return false;
+        }
 
+        std::vector< std::vector<MerkleDigest> > levels;
+        buildMerkleLevels(leaves, this->treeHeight, EmptySubtreeTable::ZERO_SENTINEL, pool, levels);
+
+        std::vector< std::vector< std::vector<bool>* > > values(this->treeHeight + 1);
+        for (uint32_t level = 0; level <= this->treeHeight; level++) {
+            values[level].resize(levels[level].size());
+        }
+        this->root.loadLevels(levels, 0, values);
+
+        for (uint32_t level = 0; level <= this->treeHeight; level++) {
+            convertDigestsToVectors(levels[level], values[level], pool);
         }
 
         return true;
@@ -161,7 +308,7 @@ namespace libzerocash {
     }
 	std::vector<unsigned char>
 	IncrementalMerkleTree::getRoot(){
-		std::vector<unsigned char> temp(8);
+		std::vector<unsigned char> temp(root_size);
 		this->getRootValue(temp);
 		return temp;
 	}
@@ -174,6 +321,22 @@ namespace libzerocash {
         return false;
     }
 
+    size_t
+    IncrementalMerkleTree::memoryUsage()
+    {
+        size_t bytes = 0, nodes = 0;
+        this->root.memoryUsage(bytes, nodes);
+        return bytes;
+    }
+
+    size_t
+    IncrementalMerkleTree::numNodes()
+    {
+        size_t bytes = 0, nodes = 0;
+        this->root.memoryUsage(bytes, nodes);
+        return nodes;
+    }
+
     bool
     IncrementalMerkleTree::getCompactRepresentation(IncrementalMerkleTreeCompact &rep)
     {
@@ -204,40 +367,265 @@ namespace libzerocash {
     bool
     IncrementalMerkleTree::fromCompactRepresentation(IncrementalMerkleTreeCompact &rep)
     {
-		return this->root.fromCompactRepresentation(rep, 0);
+		bool result = this->root.fromCompactRepresentation(rep, 0);
+
+		// Each set bit of the hash list stands for a full left subtree
+		this->numLeaves = 0;
+		size_t offset = (rep.hashList.size() > this->treeHeight) ? rep.hashList.size() - this->treeHeight : 0;
+		for (size_t i = offset; i < rep.hashList.size(); i++) {
+			uint32_t level = this->treeHeight - 1 - (i - offset);
+			if (rep.hashList.at(i) && level < 64) {
+				this->numLeaves += (uint64_t(1) << level);
+			}
+		}
+
+		// Nothing cached from the previous contents describes the restored tree.
+		// Checkpoint ids keep counting up, so that an id from before the
+		// restore can never name a later checkpoint.
+		this->trackedWitnesses.clear();
+		this->rootHistory.clear();
+		this->rootIndex.clear();
+		this->checkpoints.clear();
+
+		this->recordRoot();
+		return result;
 	}
 
+    void
+    IncrementalMerkleTree::recordRoot()
+    {
+		if (this->rootHistoryLimit == 0) {
+			return;
+		}
+
+		MerkleDigest digest;
+		convertVectorToBytes(this->root.getValue(), digest.data());
+
+		this->rootHistory.push_back(std::make_pair(digest, this->numLeaves));
+		std::pair<size_t, uint64_t> &entry = this->rootIndex[digest];
+		entry.first++;
+		entry.second = this->numLeaves;
+
+		this->setRootHistoryLimit(this->rootHistoryLimit);
+    }
+
+    void
+    IncrementalMerkleTree::setRootHistoryLimit(size_t limit)
+    {
+		this->rootHistoryLimit = limit;
+
+		// Evict the oldest roots beyond the limit
+		while (this->rootHistory.size() > limit) {
+			std::unordered_map< MerkleDigest, std::pair<size_t, uint64_t>, MerkleDigestHasher >::iterator it =
+				this->rootIndex.find(this->rootHistory.front().first);
+
+			if (--(it->second.first) == 0) {
+				this->rootIndex.erase(it);
+			}
+			this->rootHistory.pop_front();
+		}
+    }
+
+    bool
+    IncrementalMerkleTree::isRecentRoot(const MerkleRootType &root)
+    {
+		uint64_t leafCount;
+		return this->isRecentRoot(root, leafCount);
+    }
+
+    bool
+    IncrementalMerkleTree::isRecentRoot(const MerkleRootType &root, uint64_t &leafCount)
+    {
+		if (root.size() != SHA256_BLOCK_SIZE) {
+			return false;
+		}
+
+		MerkleDigest digest;
+		std::copy(root.begin(), root.end(), digest.begin());
+
+		std::unordered_map< MerkleDigest, std::pair<size_t, uint64_t>, MerkleDigestHasher >::const_iterator it =
+			this->rootIndex.find(digest);
+		if (it == this->rootIndex.end()) {
+			return false;
+		}
+
+		leafCount = it->second.second;
+		return true;
+    }
+
+    // MSB-first index of the leaf at 'position' in a tree of the given height
+    static void positionToIndex(uint64_t position, uint32_t height, std::vector<bool> &index) {
+        index.assign(height, false);
+        for (uint32_t depth = 0; depth < height; depth++) {
+            uint32_t level = height - 1 - depth;
+            index.at(depth) = (level < 64) && ((position >> level) & 1);
+        }
+    }
+
+    uint64_t
+    IncrementalMerkleTree::checkpoint()
+    {
+        IncrementalMerkleCheckpoint cp;
+        cp.id = this->nextCheckpointId++;
+        cp.numLeaves = this->numLeaves;
+
+        // The frontier: the full left subtrees on the path to the next free leaf
+        std::vector<bool> nextIndex;
+        positionToIndex(this->numLeaves, this->treeHeight, nextIndex);
+
+        cp.frontier.treeHeight = this->treeHeight;
+        cp.frontier.hashList.assign(this->treeHeight, false);
+
+        IncrementalMerkleNode *node = &this->root;
+        for (uint32_t depth = 0; depth < this->treeHeight && node != NULL && !node->isPruned(); depth++) {
+            if (nextIndex.at(depth) == true) {
+                std::vector<unsigned char> hash(SHA256_BLOCK_SIZE, 0);
+                convertVectorToBytesVector(node->left->getValue(), hash);
+
+                cp.frontier.hashList.at(depth) = true;
+                cp.frontier.hashVec.push_back(hash);
+                node = node->right;
+            } else {
+                node = node->left;
+            }
+        }
+
+        // The path of the last leaf, down to the first full node
+        cp.pathValues.resize(this->treeHeight + 1);
+        if (this->numLeaves > 0) {
+            positionToIndex(this->numLeaves - 1, this->treeHeight, cp.lastIndex);
+            cp.pathValues[0] = this->root.getValue();
+
+            node = &this->root;
+            for (uint32_t depth = 0; depth < this->treeHeight && !node->isPruned(); depth++) {
+                node = (cp.lastIndex.at(depth) == false) ? node->left : node->right;
+                if (node == NULL) {
+                    break;
+                }
+                cp.pathValues[depth + 1] = node->getValue();
+            }
+        }
+
+        this->checkpoints.push_back(cp);
+        this->setCheckpointLimit(this->checkpointLimit);
+
+        return cp.id;
+    }
+
+    bool
+    IncrementalMerkleTree::rewind(uint64_t checkpointId)
+    {
+        // Find the checkpoint and drop every later one
+        while (this->checkpoints.empty() == false && this->checkpoints.back().id > checkpointId) {
+            this->checkpoints.pop_back();
+        }
+        if (this->checkpoints.empty() || this->checkpoints.back().id != checkpointId) {
+            return false;
+        }
+
+        IncrementalMerkleCheckpoint &cp = this->checkpoints.back();
+        bool full = (this->treeHeight < 64 && cp.numLeaves == (uint64_t(1) << this->treeHeight));
+
+        // Restore the frontier. A full tree cannot be expressed as a frontier,
+        // so it becomes a single full, pruned root.
+        if (full) {
+            delete this->root.left;
+            delete this->root.right;
+            this->root.left = this->root.right = NULL;
+            this->root.value = cp.pathValues[0];
+            this->root.subtreeFull = this->root.subtreePruned = true;
+        } else {
+            this->root.fromCompactRepresentation(cp.frontier, 0);
+        }
+        this->numLeaves = cp.numLeaves;
+
+        // Tracked witnesses. For a leaf that splits from the last leaf at depth
+        // k, the right siblings above k are empty again, the one at k is on the
+        // last leaf's path, and the ones below k were already full.
+        std::map< std::vector<bool>, merkle_authentication_path >::iterator it = this->trackedWitnesses.begin();
+        while (it != this->trackedWitnesses.end()) {
+            const std::vector<bool> &index = it->first;
+
+            if (cp.numLeaves == 0 || index > cp.lastIndex) {
+                this->trackedWitnesses.erase(it++);
+                continue;
+            }
+
+            uint32_t split = 0;
+            while (split < this->treeHeight && index.at(split) == cp.lastIndex.at(split)) {
+                split++;
+            }
+
+            for (uint32_t depth = 0; depth < this->treeHeight && depth <= split; depth++) {
+                if (index.at(depth) == true) {
+                    continue;
+                }
+
+                if (depth < split) {
+                    it->second.at(depth) = this->root.emptySubtrees->digestBits(this->treeHeight - depth - 1);
+                } else if (cp.pathValues[depth + 1].empty() == false) {
+                    it->second.at(depth) = cp.pathValues[depth + 1];
+                }
+            }
+
+            ++it;
+        }
+
+        // Forget the roots of the discarded leaves
+        while (this->rootHistory.empty() == false && this->rootHistory.back().second > cp.numLeaves) {
+            std::unordered_map< MerkleDigest, std::pair<size_t, uint64_t>, MerkleDigestHasher >::iterator entry =
+                this->rootIndex.find(this->rootHistory.back().first);
+
+            if (--(entry->second.first) == 0) {
+                this->rootIndex.erase(entry);
+            }
+            this->rootHistory.pop_back();
+        }
+
+        return true;
+    }
+
+    void
+    IncrementalMerkleTree::setCheckpointLimit(size_t limit)
+    {
+        this->checkpointLimit = limit;
+
+        while (this->checkpoints.size() > limit) {
+            this->checkpoints.pop_front();
+        }
+    }
+
     /////////////////////////////////////////////
     // IncrementalMerkleNode class
     /////////////////////////////////////////////
 
     // Standard constructor
     //
-    IncrementalMerkleNode::IncrementalMerkleNode(uint32_t depth, uint32_t height) : left(NULL), right(NULL), value(SHA256_BLOCK_SIZE * 8, 0), nodeDepth(depth), treeHeight(height),
-				subtreeFull(false), subtreePruned(false)
+    IncrementalMerkleNode::IncrementalMerkleNode(uint32_t depth, uint32_t height, const EmptySubtreeTable *emptySubtrees) :
+				left(NULL), right(NULL), value(SHA256_BLOCK_SIZE * 8, 0), nodeDepth(depth), treeHeight(height),
+				subtreeFull(false), subtreePruned(false), emptySubtrees(emptySubtrees)
     {
-        sha256_init(&ctx256);
     }
 
     // Copy constructor
     //
     IncrementalMerkleNode::IncrementalMerkleNode(const IncrementalMerkleNode& toCopy) : left(NULL), right(NULL), value(SHA256_BLOCK_SIZE * 8, 0)
     {
-        sha256_init(&ctx256);
         this->nodeDepth = toCopy.nodeDepth;
         this->subtreePruned = toCopy.subtreePruned;
         this->subtreeFull = toCopy.subtreeFull;
         this->value = toCopy.value;
 		this->treeHeight = toCopy.treeHeight;
+		this->emptySubtrees = toCopy.emptySubtrees;
 
         // Recursively copy the subtrees
         if (toCopy.left) {
-			this->left = new IncrementalMerkleNode(toCopy.left->nodeDepth, toCopy.left->treeHeight);
+			this->left = new IncrementalMerkleNode(toCopy.left->nodeDepth, toCopy.left->treeHeight, toCopy.left->emptySubtrees);
             *(this->left) = *(toCopy.left);
         }
 
         if (toCopy.right) {
-			this->right = new IncrementalMerkleNode(toCopy.right->nodeDepth, toCopy.right->treeHeight);
+			this->right = new IncrementalMerkleNode(toCopy.right->nodeDepth, toCopy.right->treeHeight, toCopy.right->emptySubtrees);
             *(this->right) = *(toCopy.right);
         }
     }
@@ -276,7 +664,7 @@ namespace libzerocash {
         // We're not a leaf. Try to insert into subtrees, creating them if necessary.
         // Try to recurse on left subtree
         if (!this->left) {
-            this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight);
+            this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
         }
         result = this->left->insertElement(hashV, index);
         if (result == true) {
@@ -287,7 +675,7 @@ namespace libzerocash {
         // If that failed, try to recurse on right subtree.
         if (result == false) {
             if (!this->right) {
-                this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight);
+                this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
             }
             result = this->right->insertElement(hashV, index);
             if (result == true) {
@@ -308,6 +696,74 @@ namespace libzerocash {
         return result;
     }
 
+    bool
+    IncrementalMerkleNode::insertElements(const std::vector< std::vector<bool> > &values, size_t &pos,
+                                          std::vector<bool> &index, std::vector< std::vector<bool> > &indices)
+    {
+        // Nothing left to insert, or no free leaves below us.
+        if (pos >= values.size() || this->subtreeFull == true) {
+            return false;
+        }
+
+        // Are we a leaf? If so, store the next value and record where it went.
+        if (this->isLeaf()) {
+            this->value = values.at(pos++);
+            this->subtreeFull = true;
+            indices.push_back(index);
+            return true;
+        }
+
+        // Fill the left subtree first, then spill over into the right one.
+        bool result = false;
+
+        if (!this->left) {
+            this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
+        }
+        index.at(this->nodeDepth) = false;
+        result |= this->left->insertElements(values, pos, index, indices);
+
+        if (pos < values.size()) {
+            if (!this->right) {
+                this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
+            }
+            index.at(this->nodeDepth) = true;
+            result |= this->right->insertElements(values, pos, index, indices);
+        }
+
+        // Rehash once, after both subtrees are complete.
+        if (result == true) {
+            this->updateHashValue();
+            this->subtreeFull = this->checkIfNodeFull();
+        }
+
+        return result;
+    }
+
+    // Creates the subtree below this node from precomputed levels (see
+    // MerkleTreeBuilder.h) and records where each node's value goes.
+    void
+    IncrementalMerkleNode::loadLevels(const std::vector< std::vector<MerkleDigest> > &levels, uint64_t index,
+                                      std::vector< std::vector< std::vector<bool>* > > &values)
+    {
+        uint32_t level = this->treeHeight - this->nodeDepth;
+        values[level][index] = &this->value;
+
+        if (this->isLeaf()) {
+            this->subtreeFull = true;
+            return;
+        }
+
+        this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
+        this->left->loadLevels(levels, 2 * index, values);
+
+        if (2 * index + 1 < levels[level - 1].size()) {
+            this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
+            this->right->loadLevels(levels, 2 * index + 1, values);
+        }
+
+        this->subtreeFull = this->checkIfNodeFull();
+    }
+
     bool
     IncrementalMerkleNode::getWitness(const std::vector<bool> &index, merkle_authentication_path &witness)
     {
@@ -327,10 +783,9 @@ namespace libzerocash {
         // right -- then recurse on the left node.
         if (index.at(nodeDepth) == false) {
 
-			// Make sure there is a value on the right. If not we put the 'null' hash (0) into that element.
+			// Make sure there is a value on the right. If not we put the empty subtree hash into that element.
 			if (this->right == NULL) {
-				witness.at(nodeDepth).resize(SHA256_BLOCK_SIZE * 8);
-				std::fill (witness.at(nodeDepth).begin(), witness.at(nodeDepth).end(), false);
+				witness.at(nodeDepth) = this->emptySubtrees->digestBits(this->treeHeight - this->nodeDepth - 1);
 			} else {
 				this->right->getValue(witness.at(nodeDepth));
 				printVectorAsHex(witness.at(nodeDepth));
@@ -403,9 +858,12 @@ namespace libzerocash {
 
         // Obtain the hash of the two subtrees and hash the
         // concatenation of the two.
+        // The context is only needed for the call, so it comes from the
+        // thread rather than being kept in every node.
+        HashSiteScope site(SHA256_SITE_TREE);
+        SHA256_CTX_mod *ctx256 = threadHashContext();
         std::vector<bool> hash(SHA256_BLOCK_SIZE * 8);
-        std::vector<bool> zero(SHA256_BLOCK_SIZE * 8);
-        std::fill (zero.begin(), zero.end(), false);
+        const std::vector<bool> &zero = this->emptySubtrees->digestBits(this->treeHeight - this->nodeDepth - 1);
 
 		// The following code is ugly and should be refactored. It runs
 		// four special cases depending on whether left/right is NULL.
@@ -414,19 +872,19 @@ namespace libzerocash {
 			if (VectorIsZero(this->left->getValue())) {
 				hash = zero;
 			} else {
-				hashVectors(&ctx256, this->left->getValue(), zero, hash);
+				hashVectors(ctx256, this->left->getValue(), zero, hash);
 			}
         } else if (!(this->left) && this->right) {
 			if (VectorIsZero(this->right->getValue())) {
 				hash = zero;
 			} else {
-				hashVectors(&ctx256, zero, this->left->getValue(), hash);
+				hashVectors(ctx256, zero, this->right->getValue(), hash);
 			}
         } else if (this->left && this->right) {
 			if (VectorIsZero(this->left->getValue()) && VectorIsZero(this->right->getValue())) {
 				hash = zero;
 			} else {
-				hashVectors(&ctx256, this->left->getValue(), this->right->getValue(), hash);
+				hashVectors(ctx256, this->left->getValue(), this->right->getValue(), hash);
 			}
         } else {
             hash = zero;
@@ -435,6 +893,21 @@ namespace libzerocash {
         this->value = hash;
     }
 
+    void
+    IncrementalMerkleNode::memoryUsage(size_t &bytes, size_t &nodes)
+    {
+        // vector<bool> capacity is a whole number of words
+        bytes += sizeof(*this) + this->value.capacity() / 8;
+        nodes++;
+
+        if (this->left) {
+            this->left->memoryUsage(bytes, nodes);
+        }
+        if (this->right) {
+            this->right->memoryUsage(bytes, nodes);
+        }
+    }
+
     bool
     IncrementalMerkleNode::checkIfNodeFull()
     {
@@ -507,7 +980,7 @@ namespace libzerocash {
         // and mark it full AND pruned. Then recurse to the right.
         if (rep.hashList.at(this->nodeDepth) == true) {
 			// Create a left node
-			this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight);
+			this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
 
             // Fill the left node with the value and mark it full/pruned
             std::vector<bool> hash(SHA256_BLOCK_SIZE * 8, 0);
@@ -516,13 +989,13 @@ namespace libzerocash {
             this->left->subtreePruned = this->left->subtreeFull = true;
 
             // Create a right node and recurse on it (incrementing pos)
-            this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight);
+            this->right = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
             result = this->right->fromCompactRepresentation(rep, pos + 1);
         } else if (this->nodeDepth < (this->treeHeight - 1)) {
 			// Otherwise --
 			// * If we're about to create a leaf level, do nothing.
 			// * Else create a left node and recurse on it.
-			this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight);
+			this->left = new IncrementalMerkleNode(this->nodeDepth + 1, this->treeHeight, this->emptySubtrees);
 
             // Otherwise recurse on the left node. Do not increment pos.
             result = this->left->fromCompactRepresentation(rep, pos);
@@ -16,9 +16,14 @@
 #include "utils/sha256.h"
 
 #include "Zerocash.h"
+#include "EmptySubtreeTable.h"
+#include "utils/ThreadPool.h"
 #include <vector>
 #include <iostream>
 #include <map>
+#include <deque>
+#include <unordered_map>
+#include <utility>
 #include <cstring>
 
 #include "serialize.h"
@@ -52,7 +57,6 @@ public:
 
 class IncrementalMerkleNode {
 public:
-    SHA256_CTX_mod ctx256;
 	IncrementalMerkleNode* left;
     IncrementalMerkleNode* right;
     std::vector<bool> value;
@@ -60,17 +64,24 @@ public:
     uint32_t treeHeight;
     bool subtreeFull;
     bool subtreePruned;
+    const EmptySubtreeTable *emptySubtrees;
 
-    IncrementalMerkleNode(uint32_t depth, uint32_t height);
+    // 'emptySubtrees' is the tree's table, looked up once by the tree and
+    // handed down to every node it creates.
+    IncrementalMerkleNode(uint32_t depth, uint32_t height, const EmptySubtreeTable *emptySubtrees);
     IncrementalMerkleNode(const IncrementalMerkleNode& toCopy);
     ~IncrementalMerkleNode();
 
     // Methods
     bool insertElement(const std::vector<bool> &hashV, std::vector<bool> &index);
+    bool insertElements(const std::vector< std::vector<bool> > &values, size_t &pos,
+                        std::vector<bool> &index, std::vector< std::vector<bool> > &indices);
     bool getWitness(const std::vector<bool> &index, merkle_authentication_path &witness);
     bool prune();
     bool getCompactRepresentation(IncrementalMerkleTreeCompact &rep);
     bool fromCompactRepresentation(IncrementalMerkleTreeCompact &rep, uint32_t pos);
+    void loadLevels(const std::vector< std::vector<MerkleDigest> > &levels, uint64_t index,
+                    std::vector< std::vector< std::vector<bool>* > > &values);
 
     // Utility methods
     bool isLeaf()   { return (nodeDepth == treeHeight); }
@@ -83,24 +94,68 @@ public:
     bool checkIfNodeFull();
     void updateHashValue();
 
+    // Heap bytes held by this subtree (nodes and their values), and its node count
+    void memoryUsage(size_t &bytes, size_t &nodes);
+
 	IncrementalMerkleNode	operator=(const IncrementalMerkleNode &rhs);
 };
 
 /************************ Incremental Merkle tree ****************************/
 
+// Number of past roots an IncrementalMerkleTree remembers by default
+#define ZEROCASH_DEFAULT_ROOT_HISTORY	100
+
+// Number of checkpoints an IncrementalMerkleTree retains by default
+#define ZEROCASH_DEFAULT_CHECKPOINTS	100
+
+// A snapshot of the tree frontier, enough to restore the tree to the state it
+// had when the checkpoint was taken. Its size is O(tree height).
+struct IncrementalMerkleCheckpoint {
+    uint64_t						id;
+    uint64_t						numLeaves;
+
+    // The frontier, in the same form as a compact representation
+    IncrementalMerkleTreeCompact	frontier;
+
+    // Index of the last leaf, and the values of the nodes on its path (root
+    // first). Entries below the first full node are left empty.
+    std::vector<bool>				lastIndex;
+    std::vector< std::vector<bool> > pathValues;
+};
+
 class IncrementalMerkleTree {
 protected:
 
 	IncrementalMerkleNode	 root;
     uint32_t   				 treeHeight;
 
+    // Cached authentication paths of tracked leaves, keyed by leaf index.
+    // They are kept up to date on every insert, so they survive pruning.
+    std::map< std::vector<bool>, merkle_authentication_path > trackedWitnesses;
+
+    uint64_t				 numLeaves;
+
+    // The last 'rootHistoryLimit' roots (oldest first) with the leaf count at
+    // the time, and an index over them for constant time anchor lookups. The
+    // index counts occurrences, since appending zero leaves can repeat a root.
+    size_t					 rootHistoryLimit;
+    std::deque< std::pair<MerkleDigest, uint64_t> > rootHistory;
+    std::unordered_map< MerkleDigest, std::pair<size_t, uint64_t>, MerkleDigestHasher > rootIndex;
+
+    // Retained checkpoints, oldest first
+    size_t					 checkpointLimit;
+    uint64_t				 nextCheckpointId;
+    std::deque<IncrementalMerkleCheckpoint> checkpoints;
+
 public:
     IncrementalMerkleTree(uint32_t height = ZEROCASH_DEFAULT_TREE_SIZE);
-    IncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height);
+    IncrementalMerkleTree(std::vector< std::vector<bool> > &valueVector, uint32_t height,
+                          ThreadPool &pool = ThreadPool::getDefault());
 	IncrementalMerkleTree(IncrementalMerkleTreeCompact &compact);
 
     bool insertElement(const std::vector<bool> &hashV, std::vector<bool> &index);
 	bool insertElement(const std::vector<unsigned char> &hashV, std::vector<unsigned char> &index);
+    bool insertElements(const std::vector< std::vector<bool> > &values, std::vector< std::vector<bool> > &indices);
     bool insertVector(std::vector< std::vector<bool> > &valueVector);
     bool getWitness(const std::vector<bool> &index, merkle_authentication_path &witness);
     bool getRootValue(std::vector<bool>& r);
@@ -110,8 +165,49 @@ public:
     bool getCompactRepresentation(IncrementalMerkleTreeCompact &rep);
     IncrementalMerkleTreeCompact getCompactRepresentation();
 
+    // Replaces the contents of the tree. Tracked witnesses, recent roots and
+    // checkpoints of the previous contents are dropped.
     bool fromCompactRepresentation(IncrementalMerkleTreeCompact &rep);
 
+    // Witness tracking. A tracked leaf's witness is served from the cache by
+    // getWitness and stays available after the rest of the tree is pruned.
+    // trackWitness fails if the leaf does not exist or has been pruned.
+    bool trackWitness(const std::vector<bool> &index);
+    void untrackWitness(const std::vector<bool> &index);
+    size_t numTrackedWitnesses() { return trackedWitnesses.size(); }
+
+    // Root history. Every insert call records the resulting root, so a batch
+    // inserted with insertElements adds one entry. isRecentRoot tells whether
+    // 'root' is one of the last 'limit' roots and returns the number of leaves
+    // the tree had then (the most recent, if the root occurred more than once).
+    void setRootHistoryLimit(size_t limit);
+    size_t getRootHistoryLimit() { return rootHistoryLimit; }
+    bool isRecentRoot(const MerkleRootType &root);
+    bool isRecentRoot(const MerkleRootType &root, uint64_t &leafCount);
+
+    uint64_t size() { return numLeaves; }
+
+    // Bytes held by the nodes of the tree and their values, and the number
+    // of nodes. The caches above (witnesses, roots, checkpoints) are not counted.
+    size_t memoryUsage();
+    size_t numNodes();
+
+    // Checkpoints. checkpoint() snapshots the frontier and returns an id for
+    // it; rewind() restores the root, the frontier, the tracked witnesses and
+    // the root history to that snapshot, and drops later checkpoints. Leaves
+    // appended after the checkpoint are discarded and tracked leaves among
+    // them are untracked. Only the last 'limit' checkpoints are retained.
+    uint64_t checkpoint();
+    bool rewind(uint64_t checkpointId);
+    void setCheckpointLimit(size_t limit);
+    size_t getCheckpointLimit() { return checkpointLimit; }
+    size_t numCheckpoints() { return checkpoints.size(); }
+
+protected:
+    bool buildFromVector(const std::vector< std::vector<bool> > &valueVector, ThreadPool &pool);
+    void normalizeIndex(const std::vector<bool> &index, std::vector<bool> &indexPadded);
+    void updateTrackedWitnesses(const std::vector<bool> &firstIndex);
+    void recordRoot();
 };
 
 } /* namespace libzerocash */
@@ -0,0 +1,349 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class MappedMerkleTree.
+
+ See MappedMerkleTree.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "MappedMerkleTree.h"
+#include "FlatMerkleTree.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace libzerocash {
+
+// Level files grow by doubling, starting from one page of records.
+#define MAPPED_MERKLE_TREE_MIN_RECORDS  128
+
+static inline uint64_t shiftRight(uint64_t value, uint32_t bits) {
+    return (bits >= 64) ? 0 : (value >> bits);
+}
+
+MappedMerkleTree::MappedMerkleTree(const std::string &directory, uint32_t height) : directory(directory),
+            treeHeight(height), emptySubtrees(NULL), headerFd(-1), header(NULL), numLeaves(0)
+{
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw ZerocashException("Could not create Merkle tree directory " + directory);
+    }
+
+    try {
+        this->openHeader(height);
+
+        this->emptySubtrees = &EmptySubtreeTable::get(this->treeHeight, EmptySubtreeTable::ZERO_SENTINEL);
+
+        this->levels.reserve(this->treeHeight + 1);
+        for (uint32_t level = 0; level <= this->treeHeight; level++) {
+            this->openLevel(level);
+        }
+
+        this->rehashFrontier();
+    } catch (...) {
+        this->close();
+        throw;
+    }
+}
+
+MappedMerkleTree::~MappedMerkleTree()
+{
+    this->sync();
+    this->close();
+}
+
+void
+MappedMerkleTree::openHeader(uint32_t height)
+{
+    std::string path = this->directory + "/tree.meta";
+    bool created = true;
+
+    this->headerFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (this->headerFd < 0 && errno == EEXIST) {
+        created = false;
+        this->headerFd = ::open(path.c_str(), O_RDWR);
+    }
+    if (this->headerFd < 0) {
+        throw ZerocashException("Could not open Merkle tree header " + path);
+    }
+
+    if (created && ftruncate(this->headerFd, sizeof(MappedMerkleTreeHeader)) != 0) {
+        throw ZerocashException("Could not write Merkle tree header " + path);
+    }
+
+    struct stat st;
+    if (fstat(this->headerFd, &st) != 0 || st.st_size < (off_t)sizeof(MappedMerkleTreeHeader)) {
+        throw ZerocashException("Merkle tree header is damaged: " + path);
+    }
+
+    void *mapped = mmap(NULL, sizeof(MappedMerkleTreeHeader), PROT_READ | PROT_WRITE, MAP_SHARED, this->headerFd, 0);
+    if (mapped == MAP_FAILED) {
+        throw ZerocashException("Could not map Merkle tree header " + path);
+    }
+    this->header = static_cast<MappedMerkleTreeHeader*>(mapped);
+
+    if (created) {
+        memcpy(this->header->magic, MAPPED_MERKLE_TREE_MAGIC, sizeof(this->header->magic));
+        this->header->version = MAPPED_MERKLE_TREE_VERSION;
+        this->header->treeHeight = height;
+        this->header->numLeaves = 0;
+        msync(this->header, sizeof(MappedMerkleTreeHeader), MS_SYNC);
+        return;
+    }
+
+    if (memcmp(this->header->magic, MAPPED_MERKLE_TREE_MAGIC, sizeof(this->header->magic)) != 0 ||
+        this->header->version != MAPPED_MERKLE_TREE_VERSION) {
+        throw ZerocashException("Not a Merkle tree store: " + this->directory);
+    }
+
+    if (this->header->treeHeight != height) {
+        throw ZerocashException("Merkle tree store has a different height: " + this->directory);
+    }
+
+    this->numLeaves = this->header->numLeaves;
+}
+
+void
+MappedMerkleTree::openLevel(uint32_t level)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/level-%02u.dat", level);
+    std::string path = this->directory + name;
+
+    MappedLevel mapped = { -1, NULL, 0 };
+    mapped.fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (mapped.fd < 0) {
+        throw ZerocashException("Could not open Merkle tree level " + path);
+    }
+    this->levels.push_back(mapped);
+
+    struct stat st;
+    if (fstat(mapped.fd, &st) != 0) {
+        throw ZerocashException("Could not open Merkle tree level " + path);
+    }
+
+    // Every record covered by the leaf count must be present
+    uint64_t capacity = st.st_size / SHA256_BLOCK_SIZE;
+    if (capacity < this->levelCount(level, this->numLeaves)) {
+        throw ZerocashException("Merkle tree level is damaged: " + path);
+    }
+
+    if (capacity > 0) {
+        void *data = mmap(NULL, capacity * SHA256_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mapped.fd, 0);
+        if (data == MAP_FAILED) {
+            throw ZerocashException("Could not map Merkle tree level " + path);
+        }
+        this->levels.back().data = static_cast<uint8_t*>(data);
+        this->levels.back().capacity = capacity;
+    }
+}
+
+void
+MappedMerkleTree::reserve(uint32_t level, uint64_t records)
+{
+    MappedLevel &mapped = this->levels[level];
+
+    if (records <= mapped.capacity) {
+        return;
+    }
+
+    uint64_t capacity = std::max<uint64_t>(std::max<uint64_t>(records, 2 * mapped.capacity), MAPPED_MERKLE_TREE_MIN_RECORDS);
+
+    if (ftruncate(mapped.fd, capacity * SHA256_BLOCK_SIZE) != 0) {
+        throw ZerocashException("Could not grow Merkle tree level file");
+    }
+
+    void *data = mmap(NULL, capacity * SHA256_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mapped.fd, 0);
+    if (data == MAP_FAILED) {
+        throw ZerocashException("Could not map Merkle tree level file");
+    }
+
+    if (mapped.data) {
+        munmap(mapped.data, mapped.capacity * SHA256_BLOCK_SIZE);
+    }
+    mapped.data = static_cast<uint8_t*>(data);
+    mapped.capacity = capacity;
+}
+
+void
+MappedMerkleTree::close()
+{
+    for (size_t i = 0; i < this->levels.size(); i++) {
+        if (this->levels[i].data) {
+            munmap(this->levels[i].data, this->levels[i].capacity * SHA256_BLOCK_SIZE);
+        }
+        ::close(this->levels[i].fd);
+    }
+    this->levels.clear();
+
+    if (this->header) {
+        munmap(this->header, sizeof(MappedMerkleTreeHeader));
+        this->header = NULL;
+    }
+    if (this->headerFd >= 0) {
+        ::close(this->headerFd);
+        this->headerFd = -1;
+    }
+}
+
+void
+MappedMerkleTree::rehashFrontier()
+{
+    // Appends rewrite the rightmost node of each level in place, and the
+    // header is only updated by sync(). After a crash those nodes may cover
+    // leaves past the stored count, so they are recomputed from it here.
+    if (this->numLeaves == 0) {
+        return;
+    }
+
+    for (uint32_t level = 1; level <= this->treeHeight; level++) {
+        this->updateNode(level, shiftRight(this->numLeaves - 1, level), this->numLeaves);
+    }
+}
+
+void
+MappedMerkleTree::sync()
+{
+    if (this->header == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < this->levels.size(); i++) {
+        if (this->levels[i].data) {
+            msync(this->levels[i].data, this->levels[i].capacity * SHA256_BLOCK_SIZE, MS_SYNC);
+        }
+    }
+
+    // The header page is only written here, after the levels are on disk.
+    if (this->header->numLeaves != this->numLeaves) {
+        this->header->numLeaves = this->numLeaves;
+        msync(this->header, sizeof(MappedMerkleTreeHeader), MS_SYNC);
+    }
+}
+
+bool
+MappedMerkleTree::isFull() const
+{
+    if (this->treeHeight >= 64) {
+        return (this->numLeaves == UINT64_MAX);
+    }
+    return (this->numLeaves == (uint64_t(1) << this->treeHeight));
+}
+
+uint64_t
+MappedMerkleTree::levelCount(uint32_t level, uint64_t leaves) const
+{
+    if (leaves == 0) {
+        return 0;
+    }
+    return shiftRight(leaves - 1, level) + 1;
+}
+
+const uint8_t*
+MappedMerkleTree::getNode(uint32_t level, uint64_t index, uint64_t leaves) const
+{
+    // Nodes to the right of the frontier are empty subtrees.
+    if (index >= this->levelCount(level, leaves)) {
+        return this->emptySubtrees->digest(level).data();
+    }
+
+    return this->levels[level].data + index * SHA256_BLOCK_SIZE;
+}
+
+void
+MappedMerkleTree::updateNode(uint32_t level, uint64_t index, uint64_t leaves)
+{
+    MerkleDigest left, right, hash;
+
+    memcpy(left.data(), this->getNode(level - 1, 2 * index, leaves), SHA256_BLOCK_SIZE);
+    memcpy(right.data(), this->getNode(level - 1, 2 * index + 1, leaves), SHA256_BLOCK_SIZE);
+    FlatMerkleTree::hashNode(left, right, hash);
+
+    memcpy(this->levels[level].data + index * SHA256_BLOCK_SIZE, hash.data(), SHA256_BLOCK_SIZE);
+}
+
+bool
+MappedMerkleTree::append(const MerkleDigest &leaf, uint64_t &position)
+{
+    std::vector<MerkleDigest> leaves(1, leaf);
+    return this->appendBatch(leaves, position);
+}
+
+bool
+MappedMerkleTree::appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition)
+{
+    uint64_t oldLeaves = this->numLeaves;
+    firstPosition = oldLeaves;
+
+    if (leaves.empty()) {
+        return true;
+    }
+
+    uint64_t capacity = (this->treeHeight >= 64) ? UINT64_MAX : (uint64_t(1) << this->treeHeight);
+    if (leaves.size() > capacity - oldLeaves) {
+        return false;
+    }
+
+    uint64_t newLeaves = oldLeaves + leaves.size();
+    uint64_t last = newLeaves - 1;
+
+    // Write the records first; the leaf count is only advanced once the
+    // whole path up to the root is consistent. It reaches the header on the
+    // next sync().
+    this->reserve(0, newLeaves);
+    for (size_t i = 0; i < leaves.size(); i++) {
+        memcpy(this->levels[0].data + (oldLeaves + i) * SHA256_BLOCK_SIZE, leaves[i].data(), SHA256_BLOCK_SIZE);
+    }
+
+    for (uint32_t level = 1; level <= this->treeHeight; level++) {
+        uint64_t lo = shiftRight(oldLeaves, level);
+        uint64_t hi = shiftRight(last, level);
+
+        this->reserve(level, hi + 1);
+        for (uint64_t index = lo; index <= hi; index++) {
+            this->updateNode(level, index, newLeaves);
+        }
+    }
+
+    this->numLeaves = newLeaves;
+    return true;
+}
+
+bool
+MappedMerkleTree::getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const
+{
+    uint64_t leaves = this->numLeaves;
+
+    if (position >= leaves) {
+        return false;
+    }
+
+    witness.resize(this->treeHeight);
+
+    for (uint32_t depth = 0; depth < this->treeHeight; depth++) {
+        uint32_t level = this->treeHeight - 1 - depth;
+        memcpy(witness[depth].data(), this->getNode(level, shiftRight(position, level) ^ 1, leaves), SHA256_BLOCK_SIZE);
+    }
+
+    return true;
+}
+
+void
+MappedMerkleTree::getRoot(MerkleDigest &r) const
+{
+    memcpy(r.data(), this->getNode(this->treeHeight, 0, this->numLeaves), SHA256_BLOCK_SIZE);
+}
+
+} /* namespace libzerocash */
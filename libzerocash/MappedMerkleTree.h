@@ -0,0 +1,110 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class MappedMerkleTree.
+
+ MappedMerkleTree is a persistent incremental Merkle tree. Every level is a
+ file of fixed-size 32-byte records (level-NN.dat), memory-mapped on open,
+ and a small header file (tree.meta) records the height and the leaf count
+ as of the last sync. Opening a store maps the files and rehashes the
+ rightmost node of each level, so it takes time linear in the height
+ regardless of the number of leaves. Appends update the records in place,
+ and root and witness queries touch one record per level.
+
+ Roots and witnesses are the same as those of IncrementalMerkleTree and
+ FlatMerkleTree.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef MAPPEDMERKLETREE_H_
+#define MAPPEDMERKLETREE_H_
+
+#include "Zerocash.h"
+#include "EmptySubtreeTable.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace libzerocash {
+
+#define MAPPED_MERKLE_TREE_MAGIC        "ZCMTREE"
+#define MAPPED_MERKLE_TREE_VERSION      1
+
+struct MappedMerkleTreeHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t treeHeight;
+    uint64_t numLeaves;
+};
+
+/************************** Mapped Merkle tree *******************************/
+
+class MappedMerkleTree {
+public:
+    // Opens the store in 'directory', creating the directory and an empty tree
+    // of the given height if there is none. Throws a ZerocashException if the
+    // files cannot be opened or mapped, or if an existing store is damaged or
+    // has a different height.
+    MappedMerkleTree(const std::string &directory, uint32_t height = ZEROCASH_DEFAULT_TREE_SIZE);
+    // Calls sync().
+    ~MappedMerkleTree();
+
+    // Appends a leaf and returns its position in 'position'. Returns false if the tree is full.
+    bool append(const MerkleDigest &leaf, uint64_t &position);
+
+    // Appends all leaves and rehashes each touched node once. Returns false
+    // (and appends nothing) if they do not fit.
+    bool appendBatch(const std::vector<MerkleDigest> &leaves, uint64_t &firstPosition);
+
+    // Authentication path of the leaf at 'position', ordered from the root downwards.
+    bool getWitness(uint64_t position, std::vector<MerkleDigest> &witness) const;
+
+    void getRoot(MerkleDigest &r) const;
+
+    // Flushes the level files and only then writes the leaf count to the
+    // header. Until then the header keeps the count of the previous sync, and
+    // after a crash the store reopens as the tree of that many leaves.
+    void sync();
+
+    uint32_t getHeight() const { return treeHeight; }
+    uint64_t size() const { return numLeaves; }
+    bool isFull() const;
+
+private:
+    struct MappedLevel {
+        int fd;
+        uint8_t *data;
+        uint64_t capacity;      // in records
+    };
+
+    MappedMerkleTree(const MappedMerkleTree&);
+    MappedMerkleTree& operator=(const MappedMerkleTree&);
+
+    std::string directory;
+    uint32_t treeHeight;
+    const EmptySubtreeTable *emptySubtrees;
+
+    int headerFd;
+    MappedMerkleTreeHeader *header;
+    std::vector<MappedLevel> levels;
+    uint64_t numLeaves;     // may be ahead of header->numLeaves until sync()
+
+    void openHeader(uint32_t height);
+    void openLevel(uint32_t level);
+    void reserve(uint32_t level, uint64_t records);
+    void close();
+    void rehashFrontier();
+
+    uint64_t levelCount(uint32_t level, uint64_t leaves) const;
+    const uint8_t* getNode(uint32_t level, uint64_t index, uint64_t leaves) const;
+    void updateNode(uint32_t level, uint64_t index, uint64_t leaves);
+};
+
+} /* namespace libzerocash */
+
+#endif /* MAPPEDMERKLETREE_H_ */
@@ -12,8 +12,10 @@
  *****************************************************************************/
 
 #include "MerkleTree.h"
+#include "MerkleTreeBuilder.h"
 #include "Zerocash.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -28,6 +30,8 @@ MerkleTree::MerkleTree() {
 
     actualDepth = 0;
 
+    emptySubtrees = &EmptySubtreeTable::get(depth, EmptySubtreeTable::HASHED);
+
     fullRoot = std::vector<bool>(SHA256_BLOCK_SIZE * 8, 0);
 
     coinlist.clear();
@@ -42,12 +46,14 @@ MerkleTree::MerkleTree(unsigned int d) {
 
     actualDepth = 0;
 
+    emptySubtrees = &EmptySubtreeTable::get(depth, EmptySubtreeTable::HASHED);
+
     fullRoot = std::vector<bool>(SHA256_BLOCK_SIZE * 8, 0);
 
     coinlist.clear();
 }
 
-MerkleTree::MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d) {
+MerkleTree::MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d, ThreadPool &pool) {
 	sha256_init(&ctx256);
 
     root = new Node();
@@ -62,19 +68,51 @@ MerkleTree::MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d
     actualSize = size;
     actualDepth = ceil(log(actualSize)/log(2));
 
+    // The leaves are padded up to a power of two with zero leaves. Subtrees
+    // made only of padding are taken from the shared empty subtree table
+    // instead of being built and hashed.
+    size_t paddedSize;
     if(size == 1) {
-        coinList.resize(2, std::vector<bool>(cm_size * 8, 0));
-        constructTree(root, coinList, 0, coinList.size()-1);
+        paddedSize = 2;
     }
     else if(!(size == 0) && !(size & (size - 1))){
-        constructTree(root, coinList, 0, coinList.size()-1);
+        paddedSize = size;
     }
     else {
         unsigned int newSize = ceil(log(size)/log(2));
-        coinList.resize(pow(2, newSize), std::vector<bool>(cm_size * 8, 0));
-        constructTree(root, coinList, 0, coinList.size()-1);
+        paddedSize = pow(2, newSize);
+    }
+
+    unsigned int paddedDepth = 0;
+    while(paddedDepth < 64 && (size_t(1) << paddedDepth) < paddedSize) {
+        paddedDepth++;
+    }
+    emptySubtrees = &EmptySubtreeTable::get(std::max(depth, paddedDepth), EmptySubtreeTable::HASHED);
+
+    // Hash the subtree one level at a time on the thread pool, then create
+    // the nodes. Fall back to the recursive construction for odd-sized values.
+    std::vector<MerkleDigest> leaves;
+    coinlist.reserve(size);
+
+    if(size != 0 && convertVectorsToDigests(coinList, leaves, pool)) {
+        std::vector< std::vector<MerkleDigest> > levels;
+        buildMerkleLevels(leaves, paddedDepth, EmptySubtreeTable::HASHED, pool, levels);
+
+        std::vector< std::vector< std::vector<bool>* > > values(paddedDepth + 1);
+        for(unsigned int level = 0; level <= paddedDepth; level++) {
+            values[level].resize(levels[level].size());
+        }
+        loadLevels(root, levels, paddedDepth, 0, values);
+
+        for(unsigned int level = 0; level <= paddedDepth; level++) {
+            convertDigestsToVectors(levels[level], values[level], pool);
+        }
+    }
+    else {
+        constructTree(root, coinList, 0, paddedSize-1);
     }
 
+    HashSiteScope site(SHA256_SITE_TREE);
     if(ceil(log(actualSize)/log(2)) == 0) {
         std::vector<bool> hash(SHA256_BLOCK_SIZE * 8);
         std::vector<bool> zeros(cm_size * 8, 0);
@@ -101,7 +139,15 @@ MerkleTree::MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d
 }
 
 void MerkleTree::constructTree(Node* curr, std::vector< std::vector<bool> > &coinList, size_t left, size_t right) {
-    if(right == left) {
+    if(left >= coinList.size()) {
+        // Nothing but padding below this node
+        unsigned int level = 0;
+        while((size_t(1) << level) < (right - left + 1)) {
+            level++;
+        }
+        curr->value = emptySubtrees->digestBits(level);
+    }
+    else if(right == left) {
         if(left < actualSize)
             addCoinMapping(coinList.at(left), left);
 
@@ -114,6 +160,7 @@ void MerkleTree::constructTree(Node* curr, std::vector< std::vector<bool> > &coi
         constructTree(curr->left, coinList, left, int((left+right)/2));
         constructTree(curr->right, coinList, int((left+right)/2)+1, right);
 
+        HashSiteScope site(SHA256_SITE_TREE);
         std::vector<bool> hash(SHA256_BLOCK_SIZE * 8);
         hashVectors(&ctx256, curr->left->value, curr->right->value, hash);
 
@@ -121,22 +168,59 @@ void MerkleTree::constructTree(Node* curr, std::vector< std::vector<bool> > &coi
     }
 }
 
+void MerkleTree::loadLevels(Node *curr, const std::vector< std::vector<MerkleDigest> > &levels, unsigned int level, size_t index,
+                            std::vector< std::vector< std::vector<bool>* > > &values) {
+    if(index >= levels.at(level).size()) {
+        // Nothing but padding below this node
+        curr->value = emptySubtrees->digestBits(level);
+    }
+    else if(level == 0) {
+        addCoinMapping(levels[0][index], index);
+        values[level][index] = &curr->value;
+    }
+    else {
+        values[level][index] = &curr->value;
+
+        curr->left = new Node();
+        curr->right = new Node();
+
+        loadLevels(curr->left, levels, level-1, 2*index, values);
+        loadLevels(curr->right, levels, level-1, 2*index+1, values);
+    }
+}
+
+// Commitments are keyed by their 32 bytes. Vectors of any other length
+// (never produced by CoinCommitment) are truncated or zero-padded.
+static void coinKey(const std::vector<bool> &hashV, MerkleDigest &key) {
+    if(hashV.size() == SHA256_BLOCK_SIZE * 8) {
+        convertVectorToBytes(hashV, key.data());
+        return;
+    }
+
+    key.fill(0);
+    for(size_t i = 0; i < hashV.size() && i < SHA256_BLOCK_SIZE * 8; i++) {
+        key[i / 8] |= hashV[i] << (7 - (i % 8));
+    }
+}
+
 void MerkleTree::addCoinMapping(const std::vector<bool> &hashV, int index) {
-    unsigned char hash[SHA256_BLOCK_SIZE + 1];
-    convertVectorToBytes(hashV, hash);
-    hash[SHA256_BLOCK_SIZE] = '\0';
+    MerkleDigest hash;
+    coinKey(hashV, hash);
+
+    coinlist.insert(hash, index);
+}
 
-    coinlist[hashV] = index;
+void MerkleTree::addCoinMapping(const MerkleDigest &hash, int index) {
+    coinlist.insert(hash, index);
 }
 
 int MerkleTree::getCoinMapping(const std::vector<bool> &hashV) {
-    unsigned char hash[SHA256_BLOCK_SIZE + 1];
-    convertVectorToBytes(hashV, hash);
-    hash[SHA256_BLOCK_SIZE] = '\0';
+    MerkleDigest hash;
+    coinKey(hashV, hash);
 
-    std::map<std::vector<bool>, int>::iterator it = coinlist.find(hashV);
-    if(it != coinlist.end()) {
-        return it->second;
+    uint64_t index;
+    if(coinlist.find(hash, index)) {
+        return index;
     }
 
     return -1;
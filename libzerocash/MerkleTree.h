@@ -15,6 +15,9 @@
 #include "Node.h"
 #include "libzerocash/utils/sha256.h"
 #include "Zerocash.h"
+#include "EmptySubtreeTable.h"
+#include "CommitmentIndex.h"
+#include "utils/ThreadPool.h"
 
 #include <vector>
 #include <iostream>
@@ -29,31 +32,30 @@ namespace libzerocash {
 
 class MerkleTree {
 private:
-    struct cmp_str
-    {
-        bool operator() (unsigned char * const a, unsigned char * const b)
-        {
-            return memcmp(a, b, SHA256_BLOCK_SIZE) == 0;
-        }
-    };
-
 	SHA256_CTX_mod ctx256;
     Node *root;
-    std::map<std::vector<bool>, int> coinlist;
+    CommitmentIndex coinlist;
     unsigned int actualSize;
     unsigned int depth;
     unsigned int actualDepth;
 
     std::vector<bool> fullRoot;
 
+    // Digests of the all-padding subtrees that fill the tree up to a power of two
+    const EmptySubtreeTable *emptySubtrees;
+
     void addCoinMapping(const std::vector<bool> &hashV, int index);
+    void addCoinMapping(const MerkleDigest &hash, int index);
     int getCoinMapping(const std::vector<bool> &hashV);
     void constructWitness(int left, int right, Node* curr, int currentLevel, int index, merkle_authentication_path &witness);
+    void loadLevels(Node *curr, const std::vector< std::vector<MerkleDigest> > &levels, unsigned int level, size_t index,
+                    std::vector< std::vector< std::vector<bool>* > > &values);
 
 public:
     MerkleTree();
     MerkleTree(unsigned int d);
-    MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d = 64);
+    MerkleTree(std::vector< std::vector<bool> > coinList, unsigned int d = 64,
+               ThreadPool &pool = ThreadPool::getDefault());
 
     void constructTree(Node *curr, std::vector< std::vector<bool> > &coinList, size_t left, size_t right);
     void getWitness(const std::vector<bool> &coin, merkle_authentication_path &authentication_path);
@@ -0,0 +1,107 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of the level-parallel Merkle tree builder.
+
+ See MerkleTreeBuilder.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "MerkleTreeBuilder.h"
+#include "FlatMerkleTree.h"
+#include "utils/util.h"
+
+#include <algorithm>
+
+namespace libzerocash {
+
+void buildMerkleLevels(const std::vector<MerkleDigest> &leaves, uint32_t height,
+                       EmptySubtreeTable::Convention convention, ThreadPool &pool,
+                       std::vector< std::vector<MerkleDigest> > &levels)
+{
+    const EmptySubtreeTable &emptySubtrees = EmptySubtreeTable::get(height, convention);
+
+    levels.assign(height + 1, std::vector<MerkleDigest>());
+    levels[0] = leaves;
+
+    if (leaves.empty()) {
+        return;
+    }
+
+    for (uint32_t level = 1; level <= height; level++) {
+        const std::vector<MerkleDigest> &children = levels[level - 1];
+        std::vector<MerkleDigest> &parents = levels[level];
+        const MerkleDigest &empty = emptySubtrees.digest(level - 1);
+
+        parents.resize((children.size() + 1) / 2);
+
+        pool.parallelFor(0, parents.size(), MERKLE_BUILDER_MIN_PARALLEL_NODES,
+            [&children, &parents, &empty, convention](size_t begin, size_t end) {
+                // Only the last parent of a level can lack its right child
+                size_t full = std::min(end, children.size() / 2);
+
+                if (full > begin) {
+                    hashMerklePairs(&children[2 * begin], full - begin, &parents[begin], convention);
+                }
+                if (full < end) {
+                    MerkleDigest block[2] = { children[2 * full], empty };
+                    hashMerklePairs(block, 1, &parents[full], convention);
+                }
+            });
+    }
+}
+
+void hashMerklePairs(const MerkleDigest *children, size_t numParents, MerkleDigest *parents,
+                     EmptySubtreeTable::Convention convention)
+{
+    static_assert(sizeof(MerkleDigest) == SHA256_BLOCK_SIZE, "digests must be packed");
+
+    HashSiteScope site(SHA256_SITE_TREE);
+    sha256_compress_blocks(children[0].data(), parents[0].data(), numParents);
+
+    if (convention == EmptySubtreeTable::ZERO_SENTINEL) {
+        for (size_t i = 0; i < numParents; i++) {
+            if (FlatMerkleTree::isZero(children[2 * i]) && FlatMerkleTree::isZero(children[2 * i + 1])) {
+                parents[i].fill(0);
+            }
+        }
+    }
+}
+
+bool convertVectorsToDigests(const std::vector< std::vector<bool> > &vectors,
+                             std::vector<MerkleDigest> &digests, ThreadPool &pool)
+{
+    for (size_t i = 0; i < vectors.size(); i++) {
+        if (vectors[i].size() != SHA256_BLOCK_SIZE * 8) {
+            return false;
+        }
+    }
+
+    digests.resize(vectors.size());
+    pool.parallelFor(0, vectors.size(), MERKLE_BUILDER_MIN_PARALLEL_NODES,
+        [&vectors, &digests](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                convertVectorToBytes(vectors[i], digests[i].data());
+            }
+        });
+
+    return true;
+}
+
+void convertDigestsToVectors(const std::vector<MerkleDigest> &digests,
+                             const std::vector< std::vector<bool>* > &out, ThreadPool &pool)
+{
+    pool.parallelFor(0, out.size(), MERKLE_BUILDER_MIN_PARALLEL_NODES,
+        [&digests, &out](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                out[i]->resize(SHA256_BLOCK_SIZE * 8);
+                convertBytesToVector(digests[i].data(), *out[i]);
+            }
+        });
+}
+
+} /* namespace libzerocash */
@@ -0,0 +1,56 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of the level-parallel Merkle tree builder.
+
+ The builder hashes a tree one level at a time. Each level is a contiguous
+ array of digests and is split across the threads of a ThreadPool, so
+ building a tree over a long list of commitments scales with the number of
+ cores.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef MERKLETREEBUILDER_H_
+#define MERKLETREEBUILDER_H_
+
+#include "EmptySubtreeTable.h"
+#include "utils/ThreadPool.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace libzerocash {
+
+// Levels smaller than this are hashed on the calling thread only.
+#define MERKLE_BUILDER_MIN_PARALLEL_NODES 1024
+
+// Computes every level of a Merkle tree of the given height whose leftmost
+// leaves are 'leaves'. On return levels[0] holds the leaves and levels[l]
+// the ceil(n / 2^l) nodes that cover at least one leaf; levels[height] holds
+// the root. A right child past the end of its level is the empty subtree of
+// the table for 'convention'.
+void buildMerkleLevels(const std::vector<MerkleDigest> &leaves, uint32_t height,
+                       EmptySubtreeTable::Convention convention, ThreadPool &pool,
+                       std::vector< std::vector<MerkleDigest> > &levels);
+
+// Sets parents[i] to the hash of children[2i] || children[2i + 1] for every
+// i < numParents. Sibling pairs are contiguous 64-byte blocks, so they are
+// hashed together by sha256_compress_blocks. Under ZERO_SENTINEL the parent
+// of two all-zero children is all-zero.
+void hashMerklePairs(const MerkleDigest *children, size_t numParents, MerkleDigest *parents,
+                     EmptySubtreeTable::Convention convention);
+
+// Converts between 256-bit vectors and digests in parallel (for the
+// vector<bool> based trees). Returns false if a vector is not 256 bits long.
+bool convertVectorsToDigests(const std::vector< std::vector<bool> > &vectors,
+                             std::vector<MerkleDigest> &digests, ThreadPool &pool);
+void convertDigestsToVectors(const std::vector<MerkleDigest> &digests,
+                             const std::vector< std::vector<bool>* > &out, ThreadPool &pool);
+
+} /* namespace libzerocash */
+
+#endif /* MERKLETREEBUILDER_H_ */
@@ -16,7 +16,7 @@
 
 namespace libzerocash {
 
-MintTransaction::MintTransaction(): coinValue(0), internalCommitment(), externalCommitment()
+MintTransaction::MintTransaction(): coinValue(), internalCommitment(), externalCommitment()
 { }
 
 /**
@@ -25,10 +25,8 @@ MintTransaction::MintTransaction(): coinValue(0), internalCommitment(), external
  * @param c the coin to mint.
  * throws runtime_error if there's a fundamental error (e.g out of memory) FIXME acutally do this
  */
-MintTransaction::MintTransaction(const Coin& c): coinValue(v_size)
+MintTransaction::MintTransaction(const Coin& c): coinValue(c.coinValue)
 {
-    convertIntToBytesVector(c.getValue(), this->coinValue);
-
 	internalCommitment = c.getInternalCommitment();
 	externalCommitment = c.getCoinCommitment();
 }
@@ -43,11 +41,8 @@ MintTransaction::MintTransaction(const Coin& c): coinValue(v_size)
  */
 bool MintTransaction::verify() const{
 
-	// Check that the internal commitment is the right size
-	if (this->internalCommitment.size() != k_size) {
-		return false;
-	}
-
+	// The sizes of both commitments are fixed by their types.
+	//
 	// The external commitment should formulated as:
 	// H( internalCommitment || 0^192 || coinValue)
 	//
@@ -57,15 +52,9 @@ bool MintTransaction::verify() const{
 	//
 	// We use the constructor for CoinCommitment to do this.
 
-	try {
-		CoinCommitment comp(this->coinValue, this->internalCommitment);
-
-		return (comp == this->externalCommitment);
-	} catch (std::runtime_error) {
-		return false;
-	}
+	CoinCommitment comp(this->coinValue, this->internalCommitment);
 
-	return false;
+	return (comp == this->externalCommitment);
 }
 
 const CoinCommitmentValue& MintTransaction::getMintedCoinCommitmentValue() const{
@@ -73,7 +62,7 @@ const CoinCommitmentValue& MintTransaction::getMintedCoinCommitmentValue() const
 }
 
 uint64_t MintTransaction::getMonetaryValue() const {
-    return convertBytesVectorToInt(this->coinValue);
+    return convertBytesToInt(this->coinValue.data(), v_size);
 }
 
 } /* namespace libzerocash */
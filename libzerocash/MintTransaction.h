@@ -15,8 +15,9 @@
 #include "serialize.h"
 #include "CoinCommitment.h"
 #include "Coin.h"
+#include "FixedBytes.h"
 
-typedef std::vector<unsigned char> CoinCommitmentValue;
+typedef libzerocash::CommitmentValue CoinCommitmentValue;
 
 namespace libzerocash{
 
@@ -64,8 +65,8 @@ public:
     )
 
 private:
-	std::vector<unsigned char>	coinValue;			// coin value
-	std::vector<unsigned char>	internalCommitment; // "k" in paper notation
+	ValueBytes					coinValue;			// coin value
+	InternalCommitment			internalCommitment; // "k" in paper notation
     CoinCommitment				externalCommitment; // "cm" in paper notation
 
 	const CoinCommitment& getCoinCommitment() const { return this->externalCommitment; }
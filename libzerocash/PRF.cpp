@@ -0,0 +1,136 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class PRF.
+
+ See PRF.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include <stdexcept>
+
+#include <openssl/crypto.h>
+
+#include "Zerocash.h"
+#include "PRF.h"
+
+namespace libzerocash {
+
+// The second half of the block: 'tagBits' bits of 'tag' (taken from its top)
+// followed by the leading bits of the 32-byte 'input'.
+static void tagInput(unsigned char tag, unsigned int tagBits, const unsigned char *input, unsigned char *suffix)
+{
+    suffix[0] = tag | (input[0] >> tagBits);
+    for (size_t i = 1; i < SHA256_BLOCK_SIZE; i++) {
+        suffix[i] = (input[i - 1] << (8 - tagBits)) | (input[i] >> tagBits);
+    }
+}
+
+static void snInput(const CoinNonce& rho, unsigned char *suffix)
+{
+    tagInput(0x40, 2, rho.data(), suffix);
+}
+
+static void pkInput(size_t i, const SignatureHash& h_S, unsigned char *suffix)
+{
+    if (i > 1) {
+        throw std::runtime_error("PRF: a pour has inputs 0 and 1 only");
+    }
+    tagInput(i ? 0xa0 : 0x80, 3, h_S.data(), suffix);
+}
+
+PRF::PRF(const std::vector<unsigned char>& a_sk)
+{
+    if (a_sk.size() != a_sk_size) {
+        throw std::runtime_error("PRF: address secrets are 32 bytes");
+    }
+    sha256_prefix_init(&this->key, a_sk.data());
+}
+
+PRF::~PRF()
+{
+    OPENSSL_cleanse(&this->key, sizeof(this->key));
+}
+
+void PRF::addr(std::vector<unsigned char>& a_pk) const
+{
+    unsigned char zeros[SHA256_BLOCK_SIZE] = {0};
+
+    a_pk.resize(a_pk_size);
+    HashSiteScope site(SHA256_SITE_PRF);
+    sha256_prefix_compress(&this->key, zeros, a_pk.data());
+}
+
+void PRF::sn(const CoinNonce& rho, SerialNumber& sn) const
+{
+    unsigned char suffix[SHA256_BLOCK_SIZE];
+
+    snInput(rho, suffix);
+    HashSiteScope site(SHA256_SITE_PRF);
+    sha256_prefix_compress(&this->key, suffix, sn.data());
+}
+
+void PRF::pk(size_t i, const SignatureHash& h_S, PourMAC& mac) const
+{
+    unsigned char suffix[SHA256_BLOCK_SIZE];
+
+    pkInput(i, h_S, suffix);
+    HashSiteScope site(SHA256_SITE_MAC);
+    sha256_prefix_compress(&this->key, suffix, mac.data());
+}
+
+void PRF::sn(const std::vector<CoinNonce>& rhos, std::vector<SerialNumber>& sns) const
+{
+    size_t count = rhos.size();
+    std::vector<unsigned char> suffixes(SHA256_BLOCK_SIZE * count);
+
+    for (size_t j = 0; j < count; j++) {
+        snInput(rhos[j], &suffixes[SHA256_BLOCK_SIZE * j]);
+    }
+
+    // A vector of serial numbers is a contiguous array of hashes
+    static_assert(sizeof(SerialNumber) == sn_size, "SerialNumber must hold its bytes only");
+    sns.resize(count);
+    if (count > 0) {
+        HashSiteScope site(SHA256_SITE_PRF);
+        sha256_prefix_compress_many(&this->key, suffixes.data(), sns[0].data(), count);
+    }
+}
+
+void PRF::snAndPk(const std::vector<CoinNonce>& rhos,
+                  const std::vector<size_t>& inputs,
+                  const std::vector<SignatureHash>& h_Ss,
+                  std::vector<SerialNumber>& sns,
+                  std::vector<PourMAC>& macs) const
+{
+    size_t count = rhos.size();
+    if (inputs.size() != count || h_Ss.size() != count) {
+        throw std::runtime_error("PRF: one input index and h_S are needed per coin");
+    }
+
+    // Serial numbers first, then MACs
+    std::vector<unsigned char> suffixes(2 * SHA256_BLOCK_SIZE * count);
+    for (size_t j = 0; j < count; j++) {
+        snInput(rhos[j], &suffixes[SHA256_BLOCK_SIZE * j]);
+        pkInput(inputs[j], h_Ss[j], &suffixes[SHA256_BLOCK_SIZE * (count + j)]);
+    }
+
+    // Separate runs so that the hash counters tell serial numbers and MACs apart
+    static_assert(sizeof(PourMAC) == h_size, "PourMAC must hold its bytes only");
+    sns.resize(count);
+    macs.resize(count);
+    if (count > 0) {
+        {
+            HashSiteScope site(SHA256_SITE_PRF);
+            sha256_prefix_compress_many(&this->key, suffixes.data(), sns[0].data(), count);
+        }
+        HashSiteScope site(SHA256_SITE_MAC);
+        sha256_prefix_compress_many(&this->key, &suffixes[SHA256_BLOCK_SIZE * count], macs[0].data(), count);
+    }
+}
+
+} /* namespace libzerocash */
@@ -0,0 +1,73 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class PRF.
+
+ The pseudorandom functions keyed by an address secret a_sk (section 4.1 of
+ the Zerocash paper). Each is a single SHA-256 compression of the block
+ a_sk || tag || input, the input truncated to fill the rest:
+
+     PRF^addr(z)   = H(a_sk || 00 || z)     a_pk = PRF^addr(0)
+     PRF^sn(rho)   = H(a_sk || 01 || rho)   serial numbers
+     PRF^pk_i(h_S) = H(a_sk || 10i || h_S)  the MAC of pour input i
+
+ A PRF object precomputes what depends only on a_sk, so that it can be
+ evaluated cheaply on every coin of an address, and has batch forms that
+ hash all the inputs of one call together.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef PRF_H_
+#define PRF_H_
+
+#include <vector>
+#include <stddef.h>
+
+#include "FixedBytes.h"
+#include "utils/sha256.h"
+
+namespace libzerocash {
+
+/********************************** PRF **************************************/
+
+class PRF {
+public:
+    explicit PRF(const std::vector<unsigned char>& a_sk);
+    ~PRF();
+
+    // a_pk of the address
+    void addr(std::vector<unsigned char>& a_pk) const;
+
+    // The serial number of the coin with nonce 'rho'
+    void sn(const CoinNonce& rho, SerialNumber& sn) const;
+
+    // The MAC of h_S for pour input 'i' (0 or 1)
+    void pk(size_t i, const SignatureHash& h_S, PourMAC& mac) const;
+
+    // Serial numbers of many coins of the address, e.g. when a wallet scans
+    // for its spent coins.
+    void sn(const std::vector<CoinNonce>& rhos, std::vector<SerialNumber>& sns) const;
+
+    // Serial number and MAC of each of several spent coins of the address,
+    // coin j being input 'inputs[j]' of the pour with signature hash
+    // 'h_Ss[j]'. All the hashes are computed in one pass.
+    void snAndPk(const std::vector<CoinNonce>& rhos,
+                 const std::vector<size_t>& inputs,
+                 const std::vector<SignatureHash>& h_Ss,
+                 std::vector<SerialNumber>& sns,
+                 std::vector<PourMAC>& macs) const;
+
+private:
+    PRF(const PRF&);
+    PRF& operator=(const PRF&);
+
+    SHA256_PREFIX key;
+};
+
+} /* namespace libzerocash */
+
+#endif /* PRF_H_ */
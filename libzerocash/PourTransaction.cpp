@@ -11,6 +11,9 @@
  * @copyright  MIT license (see LICENSE file)
  *****************************************************************************/
 
+#include <algorithm>
+#include <map>
+
 #include <cryptopp/osrng.h>
 using CryptoPP::AutoSeededRandomPool;
 
@@ -32,6 +35,7 @@ using CryptoPP::PK_EncryptorFilter;
 
 #include "Zerocash.h"
 #include "PourTransaction.h"
+#include "PRF.h"
 
 #include "libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp"
 #include "zerocash_pour_ppzksnark/zerocash_pour_gadget.hpp"
@@ -60,11 +64,11 @@ PourTransaction::PourTransaction(uint16_t version_num,
                                  const std::vector<unsigned char>& pubkeyHash,
                                  const Coin& c_1_new,
                                  const Coin& c_2_new) :
-    publicValue(v_size), serialNumber_1(sn_size), serialNumber_2(sn_size), MAC_1(h_size), MAC_2(h_size)
+    publicValue(), serialNumber_1(), serialNumber_2(), MAC_1(), MAC_2()
 {
     this->version = version_num;
 
-    convertIntToBytesVector(v_pub, this->publicValue);
+    convertIntToBytes(v_pub, this->publicValue.data(), v_size);
 
     this->cm_1 = c_1_new.getCoinCommitment();
     this->cm_2 = c_2_new.getCoinCommitment();
@@ -92,8 +96,8 @@ PourTransaction::PourTransaction(uint16_t version_num,
 
 	convertBytesVectorToVector(rt, root_bv);
 
-    convertBytesVectorToVector(c_1_new.getCoinCommitment().getCommitmentValue(), cm_new_1_bv);
-    convertBytesVectorToVector(c_2_new.getCoinCommitment().getCommitmentValue(), cm_new_2_bv);
+    convertBytesToVector(c_1_new.getCoinCommitment().getCommitmentValue().data(), cm_new_1_bv);
+    convertBytesToVector(c_2_new.getCoinCommitment().getCommitmentValue().data(), cm_new_2_bv);
 
     convertBytesVectorToVector(addr_1_old.getAddressSecret(), addr_sk_old_1_bv);
     convertBytesVectorToVector(addr_2_old.getAddressSecret(), addr_sk_old_2_bv);
@@ -101,63 +105,31 @@ PourTransaction::PourTransaction(uint16_t version_num,
     convertBytesVectorToVector(addr_1_new.getPublicAddressSecret(), addr_pk_new_1_bv);
     convertBytesVectorToVector(addr_2_new.getPublicAddressSecret(), addr_pk_new_2_bv);
 
-    convertBytesVectorToVector(c_1_old.getR(), rand_old_1_bv);
-    convertBytesVectorToVector(c_2_old.getR(), rand_old_2_bv);
-
-    convertBytesVectorToVector(c_1_new.getR(), rand_new_1_bv);
-    convertBytesVectorToVector(c_2_new.getR(), rand_new_2_bv);
-
-    convertBytesVectorToVector(c_1_old.getRho(), nonce_old_1_bv);
-    convertBytesVectorToVector(c_2_old.getRho(), nonce_old_2_bv);
+    convertBytesToVector(c_1_old.getR().data(), rand_old_1_bv);
+    convertBytesToVector(c_2_old.getR().data(), rand_old_2_bv);
 
-    convertBytesVectorToVector(c_1_new.getRho(), nonce_new_1_bv);
-    convertBytesVectorToVector(c_2_new.getRho(), nonce_new_2_bv);
+    convertBytesToVector(c_1_new.getR().data(), rand_new_1_bv);
+    convertBytesToVector(c_2_new.getR().data(), rand_new_2_bv);
 
-    std::vector<unsigned char> v_old_1_conv(v_size, 0);
-    convertIntToBytesVector(c_1_old.getValue(), v_old_1_conv);
-    libzerocash::convertBytesVectorToVector(v_old_1_conv, val_old_1_bv);
+    convertBytesToVector(c_1_old.getRho().data(), nonce_old_1_bv);
+    convertBytesToVector(c_2_old.getRho().data(), nonce_old_2_bv);
 
-    std::vector<unsigned char> v_old_2_conv(v_size, 0);
-    convertIntToBytesVector(c_2_old.getValue(), v_old_2_conv);
-    libzerocash::convertBytesVectorToVector(v_old_2_conv, val_old_2_bv);
+    convertBytesToVector(c_1_new.getRho().data(), nonce_new_1_bv);
+    convertBytesToVector(c_2_new.getRho().data(), nonce_new_2_bv);
 
-    std::vector<unsigned char> v_new_1_conv(v_size, 0);
-    convertIntToBytesVector(c_1_new.getValue(), v_new_1_conv);
-    libzerocash::convertBytesVectorToVector(v_new_1_conv, val_new_1_bv);
+    convertBytesToVector(c_1_old.coinValue.data(), val_old_1_bv);
+    convertBytesToVector(c_2_old.coinValue.data(), val_old_2_bv);
 
-    std::vector<unsigned char> v_new_2_conv(v_size, 0);
-    convertIntToBytesVector(c_2_new.getValue(), v_new_2_conv);
-    libzerocash::convertBytesVectorToVector(v_new_2_conv, val_new_2_bv);
+    convertBytesToVector(c_1_new.coinValue.data(), val_new_1_bv);
+    convertBytesToVector(c_2_new.coinValue.data(), val_new_2_bv);
 
-    convertBytesVectorToVector(this->publicValue, val_pub_bv);
+    convertBytesToVector(this->publicValue.data(), val_pub_bv);
 
-    std::vector<bool> nonce_old_1(rho_size * 8);
-    copy(nonce_old_1_bv.begin(), nonce_old_1_bv.end(), nonce_old_1.begin());
-    nonce_old_1.erase(nonce_old_1.end()-2, nonce_old_1.end());
+    PRF prf_1(addr_1_old.getAddressSecret());
+    PRF prf_2(addr_2_old.getAddressSecret());
 
-    nonce_old_1.insert(nonce_old_1.begin(), 1);
-    nonce_old_1.insert(nonce_old_1.begin(), 0);
-
-    std::vector<bool> sn_internal_1;
-    concatenateVectors(addr_sk_old_1_bv, nonce_old_1, sn_internal_1);
-    std::vector<bool> sn_old_1_bv(sn_size * 8);
-    hashVector(sn_internal_1, sn_old_1_bv);
-
-    convertVectorToBytesVector(sn_old_1_bv, this->serialNumber_1);
-
-    std::vector<bool> nonce_old_2(rho_size * 8);
-    copy(nonce_old_2_bv.begin(), nonce_old_2_bv.end(), nonce_old_2.begin());
-    nonce_old_2.erase(nonce_old_2.end()-2, nonce_old_2.end());
-
-    nonce_old_2.insert(nonce_old_2.begin(), 1);
-    nonce_old_2.insert(nonce_old_2.begin(), 0);
-
-    std::vector<bool> sn_internal_2;
-    concatenateVectors(addr_sk_old_2_bv, nonce_old_2, sn_internal_2);
-    std::vector<bool> sn_old_2_bv(sn_size * 8);
-    hashVector(sn_internal_2, sn_old_2_bv);
-
-    convertVectorToBytesVector(sn_old_2_bv, this->serialNumber_2);
+    prf_1.sn(c_1_old.getRho(), this->serialNumber_1);
+    prf_2.sn(c_2_old.getRho(), this->serialNumber_2);
 
     unsigned char h_S_bytes[h_size];
     unsigned char pubkeyHash_bytes[h_size];
@@ -170,33 +142,13 @@ PourTransaction::PourTransaction(uint16_t version_num,
     std::vector<bool> h_S_bv(h_size * 8);
     convertBytesToVector(h_S_bytes, h_S_bv);
 
-    std::vector<bool> h_S_internal1(h_size * 8);
-    convertBytesToVector(h_S_bytes, h_S_internal1);
-    h_S_internal1.erase(h_S_internal1.end()-3, h_S_internal1.end());
-    std::vector<bool> h_S_internal2 = h_S_internal1;
-
-    h_S_internal1.insert(h_S_internal1.begin(), 0);
-    h_S_internal1.insert(h_S_internal1.begin(), 0);
-    h_S_internal1.insert(h_S_internal1.begin(), 1);
-
-    h_S_internal2.insert(h_S_internal2.begin(), 1);
-    h_S_internal2.insert(h_S_internal2.begin(), 0);
-    h_S_internal2.insert(h_S_internal2.begin(), 1);
-
-    std::vector<bool> MAC_1_internal;
-    concatenateVectors(addr_sk_old_1_bv, h_S_internal1, MAC_1_internal);
-    std::vector<bool> MAC_1_bv(h_size * 8);
-    hashVector(MAC_1_internal, MAC_1_bv);
-    convertVectorToBytesVector(MAC_1_bv, this->MAC_1);
-
-    std::vector<bool> MAC_2_internal;
-    concatenateVectors(addr_sk_old_2_bv, h_S_internal2, MAC_2_internal);
-    std::vector<bool> MAC_2_bv(h_size * 8);
-    hashVector(MAC_2_internal, MAC_2_bv);
-    convertVectorToBytesVector(MAC_2_bv, this->MAC_2);
+    SignatureHash h_S;
+    std::copy(h_S_bytes, h_S_bytes + h_size, h_S.begin());
+    prf_1.pk(0, h_S, this->MAC_1);
+    prf_2.pk(1, h_S, this->MAC_2);
 
     if(this->version > 0){
-        zerocash_pour_proof<ZerocashParams::zerocash_pp> proofObj = zerocash_pour_ppzksnark_prover<ZerocashParams::zerocash_pp>(params.getProvingKey(this->version),
+        zerocash_pour_proof<ZerocashParams::zerocash_pp> proofObj = params.getProver(this->version).prove(
             { patMAC_1, patMAC_2 },
             { patMerkleIdx_1, patMerkleIdx_2 },
             root_bv,
@@ -276,18 +228,79 @@ bool PourTransaction::verify(ZerocashParams& params,
 		return true;
 	}
 
+    const zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>& pvk = params.getProcessedVerificationKey(this->version);
+
+    r1cs_ppzksnark_primary_input<ZerocashParams::zerocash_pp> input;
     zerocash_pour_proof<ZerocashParams::zerocash_pp> proof_SNARK;
+    if (!this->proofStatement(pvk, pubkeyHash, merkleRoot, input, proof_SNARK)) {
+        return false;
+    }
+
+    return zerocash_pour_ppzksnark_online_verifier<ZerocashParams::zerocash_pp>(pvk, input, proof_SNARK);
+}
+
+bool PourTransaction::verifyBatch(ZerocashParams& params,
+                                  const std::vector<PourTransaction>& pours,
+                                  const std::vector<std::vector<unsigned char> >& pubkeyHashes,
+                                  const std::vector<MerkleRootType>& merkleRoots,
+                                  std::vector<bool>& results)
+{
+    if (pubkeyHashes.size() != pours.size() || merkleRoots.size() != pours.size()) {
+        throw ZerocashException("One public key hash and merkle root are needed per pour");
+    }
+
+    // The proofs of each version are checked together, under its verification key
+    struct Batch {
+        std::vector<size_t> pours;
+        std::vector<r1cs_ppzksnark_primary_input<ZerocashParams::zerocash_pp> > inputs;
+        std::vector<zerocash_pour_proof<ZerocashParams::zerocash_pp> > proofs;
+    };
+    std::map<uint16_t, Batch> batches;
+
+    results.assign(pours.size(), false);
+    for (size_t i = 0; i < pours.size(); i++) {
+        if (pours[i].version == 0) {
+            results[i] = true;
+            continue;
+        }
+
+        Batch &batch = batches[pours[i].version];
+        r1cs_ppzksnark_primary_input<ZerocashParams::zerocash_pp> input;
+        zerocash_pour_proof<ZerocashParams::zerocash_pp> proof;
+        if (pours[i].proofStatement(params.getProcessedVerificationKey(pours[i].version), pubkeyHashes[i], merkleRoots[i], input, proof)) {
+            batch.pours.push_back(i);
+            batch.inputs.push_back(std::move(input));
+            batch.proofs.push_back(std::move(proof));
+        }
+    }
+
+    for (std::map<uint16_t, Batch>::const_iterator it = batches.begin(); it != batches.end(); ++it) {
+        const Batch &batch = it->second;
+        std::vector<bool> batchResults;
+        zerocash_pour_ppzksnark_batch_verifier<ZerocashParams::zerocash_pp>(params.getProcessedVerificationKey(it->first),
+                                                                            batch.inputs,
+                                                                            batch.proofs,
+                                                                            batchResults);
+        for (size_t j = 0; j < batch.pours.size(); j++) {
+            results[batch.pours[j]] = batchResults[j];
+        }
+    }
+
+    return std::find(results.begin(), results.end(), false) == results.end();
+}
+
+bool PourTransaction::proofStatement(const zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>& pvk,
+                                     const std::vector<unsigned char>& pubkeyHash,
+                                     const MerkleRootType& merkleRoot,
+                                     r1cs_ppzksnark_primary_input<ZerocashParams::zerocash_pp>& input,
+                                     zerocash_pour_proof<ZerocashParams::zerocash_pp>& proof) const
+{
     std::stringstream ss;
     ss.str(this->zkSNARK);
-    ss >> proof_SNARK;
+    ss >> proof;
 
 	if (merkleRoot.size() != root_size) { return false; }
 	if (pubkeyHash.size() != h_size)	{ return false; }
-	if (this->serialNumber_1.size() != sn_size)	{ return false; }
-	if (this->serialNumber_2.size() != sn_size)	{ return false; }
-	if (this->publicValue.size() != v_size) { return false; }
-	if (this->MAC_1.size() != h_size)	{ return false; }
-	if (this->MAC_2.size() != h_size)	{ return false; }
 
     std::vector<bool> root_bv(root_size * 8);
     std::vector<bool> sn_old_1_bv(sn_size * 8);
@@ -299,13 +312,13 @@ bool PourTransaction::verify(ZerocashParams& params,
     std::vector<bool> MAC_2_bv(h_size * 8);
 
     convertBytesVectorToVector(merkleRoot, root_bv);
-    convertBytesVectorToVector(this->serialNumber_1, sn_old_1_bv);
-    convertBytesVectorToVector(this->serialNumber_2, sn_old_2_bv);
-    convertBytesVectorToVector(this->cm_1.getCommitmentValue(), cm_new_1_bv);
-    convertBytesVectorToVector(this->cm_2.getCommitmentValue(), cm_new_2_bv);
-    convertBytesVectorToVector(this->publicValue, val_pub_bv);
-    convertBytesVectorToVector(this->MAC_1, MAC_1_bv);
-    convertBytesVectorToVector(this->MAC_2, MAC_2_bv);
+    convertBytesToVector(this->serialNumber_1.data(), sn_old_1_bv);
+    convertBytesToVector(this->serialNumber_2.data(), sn_old_2_bv);
+    convertBytesToVector(this->cm_1.getCommitmentValue().data(), cm_new_1_bv);
+    convertBytesToVector(this->cm_2.getCommitmentValue().data(), cm_new_2_bv);
+    convertBytesToVector(this->publicValue.data(), val_pub_bv);
+    convertBytesToVector(this->MAC_1.data(), MAC_1_bv);
+    convertBytesToVector(this->MAC_2.data(), MAC_2_bv);
 
     unsigned char h_S_bytes[h_size];
     unsigned char pubkeyHash_bytes[h_size];
@@ -315,32 +328,26 @@ bool PourTransaction::verify(ZerocashParams& params,
     SHA256_Update(&sha256, pubkeyHash_bytes, h_size);
     SHA256_Final(h_S_bytes, &sha256);
 
-    std::vector<bool> h_S_internal(h_size * 8);
-    convertBytesToVector(h_S_bytes, h_S_internal);
-    h_S_internal.erase(h_S_internal.end()-2, h_S_internal.end());
-    h_S_internal.insert(h_S_internal.begin(), 0);
-    h_S_internal.insert(h_S_internal.begin(), 1);
-
     std::vector<bool> h_S_bv(h_size * 8);
     convertBytesToVector(h_S_bytes, h_S_bv);
 
-    bool snark_result = zerocash_pour_ppzksnark_verifier<ZerocashParams::zerocash_pp>(params.getVerificationKey(this->version),
-                                                                                      root_bv,
-                                                                                      { sn_old_1_bv, sn_old_2_bv },
-                                                                                      { cm_new_1_bv, cm_new_2_bv },
-                                                                                      val_pub_bv,
-                                                                                      h_S_bv,
-                                                                                      { MAC_1_bv, MAC_2_bv },
-                                                                                      proof_SNARK);
+    input = zerocash_pour_input_map<Fr<ZerocashParams::zerocash_pp> >(pvk.num_old_coins,
+                                                                      pvk.num_new_coins,
+                                                                      root_bv,
+                                                                      { sn_old_1_bv, sn_old_2_bv },
+                                                                      { cm_new_1_bv, cm_new_2_bv },
+                                                                      val_pub_bv,
+                                                                      h_S_bv,
+                                                                      { MAC_1_bv, MAC_2_bv });
 
-    return snark_result;
+    return true;
 }
 
-const std::vector<unsigned char>& PourTransaction::getSpentSerial1() const{
+const SerialNumber& PourTransaction::getSpentSerial1() const{
 	return this->serialNumber_1;
 }
 
-const std::vector<unsigned char>& PourTransaction::getSpentSerial2() const{
+const SerialNumber& PourTransaction::getSpentSerial2() const{
 	return this->serialNumber_2;
 }
 
@@ -362,7 +369,7 @@ const CoinCommitmentValue& PourTransaction::getNewCoinCommitmentValue2() const{
  * Returns the amount of money this transaction converts back into basecoin.
  */
 uint64_t PourTransaction::getMonetaryValueOut() const{
-	return convertBytesVectorToInt(this->publicValue);
+	return convertBytesToInt(this->publicValue.data(), v_size);
 }
 
 } /* namespace libzerocash */
@@ -14,10 +14,11 @@
 
 #include "serialize.h"
 #include "Coin.h"
+#include "FixedBytes.h"
 #include "ZerocashParams.h"
 #include "Zerocash.h"
 
-typedef std::vector<unsigned char> CoinCommitmentValue;
+typedef libzerocash::CommitmentValue CoinCommitmentValue;
 
 namespace libzerocash {
 
@@ -77,8 +78,26 @@ public:
                 std::vector<unsigned char> &pubkeyHash,
                 const MerkleRootType &merkleRoot) const;
 
-	const std::vector<unsigned char>& getSpentSerial1() const;
-	const std::vector<unsigned char>& getSpentSerial2() const;
+    /**
+     * Verifies many pour transactions at once, e.g. those of a block. The
+     * proofs are checked together, which is much faster than calling verify
+     * on each, and the results are the same.
+     *
+     * @param params the cryptographic parameters used to verify the proofs.
+     * @param pours the transactions to verify
+     * @param pubkeyHashes the hash of the public key bound to each transaction
+     * @param merkleRoots the root of the merkle tree the coins of each transaction were in.
+     * @param results set to whether each transaction is correct.
+     * @return true if all are correct, false otherwise.
+     */
+    static bool verifyBatch(ZerocashParams& params,
+                            const std::vector<PourTransaction>& pours,
+                            const std::vector<std::vector<unsigned char> >& pubkeyHashes,
+                            const std::vector<MerkleRootType>& merkleRoots,
+                            std::vector<bool>& results);
+
+	const SerialNumber& getSpentSerial1() const;
+	const SerialNumber& getSpentSerial2() const;
 
 	/**
      * Returns the hash of the first new coin generated by this Pour.
@@ -118,14 +137,21 @@ public:
 
 
 private:
-
-	std::vector<unsigned char>  publicValue;		// public output value of the Pour transaction
-    std::vector<unsigned char>	serialNumber_1;		// serial number of input (old) coin #1
-    std::vector<unsigned char>	serialNumber_2;		// serial number of input (old) coin #1
+    // The primary input and the proof to check for this transaction, false
+    // if the arguments have the wrong sizes.
+    bool proofStatement(const zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>& pvk,
+                        const std::vector<unsigned char>& pubkeyHash,
+                        const MerkleRootType& merkleRoot,
+                        r1cs_ppzksnark_primary_input<ZerocashParams::zerocash_pp>& input,
+                        zerocash_pour_proof<ZerocashParams::zerocash_pp>& proof) const;
+
+	ValueBytes					publicValue;		// public output value of the Pour transaction
+    SerialNumber				serialNumber_1;		// serial number of input (old) coin #1
+    SerialNumber				serialNumber_2;		// serial number of input (old) coin #1
     CoinCommitment				cm_1;				// coin commitment for output coin #1
     CoinCommitment				cm_2;				// coin commitment for output coin #2
-    std::vector<unsigned char>	MAC_1;				// first MAC	(h_1 in paper notation)
-    std::vector<unsigned char>	MAC_2;				// second MAC	(h_2 in paper notation)
+    PourMAC						MAC_1;				// first MAC	(h_1 in paper notation)
+    PourMAC						MAC_2;				// second MAC	(h_2 in paper notation)
     std::string					ciphertext_1;		// ciphertext #1
     std::string					ciphertext_2;		// ciphertext #2
     std::string					zkSNARK;			// contents of the zkSNARK proof itself
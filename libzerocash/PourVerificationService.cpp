@@ -0,0 +1,192 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class PourVerificationService.
+
+ See PourVerificationService.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "PourVerificationService.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace libzerocash {
+
+// ThreadPool keeps one thread back for the caller of parallelFor, but here
+// every verification runs on a worker.
+static size_t poolSize(size_t numThreads)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return numThreads + 1;
+}
+
+static double secondsBetween(std::chrono::steady_clock::time_point start,
+                             std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static double percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty()) {
+        return 0;
+    }
+
+    size_t k = std::min(samples.size() - 1, (size_t)(p * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+PourVerificationService::PourVerificationService(ZerocashParams &params,
+                                                 size_t numThreads,
+                                                 size_t maxQueued) :
+    params(params), maxQueued(std::max(maxQueued, (size_t)1)),
+    queued(0), inFlight(0), completed(0), refused(0), nextSample(0),
+    pool(new ThreadPool(poolSize(numThreads)))
+{
+    // Version 1 is the only one with proofs. Preparing its key here leaves
+    // the workers nothing to initialize.
+    this->params.getProcessedVerificationKey(1);
+}
+
+PourVerificationService::~PourVerificationService()
+{
+    // Finish the queued verifications before the profiling pause ends
+    this->pool.reset();
+}
+
+std::future<bool>
+PourVerificationService::verify(const PourTransaction &pour,
+                                const std::vector<unsigned char> &pubkeyHash,
+                                const MerkleRootType &merkleRoot)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->pour = pour;
+    request->pubkeyHash = pubkeyHash;
+    request->merkleRoot = merkleRoot;
+
+    std::shared_ptr< std::promise<bool> > promise = std::make_shared< std::promise<bool> >();
+    std::future<bool> result = promise->get_future();
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->slotAvailable.wait(lock, [this]() { return this->queued < this->maxQueued; });
+        this->queued++;
+    }
+
+    request->submitted = std::chrono::steady_clock::now();
+    this->start(request, [promise](bool valid, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(valid);
+        }
+    });
+
+    return result;
+}
+
+bool
+PourVerificationService::tryVerify(const PourTransaction &pour,
+                                   const std::vector<unsigned char> &pubkeyHash,
+                                   const MerkleRootType &merkleRoot,
+                                   const std::function<void(bool)> &done)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->queued >= this->maxQueued) {
+            this->refused++;
+            return false;
+        }
+        this->queued++;
+    }
+
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->pour = pour;
+    request->pubkeyHash = pubkeyHash;
+    request->merkleRoot = merkleRoot;
+    request->submitted = std::chrono::steady_clock::now();
+
+    this->start(request, [done](bool valid, std::exception_ptr error) {
+        done(valid && !error);
+    });
+
+    return true;
+}
+
+void
+PourVerificationService::start(const std::shared_ptr<Request> &request,
+                               const std::function<void(bool, std::exception_ptr)> &done)
+{
+    this->pool->submit([this, request, done]() {
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->queued--;
+            this->inFlight++;
+        }
+        this->slotAvailable.notify_one();
+
+        bool valid = false;
+        std::exception_ptr error;
+        try {
+            valid = request->pour.verify(this->params, request->pubkeyHash, request->merkleRoot);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->inFlight--;
+            this->completed++;
+
+            double verifySeconds = secondsBetween(started, finished);
+            double totalSeconds = secondsBetween(request->submitted, finished);
+            if (this->verifyLatencies.size() < POUR_VERIFICATION_LATENCY_SAMPLES) {
+                this->verifyLatencies.push_back(verifySeconds);
+                this->totalLatencies.push_back(totalSeconds);
+            } else {
+                this->verifyLatencies[this->nextSample] = verifySeconds;
+                this->totalLatencies[this->nextSample] = totalSeconds;
+            }
+            this->nextSample = (this->nextSample + 1) % POUR_VERIFICATION_LATENCY_SAMPLES;
+        }
+
+        done(valid, error);
+    });
+}
+
+PourVerificationService::Metrics
+PourVerificationService::getMetrics() const
+{
+    std::vector<double> verifySamples, totalSamples;
+    Metrics metrics;
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        metrics.queued = this->queued;
+        metrics.inFlight = this->inFlight;
+        metrics.completed = this->completed;
+        metrics.refused = this->refused;
+        verifySamples = this->verifyLatencies;
+        totalSamples = this->totalLatencies;
+    }
+
+    metrics.verifyP50 = percentile(verifySamples, 0.50);
+    metrics.verifyP99 = percentile(verifySamples, 0.99);
+    metrics.totalP50 = percentile(totalSamples, 0.50);
+    metrics.totalP99 = percentile(totalSamples, 0.99);
+
+    return metrics;
+}
+
+} /* namespace libzerocash */
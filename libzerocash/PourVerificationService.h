@@ -0,0 +1,134 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class PourVerificationService.
+
+ PourVerificationService verifies pour transactions on a pool of worker
+ threads, e.g. for mempool acceptance. Transactions wait for a worker in a
+ bounded queue. When it is full, verify blocks the caller and tryVerify
+ turns the transaction away, so that a flood of transactions pushes back on
+ whoever submits them.
+
+ All the workers check proofs against the processed verification key of one
+ ZerocashParams, which is prepared when the service starts and only read
+ afterwards. The metrics report the queue depth and the latency of recent
+ verifications, for monitoring.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef POURVERIFICATIONSERVICE_H_
+#define POURVERIFICATIONSERVICE_H_
+
+#include "PourTransaction.h"
+#include "ZerocashParams.h"
+#include "utils/ProfilingPause.h"
+#include "utils/ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+#define POUR_VERIFICATION_QUEUE_SIZE 1024
+#define POUR_VERIFICATION_LATENCY_SAMPLES 1024
+
+namespace libzerocash {
+
+/************************ Pour verification service **************************/
+
+class PourVerificationService {
+public:
+    struct Metrics {
+        size_t queued;          // waiting for a worker
+        size_t inFlight;        // being verified
+        uint64_t completed;     // verified since the service started
+        uint64_t refused;       // turned away by tryVerify because the queue was full
+
+        // Over the last POUR_VERIFICATION_LATENCY_SAMPLES verifications, in
+        // seconds: the time spent verifying, and the time from submission to
+        // result, which includes the wait in the queue.
+        double verifyP50;
+        double verifyP99;
+        double totalP50;
+        double totalP99;
+    };
+
+    // Verifies on 'numThreads' workers (0 means one per hardware thread),
+    // with at most 'maxQueued' transactions waiting. 'params' must outlive the
+    // service, and no other thread may load or generate its keys meanwhile.
+    // Turns off libsnark's profiling output, which is not thread-safe, for
+    // the lifetime of the service.
+    explicit PourVerificationService(ZerocashParams &params,
+                                     size_t numThreads = 0,
+                                     size_t maxQueued = POUR_VERIFICATION_QUEUE_SIZE);
+
+    // Finishes the queued verifications first.
+    ~PourVerificationService();
+
+    // Queues the verification of 'pour', blocking while the queue is full.
+    // The future holds the result of PourTransaction::verify, or the
+    // exception it threw.
+    std::future<bool> verify(const PourTransaction &pour,
+                             const std::vector<unsigned char> &pubkeyHash,
+                             const MerkleRootType &merkleRoot);
+
+    // Queues the verification of 'pour' and calls 'done' with the result on
+    // a worker thread; a verification that throws counts as invalid.
+    // Returns false at once, without calling 'done', if the queue is full.
+    bool tryVerify(const PourTransaction &pour,
+                   const std::vector<unsigned char> &pubkeyHash,
+                   const MerkleRootType &merkleRoot,
+                   const std::function<void(bool)> &done);
+
+    Metrics getMetrics() const;
+
+private:
+    PourVerificationService(const PourVerificationService&);
+    PourVerificationService& operator=(const PourVerificationService&);
+
+    struct Request {
+        PourTransaction pour;
+        std::vector<unsigned char> pubkeyHash;
+        MerkleRootType merkleRoot;
+        std::chrono::steady_clock::time_point submitted;
+    };
+
+    // Hands a request, already counted in 'queued', to the workers.
+    void start(const std::shared_ptr<Request> &request,
+               const std::function<void(bool, std::exception_ptr)> &done);
+
+    ZerocashParams &params;
+    size_t maxQueued;
+
+    mutable std::mutex mutex;
+    std::condition_variable slotAvailable;
+    size_t queued;
+    size_t inFlight;
+    uint64_t completed;
+    uint64_t refused;
+
+    // The profiling blocks entered by the libsnark verifier share global
+    // state, so profiling stays off while the workers run.
+    ProfilingPause profilingPause;
+
+    // Ring buffers of the latest samples, both written at 'nextSample'.
+    std::vector<double> verifyLatencies;
+    std::vector<double> totalLatencies;
+    size_t nextSample;
+
+    // Reset first when the service goes, which finishes the queued work.
+    std::unique_ptr<ThreadPool> pool;
+};
+
+} /* namespace libzerocash */
+
+#endif /* POURVERIFICATIONSERVICE_H_ */
@@ -25,6 +25,10 @@ ZerocashParams::ZerocashParams(zerocash_pour_proving_key<ZerocashParams::zerocas
 	kp_v1 = NULL;
     params_pk_v1 = NULL;
     params_vk_v1 = NULL;
+    params_pvk_v1 = NULL;
+    prover_v1 = NULL;
+    retiredProver_v1 = NULL;
+    retiredPvk_v1 = NULL;
 }
 
 ZerocashParams::ZerocashParams(const unsigned int tree_depth) :
@@ -33,6 +37,10 @@ ZerocashParams::ZerocashParams(const unsigned int tree_depth) :
 	kp_v1 = NULL;
     params_pk_v1 = NULL;
     params_vk_v1 = NULL;
+    params_pvk_v1 = NULL;
+    prover_v1 = NULL;
+    retiredProver_v1 = NULL;
+    retiredPvk_v1 = NULL;
 }
 
 ZerocashParams::ZerocashParams(const unsigned int tree_depth,
@@ -41,6 +49,10 @@ ZerocashParams::ZerocashParams(const unsigned int tree_depth,
     treeDepth(tree_depth)
 {
 	kp_v1 = NULL;
+    params_pvk_v1 = NULL;
+    prover_v1 = NULL;
+    retiredProver_v1 = NULL;
+    retiredPvk_v1 = NULL;
 
     ZerocashParams::zerocash_pp::init_public_params();
 
@@ -88,12 +100,14 @@ ZerocashParams::ZerocashParams(const unsigned int tree_depth,
         params_vk_v1 = new zerocash_pour_verification_key<ZerocashParams::zerocash_pp>(this->numPourInputs,
                                                                                        this->numPourOutputs,
                                                                                        std::move(vk_temp2));
+        params_pvk_v1 = new zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>(zerocash_pour_ppzksnark_verifier_process_vk<ZerocashParams::zerocash_pp>(*params_vk_v1));
     }
     else {
         params_vk_v1 = NULL;
     }
 }
 
+// Called with paramsMutex held
 void ZerocashParams::initV1Params()
 {
     ZerocashParams::zerocash_pp::init_public_params();
@@ -103,17 +117,32 @@ void ZerocashParams::initV1Params()
 
 	params_pk_v1 = &kp_v1->pk;
 	params_vk_v1 = &kp_v1->vk;
+
+    // A prover made earlier refers to the proving key that was just replaced
+    // and other threads may still be proving with it, so it is kept until
+    // destruction. This runs at most once, since it sets both keys.
+    retiredProver_v1 = prover_v1;
+    prover_v1 = NULL;
+
+    // The same holds for a processed key that verifiers may be using
+    retiredPvk_v1 = params_pvk_v1;
+    params_pvk_v1 = new zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>(zerocash_pour_ppzksnark_verifier_process_vk<ZerocashParams::zerocash_pp>(*params_vk_v1));
 }
 
 ZerocashParams::~ZerocashParams()
 {
+    delete prover_v1;
+    delete retiredProver_v1;
+    delete params_pvk_v1;
+    delete retiredPvk_v1;
 	delete kp_v1;
 }
 
 const zerocash_pour_proving_key<ZerocashParams::zerocash_pp>& ZerocashParams::getProvingKey(const int version)
 {
     switch(version) {
-        case 1:
+        case 1: {
+            std::lock_guard<std::recursive_mutex> lock(this->paramsMutex);
             if(params_pk_v1 == NULL) {
                 this->initV1Params();
                 return *(this->params_pk_v1);
@@ -122,6 +151,7 @@ const zerocash_pour_proving_key<ZerocashParams::zerocash_pp>& ZerocashParams::ge
                 return *(this->params_pk_v1);
             }
             break;
+        }
     }
 
     throw ZerocashException("Invalid version number");
@@ -130,7 +160,8 @@ const zerocash_pour_proving_key<ZerocashParams::zerocash_pp>& ZerocashParams::ge
 const zerocash_pour_verification_key<ZerocashParams::zerocash_pp>& ZerocashParams::getVerificationKey(const int version)
 {
     switch(version) {
-        case 1:
+        case 1: {
+            std::lock_guard<std::recursive_mutex> lock(this->paramsMutex);
             if(params_vk_v1 == NULL) {
                 this->initV1Params();
                 return *(this->params_vk_v1);
@@ -139,6 +170,39 @@ const zerocash_pour_verification_key<ZerocashParams::zerocash_pp>& ZerocashParam
                 return *(this->params_vk_v1);
             }
             break;
+        }
+    }
+
+    throw ZerocashException("Invalid version number");
+}
+
+const zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>& ZerocashParams::getProcessedVerificationKey(const int version)
+{
+    switch(version) {
+        case 1: {
+            std::lock_guard<std::recursive_mutex> lock(this->paramsMutex);
+            // Generating a missing verification key also processes it
+            const zerocash_pour_verification_key<ZerocashParams::zerocash_pp>& vk = this->getVerificationKey(version);
+            if(params_pvk_v1 == NULL) {
+                params_pvk_v1 = new zerocash_pour_processed_verification_key<ZerocashParams::zerocash_pp>(zerocash_pour_ppzksnark_verifier_process_vk<ZerocashParams::zerocash_pp>(vk));
+            }
+            return *(this->params_pvk_v1);
+        }
+    }
+
+    throw ZerocashException("Invalid version number");
+}
+
+zerocash_pour_prover<ZerocashParams::zerocash_pp>& ZerocashParams::getProver(const int version)
+{
+    switch(version) {
+        case 1: {
+            std::lock_guard<std::recursive_mutex> lock(this->paramsMutex);
+            if(prover_v1 == NULL) {
+                prover_v1 = new zerocash_pour_prover<ZerocashParams::zerocash_pp>(this->getProvingKey(version));
+            }
+            return *(this->prover_v1);
+        }
     }
 
     throw ZerocashException("Invalid version number");
@@ -12,6 +12,8 @@
 #ifndef PARAMS_H_
 #define PARAMS_H_
 
+#include <mutex>
+
 #include "Zerocash.h"
 #include "libsnark/common/default_types/r1cs_ppzksnark_pp.hpp"
 #include "libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp"
@@ -35,6 +37,16 @@ public:
     const zerocash_pour_proving_key<zerocash_pp>& getProvingKey(const int version);
 
     const zerocash_pour_verification_key<zerocash_pp>& getVerificationKey(const int version);
+
+    // The verification key of this version with its pairing precomputations,
+    // which are made once when the key is loaded or generated.
+    const zerocash_pour_processed_verification_key<zerocash_pp>& getProcessedVerificationKey(const int version);
+
+    // The prover for the proving key of this version, which builds the Pour
+    // constraint system on first use and keeps it for later pours. Threads
+    // that pour at the same time share it and take turns; set_num_threads on
+    // it lets each proof use several cores.
+    zerocash_pour_prover<zerocash_pp>& getProver(const int version);
     ~ZerocashParams();
 
 private:
@@ -42,6 +54,12 @@ private:
     zerocash_pour_keypair<zerocash_pp>* kp_v1;
     zerocash_pour_proving_key<zerocash_pp>* params_pk_v1;
     zerocash_pour_verification_key<zerocash_pp>* params_vk_v1;
+    zerocash_pour_processed_verification_key<zerocash_pp>* params_pvk_v1;
+    zerocash_pour_processed_verification_key<zerocash_pp>* retiredPvk_v1;
+    zerocash_pour_prover<zerocash_pp>* prover_v1;
+    zerocash_pour_prover<zerocash_pp>* retiredProver_v1;
+    // Guards the keys and the prover while they are created or replaced
+    std::recursive_mutex paramsMutex;
     int treeDepth;
 
     const size_t numPourInputs = 2;
@@ -0,0 +1,260 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class HashProvider.
+
+ See HashProvider.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "HashProvider.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+#include <openssl/sha.h>
+
+// Crypto++ is a dependency of the library, but only needed here for one more
+// candidate, so a tree without its headers still builds.
+#if defined(__has_include)
+#if __has_include(<cryptopp/sha.h>)
+#include <cryptopp/sha.h>
+#define HASH_PROVIDER_CRYPTOPP
+#endif
+#endif
+
+namespace libzerocash {
+
+static inline WORD loadBigEndian(const BYTE *p) {
+    return ((WORD)p[0] << 24) | ((WORD)p[1] << 16) | ((WORD)p[2] << 8) | (WORD)p[3];
+}
+
+static inline void storeBigEndian(BYTE *p, WORD x) {
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+// Runs of independent blocks on top of a single-block function
+template<void (*compress)(WORD state[8], const BYTE block[64])>
+static void compressEach(const BYTE blocks[], BYTE hashes[], size_t count) {
+    for (size_t n = 0; n < count; n++) {
+        WORD state[8];
+        memcpy(state, sha256_iv, sizeof(state));
+        compress(state, blocks + 64 * n);
+        for (size_t i = 0; i < 8; i++) {
+            storeBigEndian(hashes + SHA256_BLOCK_SIZE * n + 4 * i, state[i]);
+        }
+    }
+}
+
+/********************************* OpenSSL ***********************************/
+
+// SHA256_Transform is deprecated in OpenSSL 3, but is the only entry point
+// that takes a chaining value without padding.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+static void opensslCompress(WORD state[8], const BYTE block[64]) {
+    SHA256_CTX ctx;
+    for (size_t i = 0; i < 8; i++) {
+        ctx.h[i] = state[i];
+    }
+    SHA256_Transform(&ctx, block);
+    for (size_t i = 0; i < 8; i++) {
+        state[i] = ctx.h[i];
+    }
+}
+#pragma GCC diagnostic pop
+
+static const SHA256_BACKEND opensslBackend = {
+    "openssl", opensslCompress, compressEach<opensslCompress>
+};
+
+/********************************* Crypto++ **********************************/
+
+#ifdef HASH_PROVIDER_CRYPTOPP
+// Crypto++ takes the message as words already in big-endian order
+static void cryptoppCompress(WORD state[8], const BYTE block[64]) {
+    CryptoPP::word32 digest[8], data[16];
+    for (size_t i = 0; i < 8; i++) {
+        digest[i] = state[i];
+    }
+    for (size_t i = 0; i < 16; i++) {
+        data[i] = loadBigEndian(block + 4 * i);
+    }
+    CryptoPP::SHA256::Transform(digest, data);
+    for (size_t i = 0; i < 8; i++) {
+        state[i] = digest[i];
+    }
+}
+
+static const SHA256_BACKEND cryptoppBackend = {
+    "cryptopp", cryptoppCompress, compressEach<cryptoppCompress>
+};
+#endif
+
+/******************************* Calibration *********************************/
+
+// FIPS 180-2, appendix B.1: the digest of "abc", a single padded block
+static const BYTE abcDigest[SHA256_BLOCK_SIZE] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+
+// Chains 'count' blocks through the single-block function
+static void compressChain(const SHA256_BACKEND &backend, const BYTE blocks[], size_t count, BYTE hash[]) {
+    WORD state[8];
+    memcpy(state, sha256_iv, sizeof(state));
+    for (size_t n = 0; n < count; n++) {
+        backend.compress(state, blocks + 64 * n);
+    }
+    for (size_t i = 0; i < 8; i++) {
+        storeBigEndian(hash + 4 * i, state[i]);
+    }
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<const SHA256_BACKEND*> HashProvider::available() {
+    std::vector<const SHA256_BACKEND*> backends;
+    for (int engine = 0; engine < SHA256_ENGINE_COUNT; engine++) {
+        const SHA256_BACKEND *backend = sha256_engine_backend((SHA256_ENGINE)engine);
+        if (backend != NULL) {
+            backends.push_back(backend);
+        }
+    }
+
+    backends.push_back(&opensslBackend);
+#ifdef HASH_PROVIDER_CRYPTOPP
+    backends.push_back(&cryptoppBackend);
+#endif
+
+    return backends;
+}
+
+std::vector<HashProvider::Calibration> HashProvider::calibrate(size_t numBlocks) {
+    // Calibration runs while the active backend is being chosen, so it calls
+    // the backends directly and never through sha256_update and friends.
+    numBlocks = std::max(numBlocks, (size_t)1);
+
+    std::vector<BYTE> blocks(64 * numBlocks);
+    uint32_t seed = 0x243f6a88;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        blocks[i] = seed >> 24;
+    }
+
+    BYTE abcBlock[64] = { 'a', 'b', 'c', 0x80 };
+    abcBlock[63] = 0x18;
+
+    const SHA256_BACKEND &reference = *sha256_engine_backend(SHA256_ENGINE_SCALAR);
+    BYTE expectedChain[SHA256_BLOCK_SIZE];
+    std::vector<BYTE> expectedHashes(SHA256_BLOCK_SIZE * numBlocks);
+    compressChain(reference, &blocks[0], numBlocks, expectedChain);
+    reference.compress_blocks(&blocks[0], &expectedHashes[0], numBlocks);
+
+    std::vector<const SHA256_BACKEND*> backends = available();
+    std::vector<Calibration> results(backends.size());
+    std::vector<BYTE> hashes(SHA256_BLOCK_SIZE * numBlocks);
+
+    for (size_t b = 0; b < backends.size(); b++) {
+        const SHA256_BACKEND &backend = *backends[b];
+        BYTE chain[SHA256_BLOCK_SIZE], abcHash[SHA256_BLOCK_SIZE], abcBlocksHash[SHA256_BLOCK_SIZE];
+
+        compressChain(backend, abcBlock, 1, abcHash);
+        backend.compress_blocks(abcBlock, abcBlocksHash, 1);
+        compressChain(backend, &blocks[0], numBlocks, chain);
+        backend.compress_blocks(&blocks[0], &hashes[0], numBlocks);
+
+        results[b].backend = &backend;
+        results[b].correct = memcmp(abcHash, abcDigest, SHA256_BLOCK_SIZE) == 0 &&
+                             memcmp(abcBlocksHash, abcDigest, SHA256_BLOCK_SIZE) == 0 &&
+                             memcmp(chain, expectedChain, SHA256_BLOCK_SIZE) == 0 &&
+                             hashes == expectedHashes;
+        results[b].compressPerSecond = 0;
+        results[b].blocksPerSecond = 0;
+    }
+
+    // Best of a few rounds, taking turns, so that one interruption does not decide
+    for (size_t round = 0; round < HASH_PROVIDER_CALIBRATION_ROUNDS; round++) {
+        for (size_t b = 0; b < backends.size(); b++) {
+            BYTE chain[SHA256_BLOCK_SIZE];
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            compressChain(*backends[b], &blocks[0], numBlocks, chain);
+            results[b].compressPerSecond = std::max(results[b].compressPerSecond, numBlocks / secondsSince(start));
+
+            start = std::chrono::steady_clock::now();
+            backends[b]->compress_blocks(&blocks[0], &hashes[0], numBlocks);
+            results[b].blocksPerSecond = std::max(results[b].blocksPerSecond, numBlocks / secondsSince(start));
+        }
+    }
+
+    return results;
+}
+
+const SHA256_BACKEND& HashProvider::get() {
+    return *sha256_get_backend();
+}
+
+bool HashProvider::select(const std::string &name) {
+    std::vector<const SHA256_BACKEND*> backends = available();
+    for (size_t b = 0; b < backends.size(); b++) {
+        if (name == backends[b]->name) {
+            return sha256_set_backend(backends[b]) != 0;
+        }
+    }
+    return false;
+}
+
+} /* namespace libzerocash */
+
+// Called by sha256.cpp when hashing starts with no backend set. Installs the
+// fastest correct backend for each kind of call, pairing two when they differ.
+const SHA256_BACKEND *sha256_select_backend(void) {
+    static std::once_flag selected;
+    static SHA256_BACKEND combined;
+    static std::string combinedName;
+
+    std::call_once(selected, []() {
+        std::vector<libzerocash::HashProvider::Calibration> results = libzerocash::HashProvider::calibrate();
+
+        // The portable backend comes first and is correct by definition
+        const SHA256_BACKEND *single = results[0].backend, *multi = results[0].backend;
+        double bestSingle = 0, bestMulti = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (!results[i].correct) {
+                continue;
+            }
+            if (results[i].compressPerSecond > bestSingle) {
+                bestSingle = results[i].compressPerSecond;
+                single = results[i].backend;
+            }
+            if (results[i].blocksPerSecond > bestMulti) {
+                bestMulti = results[i].blocksPerSecond;
+                multi = results[i].backend;
+            }
+        }
+
+        if (single == multi) {
+            sha256_set_backend(single);
+        } else {
+            combinedName = std::string(single->name) + "/" + multi->name;
+            combined.name = combinedName.c_str();
+            combined.compress = single->compress;
+            combined.compress_blocks = multi->compress_blocks;
+            sha256_set_backend(&combined);
+        }
+    });
+
+    return sha256_get_backend();
+}
@@ -0,0 +1,61 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class HashProvider.
+
+ HashProvider chooses the SHA-256 compression backend that everything in
+ libzerocash hashes with: the built-in engines of sha256.h that the CPU
+ supports, plus the OpenSSL and Crypto++ implementations the library links
+ anyway. On first use every candidate is checked against a known answer and
+ timed on a short run, and the fastest one is installed, separately for
+ single blocks (Merkle nodes, hashVector) and for runs of independent
+ blocks (sha256_compress_blocks).
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef HASHPROVIDER_H_
+#define HASHPROVIDER_H_
+
+#include <string>
+#include <vector>
+
+#include "sha256.h"
+
+#define HASH_PROVIDER_CALIBRATION_BLOCKS 2048
+#define HASH_PROVIDER_CALIBRATION_ROUNDS 3
+
+namespace libzerocash {
+
+/****************************** Hash provider ********************************/
+
+class HashProvider {
+public:
+    struct Calibration {
+        const SHA256_BACKEND *backend;
+        bool correct;               // agrees with the portable implementation
+        double compressPerSecond;   // single blocks, chained
+        double blocksPerSecond;     // independent blocks, in one run
+    };
+
+    // Every backend usable on this machine, the portable one first.
+    static std::vector<const SHA256_BACKEND*> available();
+
+    // Checks every available backend and times it on 'numBlocks' blocks,
+    // keeping the best of HASH_PROVIDER_CALIBRATION_ROUNDS runs.
+    static std::vector<Calibration> calibrate(size_t numBlocks = HASH_PROVIDER_CALIBRATION_BLOCKS);
+
+    // The active backend, calibrating and installing one on first use.
+    static const SHA256_BACKEND& get();
+
+    // Installs the available backend called 'name' for all hashing.
+    // Returns false if there is none.
+    static bool select(const std::string &name);
+};
+
+} /* namespace libzerocash */
+
+#endif /* HASHPROVIDER_H_ */
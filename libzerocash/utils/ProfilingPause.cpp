@@ -0,0 +1,61 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class ProfilingPause.
+
+ See ProfilingPause.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "ProfilingPause.h"
+
+#include <mutex>
+
+#include "libsnark/common/profiling.hpp"
+
+namespace libzerocash {
+
+// Shared by every pause in the process. The settings found by the first
+// pause are the ones the last pause puts back.
+static std::mutex pauseMutex;
+static size_t activePauses = 0;
+static bool savedInfo;
+static bool savedCounters;
+
+ProfilingPause::ProfilingPause()
+{
+    std::lock_guard<std::mutex> lock(pauseMutex);
+    if (activePauses++ == 0) {
+        savedInfo = libsnark::inhibit_profiling_info;
+        savedCounters = libsnark::inhibit_profiling_counters;
+
+        // Flags that are already set are not written again, so a program
+        // that turned profiling off at startup can use libsnark on its own
+        // threads while pauses begin and end.
+        if (!savedInfo) {
+            libsnark::inhibit_profiling_info = true;
+        }
+        if (!savedCounters) {
+            libsnark::inhibit_profiling_counters = true;
+        }
+    }
+}
+
+ProfilingPause::~ProfilingPause()
+{
+    std::lock_guard<std::mutex> lock(pauseMutex);
+    if (--activePauses == 0) {
+        if (!savedInfo) {
+            libsnark::inhibit_profiling_info = false;
+        }
+        if (!savedCounters) {
+            libsnark::inhibit_profiling_counters = false;
+        }
+    }
+}
+
+} /* namespace libzerocash */
@@ -0,0 +1,41 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class ProfilingPause.
+
+ libsnark's profiling (enter_block, leave_block and the operation counters)
+ writes to global state without locking, so it must be off while libsnark
+ runs on several threads. A ProfilingPause turns it off for as long as it
+ lives. Pauses may overlap, within a thread or across threads: profiling is
+ turned off by the first pause and put back as it was by the last one to
+ end.
+
+ Code that never wants profiling can instead set inhibit_profiling_info and
+ inhibit_profiling_counters once at startup; the pauses then change nothing.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef PROFILINGPAUSE_H_
+#define PROFILINGPAUSE_H_
+
+namespace libzerocash {
+
+/***************************** Profiling pause *******************************/
+
+class ProfilingPause {
+public:
+    ProfilingPause();
+    ~ProfilingPause();
+
+private:
+    ProfilingPause(const ProfilingPause&);
+    ProfilingPause& operator=(const ProfilingPause&);
+};
+
+} /* namespace libzerocash */
+
+#endif /* PROFILINGPAUSE_H_ */
@@ -0,0 +1,129 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for the class ThreadPool.
+
+ See ThreadPool.h .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace libzerocash {
+
+// Set on pool worker threads so that nested parallelFor calls run inline
+// instead of waiting on workers that may all be busy.
+static thread_local bool onWorkerThread = false;
+
+ThreadPool::ThreadPool(size_t numThreads) : stopping(false)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The calling thread takes part in parallelFor, so one fewer worker is enough.
+    for (size_t i = 1; i < numThreads; i++) {
+        this->workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        this->stopping = true;
+    }
+    this->tasksAvailable.notify_all();
+
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        this->workers[i].join();
+    }
+}
+
+void
+ThreadPool::workerLoop()
+{
+    onWorkerThread = true;
+
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(this->tasksMutex);
+            this->tasksAvailable.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+            if (this->tasks.empty()) {
+                return;
+            }
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+void
+ThreadPool::parallelFor(size_t begin, size_t end, size_t minChunk,
+                        const std::function<void(size_t, size_t)> &body)
+{
+    if (end <= begin) {
+        return;
+    }
+
+    size_t count = end - begin;
+    size_t chunk = std::max<size_t>(minChunk, 1);
+    size_t numChunks = std::min(this->workers.size() + 1, (count + chunk - 1) / chunk);
+
+    if (numChunks <= 1 || onWorkerThread) {
+        body(begin, end);
+        return;
+    }
+
+    // Even split; the first 'count % numChunks' chunks get one extra index.
+    std::vector< std::future<void> > pending;
+    size_t chunkBegin = begin;
+    for (size_t i = 0; i < numChunks; i++) {
+        size_t chunkEnd = chunkBegin + count / numChunks + (i < count % numChunks ? 1 : 0);
+
+        if (i + 1 < numChunks) {
+            pending.push_back(this->submit([&body, chunkBegin, chunkEnd]() { body(chunkBegin, chunkEnd); }));
+        } else {
+            // The last chunk runs on the calling thread.
+            try {
+                body(chunkBegin, chunkEnd);
+            } catch (...) {
+                for (size_t j = 0; j < pending.size(); j++) {
+                    pending[j].wait();
+                }
+                throw;
+            }
+        }
+
+        chunkBegin = chunkEnd;
+    }
+
+    // Wait for everything before rethrowing, since 'body' is borrowed.
+    for (size_t j = 0; j < pending.size(); j++) {
+        pending[j].wait();
+    }
+    for (size_t j = 0; j < pending.size(); j++) {
+        pending[j].get();
+    }
+}
+
+ThreadPool&
+ThreadPool::getDefault()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+} /* namespace libzerocash */
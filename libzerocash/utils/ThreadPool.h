@@ -0,0 +1,93 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for the class ThreadPool.
+
+ A fixed-size pool of worker threads. Work is handed out either as single
+ tasks (submit) or as a data-parallel loop over an index range (parallelFor).
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace libzerocash {
+
+/******************************* Thread pool *********************************/
+
+class ThreadPool {
+public:
+    // Creates 'numThreads' workers; 0 means one per hardware thread.
+    explicit ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    size_t size() const { return workers.size(); }
+
+    // Queues 'task' and returns a future for its result.
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> submit(F task);
+
+    // Splits [begin, end) into chunks of at least 'minChunk' indices and runs
+    // body(chunkBegin, chunkEnd) on each, using the calling thread as one of
+    // the workers. Blocks until every chunk is done and rethrows the first
+    // exception raised by 'body'. Runs serially when called from a worker.
+    void parallelFor(size_t begin, size_t end, size_t minChunk,
+                     const std::function<void(size_t, size_t)> &body);
+
+    // Process-wide pool sized to the hardware, created on first use.
+    static ThreadPool& getDefault();
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque< std::function<void()> > tasks;
+    std::mutex tasksMutex;
+    std::condition_variable tasksAvailable;
+    bool stopping;
+};
+
+template<typename F>
+std::future<typename std::result_of<F()>::type>
+ThreadPool::submit(F task)
+{
+    typedef typename std::result_of<F()>::type result_type;
+
+    std::shared_ptr< std::packaged_task<result_type()> > packaged =
+        std::make_shared< std::packaged_task<result_type()> >(task);
+    std::future<result_type> result = packaged->get_future();
+
+    if (this->workers.empty()) {
+        (*packaged)();
+        return result;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->tasksMutex);
+        this->tasks.push_back([packaged]() { (*packaged)(); });
+    }
+    this->tasksAvailable.notify_one();
+
+    return result;
+}
+
+} /* namespace libzerocash */
+
+#endif /* THREADPOOL_H_ */
@@ -15,8 +15,14 @@
 /*************************** HEADER FILES ***************************/
 #include <stdlib.h>
 #include <memory.h>
+#include <atomic>
 #include "sha256.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 /****************************** MACROS ******************************/
 #define ROTLEFT(a,b) (((a) << (b)) | ((a) >> (32-(b))))
 #define ROTRIGHT(a,b) (((a) >> (b)) | ((a) << (32-(b))))
@@ -41,7 +47,11 @@ static const WORD k[64] = {
 };
 
 /*********************** FUNCTION DEFINITIONS ***********************/
-void sha256_transform(SHA256_CTX_mod *ctx, const BYTE data[])
+static inline const SHA256_BACKEND *sha256_backend(void);
+static inline void sha256_count(size_t compressions, size_t bytes);
+
+/* The portable compression function; every backend must agree with it. */
+static void sha256_transform_scalar(WORD state[8], const BYTE data[])
 {
 	WORD a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
 
@@ -50,14 +60,14 @@ void sha256_transform(SHA256_CTX_mod *ctx, const BYTE data[])
 	for ( ; i < 64; ++i)
 		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
 
-	a = ctx->state[0];
-	b = ctx->state[1];
-	c = ctx->state[2];
-	d = ctx->state[3];
-	e = ctx->state[4];
-	f = ctx->state[5];
-	g = ctx->state[6];
-	h = ctx->state[7];
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
 
 	for (i = 0; i < 64; ++i) {
 		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
@@ -72,14 +82,20 @@ void sha256_transform(SHA256_CTX_mod *ctx, const BYTE data[])
 		a = t1 + t2;
 	}
 
-	ctx->state[0] += a;
-	ctx->state[1] += b;
-	ctx->state[2] += c;
-	ctx->state[3] += d;
-	ctx->state[4] += e;
-	ctx->state[5] += f;
-	ctx->state[6] += g;
-	ctx->state[7] += h;
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+void sha256_transform(SHA256_CTX_mod *ctx, const BYTE data[])
+{
+	sha256_count(1, 0);
+	sha256_backend()->compress(ctx->state, data);
 }
 
 void sha256_init(SHA256_CTX_mod *ctx)
@@ -100,6 +116,7 @@ void sha256_update(SHA256_CTX_mod *ctx, const BYTE data[], size_t len)
 {
 	WORD i;
 
+	sha256_count(0, len);
 	for (i = 0; i < len; ++i) {
 		ctx->data[ctx->datalen] = data[i];
 		ctx->datalen++;
@@ -128,3 +145,519 @@ void sha256_final(SHA256_CTX_mod *ctx, BYTE hash[])
 		hash[i + 28] = (ctx->state[7] >> (24 - i * 8)) & 0x000000ff;
 	}
 }
+
+/********************** MULTI-BUFFER COMPRESSION ********************/
+/* Each engine hashes a run of independent 64-byte blocks starting from the
+   initial state, which is what sha256_update of exactly 64 bytes followed by
+   sha256_final computes. The lane engines keep one block per 32-bit lane of
+   a vector register and run the scalar rounds above on whole vectors. */
+
+const WORD sha256_iv[8] = {
+	0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+};
+
+static inline WORD load_be32(const BYTE p[])
+{
+	return ((WORD)p[0] << 24) | ((WORD)p[1] << 16) | ((WORD)p[2] << 8) | (WORD)p[3];
+}
+
+static inline void store_be32(BYTE p[], WORD x)
+{
+	p[0] = x >> 24;
+	p[1] = x >> 16;
+	p[2] = x >> 8;
+	p[3] = x;
+}
+
+static void sha256_blocks_scalar(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	WORD state[8];
+	size_t n, i;
+
+	for (n = 0; n < count; ++n) {
+		memcpy(state, sha256_iv, sizeof(state));
+		sha256_transform_scalar(state, blocks + 64 * n);
+		for (i = 0; i < 8; ++i)
+			store_be32(hashes + SHA256_BLOCK_SIZE * n + 4 * i, state[i]);
+	}
+}
+
+/* Hashes N blocks at once, V being a vector of N words. Forced inline so that
+   it is compiled with the instruction set of the engine calling it. */
+template<typename V, size_t N>
+static inline __attribute__((always_inline)) void sha256_compress_lanes(const BYTE blocks[], BYTE hashes[])
+{
+	V a, b, c, d, e, f, g, h, t1, t2, m[64];
+	WORD lanes[N] __attribute__((aligned(64)));
+	size_t i, lane;
+
+	for (i = 0; i < 16; ++i) {
+		for (lane = 0; lane < N; ++lane)
+			lanes[lane] = load_be32(blocks + 64 * lane + 4 * i);
+		memcpy(&m[i], lanes, sizeof(V));
+	}
+	for ( ; i < 64; ++i)
+		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+
+	V zero = {};
+	a = zero + sha256_iv[0];
+	b = zero + sha256_iv[1];
+	c = zero + sha256_iv[2];
+	d = zero + sha256_iv[3];
+	e = zero + sha256_iv[4];
+	f = zero + sha256_iv[5];
+	g = zero + sha256_iv[6];
+	h = zero + sha256_iv[7];
+
+	for (i = 0; i < 64; ++i) {
+		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+		t2 = EP0(a) + MAJ(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	V state[8] = { a + sha256_iv[0], b + sha256_iv[1], c + sha256_iv[2], d + sha256_iv[3],
+	               e + sha256_iv[4], f + sha256_iv[5], g + sha256_iv[6], h + sha256_iv[7] };
+
+	for (i = 0; i < 8; ++i) {
+		memcpy(lanes, &state[i], sizeof(V));
+		for (lane = 0; lane < N; ++lane)
+			store_be32(hashes + SHA256_BLOCK_SIZE * lane + 4 * i, lanes[lane]);
+	}
+}
+
+/* Runs full groups of N blocks through the lanes; a short last group is
+   padded with zero blocks whose hashes are dropped. */
+template<typename V, size_t N>
+static inline __attribute__((always_inline)) void sha256_blocks_lanes(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	size_t n;
+
+	for (n = 0; n + N <= count; n += N)
+		sha256_compress_lanes<V, N>(blocks + 64 * n, hashes + SHA256_BLOCK_SIZE * n);
+
+	if (n < count) {
+		BYTE tailBlocks[64 * N], tailHashes[SHA256_BLOCK_SIZE * N];
+
+		memset(tailBlocks, 0, sizeof(tailBlocks));
+		memcpy(tailBlocks, blocks + 64 * n, 64 * (count - n));
+		sha256_compress_lanes<V, N>(tailBlocks, tailHashes);
+		memcpy(hashes + SHA256_BLOCK_SIZE * n, tailHashes, SHA256_BLOCK_SIZE * (count - n));
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+typedef WORD sha256_v4 __attribute__((vector_size(16)));
+typedef WORD sha256_v8 __attribute__((vector_size(32)));
+typedef WORD sha256_v16 __attribute__((vector_size(64)));
+
+__attribute__((target("sse4.1")))
+static void sha256_blocks_sse4(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	sha256_blocks_lanes<sha256_v4, 4>(blocks, hashes, count);
+}
+
+__attribute__((target("avx2")))
+static void sha256_blocks_avx2(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	sha256_blocks_lanes<sha256_v8, 8>(blocks, hashes, count);
+}
+
+__attribute__((target("avx512f")))
+static void sha256_blocks_avx512(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	sha256_blocks_lanes<sha256_v16, 16>(blocks, hashes, count);
+}
+
+/* The SHA extensions keep the state as ABEF/CDGH and run two rounds per
+   sha256rnds2; the message schedule is four words per register. Blocks go
+   through in pairs so that the two dependency chains overlap. */
+template<size_t N>
+__attribute__((target("sha,sse4.1")))
+static inline __attribute__((always_inline)) void sha256_compress_shani(const WORD state[], const BYTE blocks[], BYTE hashes[])
+{
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	const __m128i initAbef = _mm_set_epi32(state[0], state[1], state[4], state[5]);
+	const __m128i initCdgh = _mm_set_epi32(state[2], state[3], state[6], state[7]);
+	__m128i abef[N], cdgh[N], msg[N][4], tmp;
+	size_t i, n;
+
+	for (n = 0; n < N; ++n) {
+		abef[n] = initAbef;
+		cdgh[n] = initCdgh;
+	}
+
+	for (i = 0; i < 16; ++i) {
+		for (n = 0; n < N; ++n) {
+			if (i < 4) {
+				msg[n][i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 64 * n + 16 * i)), byteSwap);
+			} else {
+				tmp = _mm_sha256msg1_epu32(msg[n][i % 4], msg[n][(i + 1) % 4]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(msg[n][(i + 3) % 4], msg[n][(i + 2) % 4], 4));
+				msg[n][i % 4] = _mm_sha256msg2_epu32(tmp, msg[n][(i + 3) % 4]);
+			}
+
+			tmp = _mm_add_epi32(msg[n][i % 4], _mm_loadu_si128((const __m128i*)(k + 4 * i)));
+			cdgh[n] = _mm_sha256rnds2_epu32(cdgh[n], abef[n], tmp);
+			abef[n] = _mm_sha256rnds2_epu32(abef[n], cdgh[n], _mm_shuffle_epi32(tmp, 0x0e));
+		}
+	}
+
+	for (n = 0; n < N; ++n) {
+		__m128i feba = _mm_shuffle_epi32(_mm_add_epi32(abef[n], initAbef), 0x1b);
+		__m128i dchg = _mm_shuffle_epi32(_mm_add_epi32(cdgh[n], initCdgh), 0xb1);
+
+		// Back to ABCD/EFGH, then to big-endian bytes
+		_mm_storeu_si128((__m128i*)(hashes + SHA256_BLOCK_SIZE * n),
+		                 _mm_shuffle_epi8(_mm_blend_epi16(feba, dchg, 0xf0), byteSwap));
+		_mm_storeu_si128((__m128i*)(hashes + SHA256_BLOCK_SIZE * n + 16),
+		                 _mm_shuffle_epi8(_mm_alignr_epi8(dchg, feba, 8), byteSwap));
+	}
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	size_t n;
+
+	for (n = 0; n + 2 <= count; n += 2)
+		sha256_compress_shani<2>(sha256_iv, blocks + 64 * n, hashes + SHA256_BLOCK_SIZE * n);
+	if (n < count)
+		sha256_compress_shani<1>(sha256_iv, blocks + 64 * n, hashes + SHA256_BLOCK_SIZE * n);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_transform_shani(WORD state[8], const BYTE data[])
+{
+	BYTE hash[SHA256_BLOCK_SIZE];
+	size_t i;
+
+	sha256_compress_shani<1>(state, data, hash);
+	for (i = 0; i < 8; ++i)
+		state[i] = load_be32(hash + 4 * i);
+}
+
+static int sha256_cpu_has_shani(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (ebx >> 29) & 1;
+}
+
+#endif
+
+/***************************** BACKENDS *****************************/
+/* The lane engines only pay off on many blocks, so they pair with the
+   scalar transform for single blocks. */
+
+static const SHA256_BACKEND engines[SHA256_ENGINE_COUNT] = {
+	{ "scalar", sha256_transform_scalar, sha256_blocks_scalar },
+#if defined(__x86_64__) || defined(__i386__)
+	{ "sse4", sha256_transform_scalar, sha256_blocks_sse4 },
+	{ "avx2", sha256_transform_scalar, sha256_blocks_avx2 },
+	{ "avx512", sha256_transform_scalar, sha256_blocks_avx512 },
+	{ "sha-ni", sha256_transform_shani, sha256_blocks_shani },
+#else
+	{ "sse4", NULL, NULL },
+	{ "avx2", NULL, NULL },
+	{ "avx512", NULL, NULL },
+	{ "sha-ni", NULL, NULL },
+#endif
+};
+
+static std::atomic<const SHA256_BACKEND*> active_backend(NULL);
+
+static inline const SHA256_BACKEND *sha256_backend(void)
+{
+	const SHA256_BACKEND *backend = active_backend.load(std::memory_order_acquire);
+
+	if (backend == NULL)
+		backend = sha256_select_backend();
+	return backend;
+}
+
+int sha256_engine_supported(SHA256_ENGINE engine)
+{
+	switch (engine) {
+	case SHA256_ENGINE_SCALAR:
+		return 1;
+#if defined(__x86_64__) || defined(__i386__)
+	case SHA256_ENGINE_SSE4:
+		return __builtin_cpu_supports("sse4.1");
+	case SHA256_ENGINE_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case SHA256_ENGINE_AVX512:
+		return __builtin_cpu_supports("avx512f");
+	case SHA256_ENGINE_SHANI:
+		return sha256_cpu_has_shani() && __builtin_cpu_supports("sse4.1");
+#endif
+	default:
+		return 0;
+	}
+}
+
+const SHA256_BACKEND *sha256_engine_backend(SHA256_ENGINE engine)
+{
+	if (engine < 0 || engine >= SHA256_ENGINE_COUNT || !sha256_engine_supported(engine))
+		return NULL;
+	return &engines[engine];
+}
+
+int sha256_set_engine(SHA256_ENGINE engine)
+{
+	return sha256_set_backend(sha256_engine_backend(engine));
+}
+
+const char *sha256_engine_name(SHA256_ENGINE engine)
+{
+	if (engine < 0 || engine >= SHA256_ENGINE_COUNT)
+		return "unknown";
+	return engines[engine].name;
+}
+
+const SHA256_BACKEND *sha256_get_backend(void)
+{
+	return sha256_backend();
+}
+
+int sha256_set_backend(const SHA256_BACKEND *backend)
+{
+	if (backend == NULL || backend->compress == NULL || backend->compress_blocks == NULL)
+		return 0;
+
+	active_backend.store(backend, std::memory_order_release);
+	return 1;
+}
+
+void sha256_compress_blocks(const BYTE blocks[], BYTE hashes[], size_t count)
+{
+	sha256_count(count, 64 * count);
+	sha256_backend()->compress_blocks(blocks, hashes, count);
+}
+
+/************************ SINGLE-BLOCK COMPRESSION ******************/
+
+void sha256_compress(const WORD state[], const BYTE block[], BYTE hash[])
+{
+	WORD next[8];
+	size_t i;
+
+	sha256_count(1, 64);
+	memcpy(next, state, sizeof(next));
+	sha256_backend()->compress(next, block);
+	for (i = 0; i < 8; ++i)
+		store_be32(hash + 4 * i, next[i]);
+}
+
+void sha256_two_to_one(const BYTE left[], const BYTE right[], BYTE hash[])
+{
+	BYTE block[64];
+
+	memcpy(block, left, SHA256_BLOCK_SIZE);
+	memcpy(block + SHA256_BLOCK_SIZE, right, SHA256_BLOCK_SIZE);
+	sha256_compress(sha256_iv, block, hash);
+}
+
+/************************** FIXED-PREFIX BLOCKS *********************/
+/* Rounds 0-7 read only message words 0-7, so for blocks whose first half is
+   fixed their result, and those words, can be computed once. The scalar
+   transform then resumes from round 8; the other backends have no way to
+   start mid-block and take the whole block. */
+
+void sha256_prefix_init(SHA256_PREFIX *ctx, const BYTE prefix[])
+{
+	WORD a, b, c, d, e, f, g, h, i, t1, t2;
+
+	memcpy(ctx->prefix, prefix, SHA256_BLOCK_SIZE);
+	for (i = 0; i < 8; ++i)
+		ctx->schedule[i] = load_be32(prefix + 4 * i);
+
+	a = sha256_iv[0];
+	b = sha256_iv[1];
+	c = sha256_iv[2];
+	d = sha256_iv[3];
+	e = sha256_iv[4];
+	f = sha256_iv[5];
+	g = sha256_iv[6];
+	h = sha256_iv[7];
+
+	for (i = 0; i < 8; ++i) {
+		t1 = h + EP1(e) + CH(e,f,g) + k[i] + ctx->schedule[i];
+		t2 = EP0(a) + MAJ(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	ctx->midstate[0] = a;
+	ctx->midstate[1] = b;
+	ctx->midstate[2] = c;
+	ctx->midstate[3] = d;
+	ctx->midstate[4] = e;
+	ctx->midstate[5] = f;
+	ctx->midstate[6] = g;
+	ctx->midstate[7] = h;
+}
+
+static void sha256_prefix_resume(const SHA256_PREFIX *ctx, const BYTE suffix[], BYTE hash[])
+{
+	WORD a, b, c, d, e, f, g, h, i, t1, t2, m[64];
+
+	for (i = 0; i < 8; ++i)
+		m[i] = ctx->schedule[i];
+	for ( ; i < 16; ++i)
+		m[i] = load_be32(suffix + 4 * (i - 8));
+	for ( ; i < 64; ++i)
+		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+
+	a = ctx->midstate[0];
+	b = ctx->midstate[1];
+	c = ctx->midstate[2];
+	d = ctx->midstate[3];
+	e = ctx->midstate[4];
+	f = ctx->midstate[5];
+	g = ctx->midstate[6];
+	h = ctx->midstate[7];
+
+	for (i = 8; i < 64; ++i) {
+		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
+		t2 = EP0(a) + MAJ(a,b,c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+
+	store_be32(hash, a + sha256_iv[0]);
+	store_be32(hash + 4, b + sha256_iv[1]);
+	store_be32(hash + 8, c + sha256_iv[2]);
+	store_be32(hash + 12, d + sha256_iv[3]);
+	store_be32(hash + 16, e + sha256_iv[4]);
+	store_be32(hash + 20, f + sha256_iv[5]);
+	store_be32(hash + 24, g + sha256_iv[6]);
+	store_be32(hash + 28, h + sha256_iv[7]);
+}
+
+void sha256_prefix_compress(const SHA256_PREFIX *ctx, const BYTE suffix[], BYTE hash[])
+{
+	if (sha256_backend()->compress == sha256_transform_scalar) {
+		sha256_count(1, 64);
+		sha256_prefix_resume(ctx, suffix, hash);
+		return;
+	}
+
+	sha256_two_to_one(ctx->prefix, suffix, hash);
+}
+
+void sha256_prefix_compress_many(const SHA256_PREFIX *ctx, const BYTE suffixes[], BYTE hashes[], size_t count)
+{
+	const SHA256_BACKEND *backend = sha256_backend();
+	BYTE blocks[64 * 16];
+	size_t n, i, chunk;
+
+	sha256_count(count, 64 * count);
+	if (backend->compress_blocks == sha256_blocks_scalar) {
+		for (n = 0; n < count; ++n)
+			sha256_prefix_resume(ctx, suffixes + SHA256_BLOCK_SIZE * n, hashes + SHA256_BLOCK_SIZE * n);
+		return;
+	}
+
+	/* Enough blocks at a time to fill the widest lane engine */
+	for (n = 0; n < count; n += chunk) {
+		chunk = (count - n < 16) ? count - n : 16;
+		for (i = 0; i < chunk; ++i) {
+			memcpy(blocks + 64 * i, ctx->prefix, SHA256_BLOCK_SIZE);
+			memcpy(blocks + 64 * i + SHA256_BLOCK_SIZE, suffixes + SHA256_BLOCK_SIZE * (n + i), SHA256_BLOCK_SIZE);
+		}
+		backend->compress_blocks(blocks, hashes + SHA256_BLOCK_SIZE * n, chunk);
+	}
+}
+
+/****************************** COUNTERS ****************************/
+/* Relaxed atomics, since only the totals matter; the site is per thread so
+   that concurrent hashing for different callers is told apart. */
+
+#ifdef HASH_STATS
+static std::atomic<unsigned long long> stats_compressions[SHA256_SITE_COUNT];
+static std::atomic<unsigned long long> stats_bytes[SHA256_SITE_COUNT];
+static thread_local SHA256_SITE stats_site = SHA256_SITE_OTHER;
+
+static inline void sha256_count(size_t compressions, size_t bytes)
+{
+	stats_compressions[stats_site].fetch_add(compressions, std::memory_order_relaxed);
+	stats_bytes[stats_site].fetch_add(bytes, std::memory_order_relaxed);
+}
+#else
+static inline void sha256_count(size_t compressions, size_t bytes)
+{
+}
+#endif
+
+int sha256_stats_enabled(void)
+{
+#ifdef HASH_STATS
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+SHA256_SITE sha256_stats_site(SHA256_SITE site)
+{
+#ifdef HASH_STATS
+	SHA256_SITE previous = stats_site;
+	stats_site = site;
+	return previous;
+#else
+	return SHA256_SITE_OTHER;
+#endif
+}
+
+void sha256_stats_get(SHA256_SITE site, SHA256_COUNTS *counts)
+{
+	counts->compressions = 0;
+	counts->bytes = 0;
+#ifdef HASH_STATS
+	if (site < 0 || site >= SHA256_SITE_COUNT)
+		return;
+	counts->compressions = stats_compressions[site].load(std::memory_order_relaxed);
+	counts->bytes = stats_bytes[site].load(std::memory_order_relaxed);
+#endif
+}
+
+void sha256_stats_reset(void)
+{
+#ifdef HASH_STATS
+	for (int site = 0; site < SHA256_SITE_COUNT; ++site) {
+		stats_compressions[site].store(0, std::memory_order_relaxed);
+		stats_bytes[site].store(0, std::memory_order_relaxed);
+	}
+#endif
+}
+
+const char *sha256_site_name(SHA256_SITE site)
+{
+	static const char *names[SHA256_SITE_COUNT] = { "other", "tree", "commitment", "prf", "mac" };
+
+	if (site < 0 || site >= SHA256_SITE_COUNT)
+		return "unknown";
+	return names[site];
+}
@@ -26,9 +26,99 @@ typedef struct {
 	WORD state[8];
 } SHA256_CTX_mod;
 
+// A block whose first half is fixed (a key, say), hashed from the initial
+// state, with the work that depends only on that half done in advance.
+typedef struct {
+	BYTE prefix[SHA256_BLOCK_SIZE];
+	WORD schedule[8];               // message words 0-7
+	WORD midstate[8];               // working variables after round 7
+} SHA256_PREFIX;
+
+typedef enum {
+	SHA256_ENGINE_SCALAR,           // portable C, one block at a time
+	SHA256_ENGINE_SSE4,             // 4 blocks per instruction stream
+	SHA256_ENGINE_AVX2,             // 8 blocks per instruction stream
+	SHA256_ENGINE_AVX512,           // 16 blocks per instruction stream
+	SHA256_ENGINE_SHANI,            // SHA extensions, one block at a time
+	SHA256_ENGINE_COUNT
+} SHA256_ENGINE;
+
+// An implementation of the compression function. 'compress' runs one block
+// on the chaining value 'state' in place; 'compress_blocks' is as
+// sha256_compress_blocks below. Backends must be usable from any thread.
+typedef struct {
+	const char *name;
+	void (*compress)(WORD state[8], const BYTE block[64]);
+	void (*compress_blocks)(const BYTE blocks[], BYTE hashes[], size_t count);
+} SHA256_BACKEND;
+
+// Who the hashing is done for, when counting it (see sha256_stats_* below)
+typedef enum {
+	SHA256_SITE_OTHER,
+	SHA256_SITE_TREE,               // Merkle tree nodes and empty subtrees
+	SHA256_SITE_COMMITMENT,         // k and cm of coins
+	SHA256_SITE_PRF,                // a_pk and serial numbers
+	SHA256_SITE_MAC,                // the MACs of pour inputs
+	SHA256_SITE_COUNT
+} SHA256_SITE;
+
+typedef struct {
+	unsigned long long compressions;
+	unsigned long long bytes;       // message bytes, 64 per single-block call
+} SHA256_COUNTS;
+
 /*********************** FUNCTION DECLARATIONS **********************/
 void sha256_init(SHA256_CTX_mod *ctx);
 void sha256_update(SHA256_CTX_mod *ctx, const BYTE data[], size_t len);
 void sha256_final(SHA256_CTX_mod *ctx, BYTE hash[]);
 
+// The initial hash value H(0) of FIPS 180-2, section 5.3.2.
+extern const WORD sha256_iv[8];
+
+// One run of the compression function on a 64-byte block from the chaining
+// value 'state', with no padding or length block. 'hash' receives the new
+// chaining value in big-endian byte order. This is what
+// sha256_compression_function_gadget computes in the circuit.
+void sha256_compress(const WORD state[8], const BYTE block[64], BYTE hash[SHA256_BLOCK_SIZE]);
+
+// The Merkle tree node hash: sha256_compress(sha256_iv, left || right).
+void sha256_two_to_one(const BYTE left[SHA256_BLOCK_SIZE], const BYTE right[SHA256_BLOCK_SIZE],
+                       BYTE hash[SHA256_BLOCK_SIZE]);
+
+// sha256_two_to_one(prefix, suffix) for a prefix set up by sha256_prefix_init;
+// the _many form takes 'count' suffixes of 32 bytes and hashes them together.
+void sha256_prefix_init(SHA256_PREFIX *ctx, const BYTE prefix[SHA256_BLOCK_SIZE]);
+void sha256_prefix_compress(const SHA256_PREFIX *ctx, const BYTE suffix[SHA256_BLOCK_SIZE],
+                            BYTE hash[SHA256_BLOCK_SIZE]);
+void sha256_prefix_compress_many(const SHA256_PREFIX *ctx, const BYTE suffixes[], BYTE hashes[], size_t count);
+
+// Hashes 'count' independent 64-byte blocks; hashes[32*i ...] receives the
+// same value as sha256_init, sha256_update of blocks[64*i ...] and sha256_final.
+void sha256_compress_blocks(const BYTE blocks[], BYTE hashes[], size_t count);
+
+// All of the above (and sha256_update) run on the active backend. Unless one
+// is set explicitly, it is chosen on first use by sha256_select_backend,
+// which the hash provider implements (see HashProvider.h).
+const SHA256_BACKEND *sha256_get_backend(void);
+int sha256_set_backend(const SHA256_BACKEND *backend);
+const SHA256_BACKEND *sha256_select_backend(void);
+
+// The built-in backends. sha256_engine_backend returns NULL if the CPU
+// lacks the engine, and sha256_set_engine returns 0.
+int sha256_engine_supported(SHA256_ENGINE engine);
+const SHA256_BACKEND *sha256_engine_backend(SHA256_ENGINE engine);
+int sha256_set_engine(SHA256_ENGINE engine);
+const char *sha256_engine_name(SHA256_ENGINE engine);
+
+// Hash counters, compiled in only with HASH_STATS defined (make HASH_STATS=1);
+// otherwise sha256_stats_enabled returns 0 and the counts stay zero. Every
+// compression run by the functions above is added to the site the calling
+// thread has set, SHA256_SITE_OTHER unless set. sha256_stats_site returns
+// the site it replaces, for restoring (see HashSiteScope in util.h).
+int sha256_stats_enabled(void);
+SHA256_SITE sha256_stats_site(SHA256_SITE site);
+void sha256_stats_get(SHA256_SITE site, SHA256_COUNTS *counts);
+void sha256_stats_reset(void);
+const char *sha256_site_name(SHA256_SITE site);
+
 #endif   // SHA256H_H
@@ -88,32 +88,91 @@ void getRandBytes(unsigned char* bytes, int num) {
         std::cout << "rand_bytes error!" << ERR_get_error() << std::endl;
 }
 
-void convertBytesToVector(const unsigned char* bytes, std::vector<bool>& v) {
-    int numBytes = v.size() / 8;
-    unsigned char c;
-    for(int i = 0; i < numBytes; i++) {
-        c = bytes[i];
-
+/* Bit <-> byte conversion. libstdc++ stores a vector<bool> as an array of
+   words holding bit i at position i % W of word i / W, least significant
+   first. On little-endian hosts the bytes of a word therefore hold the bits
+   8k ... 8k + 7 of the vector in reverse order, so a whole word converts by
+   reversing the bits within each of its bytes. Other standard libraries
+   and debug-mode containers take the bit-by-bit path. */
+
+#if defined(__GLIBCXX__) && !defined(_GLIBCXX_DEBUG) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define UTIL_WORD_PARALLEL_BITS
+
+typedef std::_Bit_type BitWord;
+static const size_t bytesPerWord = sizeof(BitWord);
+
+// Reverses the order of the bits within each byte of a word (SWAR)
+static inline BitWord reverseBitsInBytes(BitWord w) {
+    w = ((w >> 1) & (BitWord)0x5555555555555555ULL) | ((w & (BitWord)0x5555555555555555ULL) << 1);
+    w = ((w >> 2) & (BitWord)0x3333333333333333ULL) | ((w & (BitWord)0x3333333333333333ULL) << 2);
+    w = ((w >> 4) & (BitWord)0x0F0F0F0F0F0F0F0FULL) | ((w & (BitWord)0x0F0F0F0F0F0F0F0FULL) << 4);
+    return w;
+}
+#endif
+
+// Writes bytes firstByte ... firstByte + numBytes - 1 of the bit vector to 'bytes'.
+static void convertBitsToBytes(const std::vector<bool>& v, size_t firstByte, size_t numBytes, unsigned char* bytes) {
+#ifdef UTIL_WORD_PARALLEL_BITS
+    const BitWord* words = v.begin()._M_p;
+    size_t i = 0;
+
+    for(; i < numBytes && (firstByte + i) % bytesPerWord != 0; i++) {
+        size_t byte = firstByte + i;
+        bytes[i] = reverseBitsInBytes(words[byte / bytesPerWord]) >> (8 * (byte % bytesPerWord));
+    }
+    for(; i + bytesPerWord <= numBytes; i += bytesPerWord) {
+        BitWord w = reverseBitsInBytes(words[(firstByte + i) / bytesPerWord]);
+        memcpy(bytes + i, &w, bytesPerWord);
+    }
+    for(; i < numBytes; i++) {
+        size_t byte = firstByte + i;
+        bytes[i] = reverseBitsInBytes(words[byte / bytesPerWord]) >> (8 * (byte % bytesPerWord));
+    }
+#else
+    for(size_t i = 0; i < numBytes; i++) {
+        unsigned char c = 0;
         for(int j = 0; j < 8; j++) {
-            v.at((i*8)+j) = ((c >> (7-j)) & 1);
+            c = (c << 1) | v[((firstByte + i)*8)+j];
         }
+        bytes[i] = c;
     }
+#endif
 }
 
-void convertVectorToBytes(const std::vector<bool>& v, unsigned char* bytes) {
-    int numBytes = v.size() / 8;
-    unsigned char c = '\0';
+// Writes 'numBytes' bytes to the first numBytes * 8 bits of the vector; later bits are kept.
+static void convertBytesToBits(const unsigned char* bytes, size_t numBytes, std::vector<bool>& v) {
+#ifdef UTIL_WORD_PARALLEL_BITS
+    BitWord* words = v.begin()._M_p;
+    size_t i = 0;
 
-    for(int i = 0; i < numBytes; i++) {
-        c = '\0';
+    for(; i + bytesPerWord <= numBytes; i += bytesPerWord) {
+        BitWord w;
+        memcpy(&w, bytes + i, bytesPerWord);
+        words[i / bytesPerWord] = reverseBitsInBytes(w);
+    }
+    if(i < numBytes) {
+        BitWord w = 0, mask = 0;
+        memcpy(&w, bytes + i, numBytes - i);
+        memset(&mask, 0xff, numBytes - i);
+
+        BitWord &last = words[i / bytesPerWord];
+        last = (last & ~mask) | (reverseBitsInBytes(w) & mask);
+    }
+#else
+    for(size_t i = 0; i < numBytes; i++) {
         for(int j = 0; j < 8; j++) {
-            if(j == 7)
-                c = ((c | v.at((i*8)+j)));
-            else
-                c = ((c | v.at((i*8)+j)) << 1);
+            v[(i*8)+j] = ((bytes[i] >> (7-j)) & 1);
         }
-        bytes[i] = c;
     }
+#endif
+}
+
+void convertBytesToVector(const unsigned char* bytes, std::vector<bool>& v) {
+    convertBytesToBits(bytes, v.size() / 8, v);
+}
+
+void convertVectorToBytes(const std::vector<bool>& v, unsigned char* bytes) {
+    convertBitsToBytes(v, 0, v.size() / 8, bytes);
 }
 
 void convertBytesToBytesVector(const unsigned char* bytes, std::vector<unsigned char>& v) {
@@ -129,34 +188,41 @@ void convertBytesVectorToBytes(const std::vector<unsigned char>& v, unsigned cha
 }
 
 void convertBytesVectorToVector(const std::vector<unsigned char>& bytes, std::vector<bool>& v) {
-	v.resize(bytes.size() * 8);
-    unsigned char bytesArr[bytes.size()];
-    convertBytesVectorToBytes(bytes, bytesArr);
-    convertBytesToVector(bytesArr, v);
+    v.resize(bytes.size() * 8);
+    convertBytesToBits(bytes.data(), bytes.size(), v);
 }
 
 void convertVectorToBytesVector(const std::vector<bool>& v, std::vector<unsigned char>& bytes) {
-    unsigned char bytesArr[int(ceil(v.size() / 8.))];
-    convertVectorToBytes(v, bytesArr);
-    convertBytesToBytesVector(bytesArr, bytes);
+    // Bytes past the whole bytes of 'v' are zero
+    size_t numBytes = std::min(bytes.size(), v.size() / 8);
+    convertBitsToBytes(v, 0, numBytes, bytes.data());
+    std::fill(bytes.begin() + numBytes, bytes.end(), 0);
 }
 
-void convertIntToBytesVector(const uint64_t val_int, std::vector<unsigned char>& bytes) {
-     for(size_t i = 0; i < bytes.size(); i++) {
-         bytes[bytes.size()-1-i] = (val_int >> (i * 8));
+void convertIntToBytes(const uint64_t val_int, unsigned char* bytes, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        bytes[len-1-i] = (val_int >> (i * 8));
     }
 }
 
-uint64_t convertBytesVectorToInt(const std::vector<unsigned char>& bytes) {
+void convertIntToBytesVector(const uint64_t val_int, std::vector<unsigned char>& bytes) {
+    convertIntToBytes(val_int, bytes.data(), bytes.size());
+}
+
+uint64_t convertBytesToInt(const unsigned char* bytes, size_t len) {
     uint64_t val_int = 0;
 
-    for(size_t i = 0; i < bytes.size(); i++) {
-        val_int = val_int + (((uint64_t)bytes[i]) << ((bytes.size()-1-i) * 8));
+    for(size_t i = 0; i < len; i++) {
+        val_int = val_int + (((uint64_t)bytes[i]) << ((len-1-i) * 8));
     }
 
     return val_int;
 }
 
+uint64_t convertBytesVectorToInt(const std::vector<unsigned char>& bytes) {
+    return convertBytesToInt(bytes.data(), bytes.size());
+}
+
 void concatenateVectors(const std::vector<bool>& A, const std::vector<bool>& B, std::vector<bool>& result) {
     result.reserve(A.size() + B.size());
     result.insert(result.end(), A.begin(), A.end());
@@ -183,129 +249,162 @@ void concatenateVectors(const std::vector<unsigned char>& A, const std::vector<u
     result.insert(result.end(), C.begin(), C.end());
 }
 
-void sha256(unsigned char* input, unsigned char* hash, int len) {
-	SHA256_CTX_mod ctx256;
+void hashBytes(SHA256_CTX_mod* ctx256, const unsigned char* input, size_t len, unsigned char* hash) {
+    sha256_init(ctx256);
+    sha256_update(ctx256, input, len);
+    sha256_final(ctx256, hash);
+}
 
-	sha256_init(&ctx256);
-	sha256_update(&ctx256, input, len);
-	sha256_final(&ctx256, hash);
+void hashBytes(const unsigned char* input, size_t len, unsigned char* hash) {
+    SHA256_CTX_mod ctx256;
+    hashBytes(&ctx256, input, len, hash);
 }
 
-void sha256(SHA256_CTX_mod* ctx256, unsigned char* input, unsigned char* hash, int len) {
-	sha256_init(ctx256);
-	sha256_update(ctx256, input, len);
-	sha256_final(ctx256, hash);
+void hashBytes(SHA256_CTX_mod* ctx256, const unsigned char* left, size_t leftLen,
+               const unsigned char* right, size_t rightLen, unsigned char* hash) {
+    // Two digests make exactly one block: compress it directly
+    if(leftLen == SHA256_BLOCK_SIZE && rightLen == SHA256_BLOCK_SIZE) {
+        sha256_two_to_one(left, right, hash);
+        return;
+    }
+
+    sha256_init(ctx256);
+    sha256_update(ctx256, left, leftLen);
+    sha256_update(ctx256, right, rightLen);
+    sha256_final(ctx256, hash);
 }
 
-void hashVector(SHA256_CTX_mod* ctx256, const std::vector<bool> input, std::vector<bool>& output) {
-    int size = int(input.size() / 8);
-    unsigned char bytes[size];
-    convertVectorToBytes(input, bytes);
+SHA256_CTX_mod* threadHashContext() {
+    static thread_local SHA256_CTX_mod ctx256;
+    return &ctx256;
+}
 
-    unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(ctx256, bytes, hash, (int)size);
+void sha256(unsigned char* input, unsigned char* hash, int len) {
+    hashBytes(input, len, hash);
+}
 
-    convertBytesToVector(hash, output);
+void sha256(SHA256_CTX_mod* ctx256, unsigned char* input, unsigned char* hash, int len) {
+    hashBytes(ctx256, input, len, hash);
 }
 
-void hashVector(SHA256_CTX_mod* ctx256, const std::vector<unsigned char> input, std::vector<unsigned char>& output) {
-    int size = int(input.size());
-    unsigned char bytes[size];
-    convertBytesVectorToBytes(input, bytes);
+// Feeds the first (|A| + |B|) / 8 bytes of the bit string A || B to the hash,
+// converting them one block at a time on the stack.
+static void updateWithBits(SHA256_CTX_mod* ctx256, const std::vector<bool>& A, const std::vector<bool>& B) {
+    unsigned char chunk[64];
+    size_t numBytes = (A.size() + B.size()) / 8;
 
-    unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(ctx256, bytes, hash, (int)size);
+    // Whole bytes on both sides: convert each side directly
+    if(A.size() % 8 == 0) {
+        for(size_t i = 0; i < A.size() / 8; i += sizeof(chunk)) {
+            size_t n = std::min(sizeof(chunk), A.size() / 8 - i);
+            convertBitsToBytes(A, i, n, chunk);
+            sha256_update(ctx256, chunk, n);
+        }
+        for(size_t i = 0; i < B.size() / 8; i += sizeof(chunk)) {
+            size_t n = std::min(sizeof(chunk), B.size() / 8 - i);
+            convertBitsToBytes(B, i, n, chunk);
+            sha256_update(ctx256, chunk, n);
+        }
+        return;
+    }
 
-    convertBytesToBytesVector(hash, output);
-}
+    size_t filled = 0;
+    for(size_t i = 0; i < numBytes; i++) {
+        unsigned char c = 0;
+        for(size_t j = 0; j < 8; j++) {
+            size_t bit = (i*8)+j;
+            c = (c << 1) | (bit < A.size() ? A[bit] : B[bit - A.size()]);
+        }
 
-void hashVector(const std::vector<bool> input, std::vector<bool>& output) {
-	SHA256_CTX_mod ctx256;
+        chunk[filled++] = c;
+        if(filled == sizeof(chunk)) {
+            sha256_update(ctx256, chunk, filled);
+            filled = 0;
+        }
+    }
 
-    int size = int(input.size() / 8);
-    unsigned char bytes[size];
-    convertVectorToBytes(input, bytes);
+    sha256_update(ctx256, chunk, filled);
+}
 
+void hashVector(SHA256_CTX_mod* ctx256, const std::vector<bool>& input, std::vector<bool>& output) {
+    static const std::vector<bool> none;
     unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(&ctx256, bytes, hash, (int)size);
+
+    sha256_init(ctx256);
+    updateWithBits(ctx256, input, none);
+    sha256_final(ctx256, hash);
 
     convertBytesToVector(hash, output);
 }
 
-void hashVector(const std::vector<unsigned char> input, std::vector<unsigned char>& output) {
-	SHA256_CTX_mod ctx256;
-
-    int size = int(input.size());
-    unsigned char bytes[size];
-    convertBytesVectorToBytes(input, bytes);
-
+void hashVector(SHA256_CTX_mod* ctx256, const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
     unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(&ctx256, bytes, hash, (int)size);
+    hashBytes(ctx256, input.data(), input.size(), hash);
 
     convertBytesToBytesVector(hash, output);
 }
 
-void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<bool> left, const std::vector<bool> right, std::vector<bool>& output) {
-    std::vector<bool> concat;
-    concatenateVectors(left, right, concat);
+void hashVector(const std::vector<bool>& input, std::vector<bool>& output) {
+    SHA256_CTX_mod ctx256;
+    hashVector(&ctx256, input, output);
+}
 
-    int size = int(concat.size() / 8);
-    unsigned char bytes[size];
-    convertVectorToBytes(concat, bytes);
+void hashVector(const std::vector<unsigned char>& input, std::vector<unsigned char>& output) {
+    SHA256_CTX_mod ctx256;
+    hashVector(&ctx256, input, output);
+}
 
+void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<bool>& left, const std::vector<bool>& right, std::vector<bool>& output) {
     unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(ctx256, bytes, hash, (int)size);
+
+    if(left.size() == SHA256_BLOCK_SIZE * 8 && right.size() == SHA256_BLOCK_SIZE * 8) {
+        unsigned char block[2 * SHA256_BLOCK_SIZE];
+        convertVectorToBytes(left, block);
+        convertVectorToBytes(right, block + SHA256_BLOCK_SIZE);
+        sha256_two_to_one(block, block + SHA256_BLOCK_SIZE, hash);
+    }
+    else {
+        sha256_init(ctx256);
+        updateWithBits(ctx256, left, right);
+        sha256_final(ctx256, hash);
+    }
 
     convertBytesToVector(hash, output);
 }
 
-void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<unsigned char> left, const std::vector<unsigned char> right, std::vector<unsigned char>& output) {
-    std::vector<unsigned char> concat;
-    concatenateVectors(left, right, concat);
-
-    int size = int(concat.size());
-    unsigned char bytes[size];
-    convertBytesVectorToBytes(concat, bytes);
-
+void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<unsigned char>& left, const std::vector<unsigned char>& right, std::vector<unsigned char>& output) {
     unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(ctx256, bytes, hash, (int)size);
+    hashBytes(ctx256, left.data(), left.size(), right.data(), right.size(), hash);
 
     convertBytesToBytesVector(hash, output);
 }
 
-void hashVectors(const std::vector<bool> left, const std::vector<bool> right, std::vector<bool>& output) {
-	std::cout << std::endl;
-
-    std::vector<bool> concat;
-    concatenateVectors(left, right, concat);
-
-    int size = int(concat.size() / 8);
-    unsigned char bytes[size];
-    convertVectorToBytes(concat, bytes);
-
-    unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(bytes, hash, (int)size);
-
-    convertBytesToVector(hash, output);
+void hashVectors(const std::vector<bool>& left, const std::vector<bool>& right, std::vector<bool>& output) {
+    SHA256_CTX_mod ctx256;
+    hashVectors(&ctx256, left, right, output);
 }
 
-void hashVectors(const std::vector<unsigned char> left, const std::vector<unsigned char> right, std::vector<unsigned char>& output) {
-    std::vector<unsigned char> concat;
-    concatenateVectors(left, right, concat);
-
-    int size = int(concat.size());
-    unsigned char bytes[size];
-    convertBytesVectorToBytes(concat, bytes);
-
-    unsigned char hash[SHA256_BLOCK_SIZE];
-    sha256(bytes, hash, (int)size);
-
-    convertBytesToBytesVector(hash, output);
+void hashVectors(const std::vector<unsigned char>& left, const std::vector<unsigned char>& right, std::vector<unsigned char>& output) {
+    SHA256_CTX_mod ctx256;
+    hashVectors(&ctx256, left, right, output);
 }
 
-bool VectorIsZero(const std::vector<bool> test) {
+bool VectorIsZero(const std::vector<bool>& test) {
 	return (test.end() == std::find(test.begin(), test.end(), true));
 }
 
-} /* namespace libzerocash */
+void printHashStats(const std::string str) {
+    if (!sha256_stats_enabled()) {
+        return;
+    }
 
+    std::cout << str << ": SHA-256 compressions (bytes hashed) by site" << std::endl;
+    for (int site = 0; site < SHA256_SITE_COUNT; site++) {
+        SHA256_COUNTS counts;
+        sha256_stats_get((SHA256_SITE)site, &counts);
+        std::cout << "  " << std::dec << std::setfill(' ') << std::left << std::setw(12) << sha256_site_name((SHA256_SITE)site) << std::right
+                  << std::setw(14) << counts.compressions << " (" << counts.bytes << ")" << std::endl;
+    }
+}
+
+} /* namespace libzerocash */
@@ -40,8 +40,13 @@ void convertBytesVectorToVector(const std::vector<unsigned char>& bytes, std::ve
 
 void convertVectorToBytesVector(const std::vector<bool>& v, std::vector<unsigned char>& bytes);
 
+// Big-endian integers of 'len' bytes, 'len' at most 8
+void convertIntToBytes(const uint64_t val_int, unsigned char* bytes, size_t len);
+
 void convertIntToBytesVector(const uint64_t val_int, std::vector<unsigned char>& bytes);
 
+uint64_t convertBytesToInt(const unsigned char* bytes, size_t len);
+
 uint64_t convertBytesVectorToInt(const std::vector<unsigned char>& bytes);
 
 void concatenateVectors(const std::vector<bool>& A, const std::vector<bool>& B, std::vector<bool>& result);
@@ -52,27 +57,63 @@ void concatenateVectors(const std::vector<bool>& A, const std::vector<bool>& B,
 
 void concatenateVectors(const std::vector<unsigned char>& A, const std::vector<unsigned char>& B, const std::vector<unsigned char>& C, std::vector<unsigned char>& result);
 
+// Hashing of contiguous bytes. None of these allocate; the vector overloads
+// below are thin wrappers around them.
+void hashBytes(const unsigned char* input, size_t len, unsigned char* hash);
+
+void hashBytes(SHA256_CTX_mod* ctx256, const unsigned char* input, size_t len, unsigned char* hash);
+
+// Hash of left || right, without building the concatenation
+void hashBytes(SHA256_CTX_mod* ctx256, const unsigned char* left, size_t leftLen,
+               const unsigned char* right, size_t rightLen, unsigned char* hash);
+
+// A context owned by the calling thread, for code that needs one only for
+// the length of a call. It is shared by all such code on the thread, so it
+// must not be held across calls that may use it too.
+SHA256_CTX_mod* threadHashContext();
+
 void sha256(unsigned char* input, unsigned char* hash, int len);
 
 void sha256(SHA256_CTX_mod* ctx256, unsigned char* input, unsigned char* hash, int len);
 
-void hashVector(SHA256_CTX_mod* ctx256, const std::vector<bool> input, std::vector<bool>& output);
+void hashVector(SHA256_CTX_mod* ctx256, const std::vector<bool>& input, std::vector<bool>& output);
+
+void hashVector(SHA256_CTX_mod* ctx256, const std::vector<unsigned char>& input, std::vector<unsigned char>& output);
+
+void hashVector(const std::vector<bool>& input, std::vector<bool>& output);
+
+void hashVector(const std::vector<unsigned char>& input, std::vector<unsigned char>& output);
+
+void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<bool>& left, const std::vector<bool>& right, std::vector<bool>& output);
 
-void hashVector(SHA256_CTX_mod* ctx256, const std::vector<unsigned char> input, std::vector<unsigned char>& output);
+void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<unsigned char>& left, const std::vector<unsigned char>& right, std::vector<unsigned char>& output);
 
-void hashVector(const std::vector<bool> input, std::vector<bool>& output);
+void hashVectors(const std::vector<bool>& left, const std::vector<bool>& right, std::vector<bool>& output);
 
-void hashVector(const std::vector<unsigned char> input, std::vector<unsigned char>& output);
+void hashVectors(const std::vector<unsigned char>& left, const std::vector<unsigned char>& right, std::vector<unsigned char>& output);
 
-void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<bool> left, const std::vector<bool> right, std::vector<bool>& output);
+bool VectorIsZero(const std::vector<bool>& test);
 
-void hashVectors(SHA256_CTX_mod* ctx256, const std::vector<unsigned char> left, const std::vector<unsigned char> right, std::vector<unsigned char>& output);
+// Counts the hashing done by this thread while in scope towards 'site'.
+// Compiles to nothing unless HASH_STATS is defined.
+class HashSiteScope {
+public:
+#ifdef HASH_STATS
+    explicit HashSiteScope(SHA256_SITE site) : previous(sha256_stats_site(site)) { }
+    ~HashSiteScope() { sha256_stats_site(previous); }
 
-void hashVectors(const std::vector<bool> left, const std::vector<bool> right, std::vector<bool>& output);
+private:
+    HashSiteScope(const HashSiteScope&);
+    HashSiteScope& operator=(const HashSiteScope&);
 
-void hashVectors(const std::vector<unsigned char> left, const std::vector<unsigned char> right, std::vector<unsigned char>& output);
+    SHA256_SITE previous;
+#else
+    explicit HashSiteScope(SHA256_SITE site) { }
+#endif
+};
 
-bool VectorIsZero(const std::vector<bool> test);
+// Prints the hash counters of every site under 'str', if they are compiled in.
+void printHashStats(const std::string str);
 
 } /* namespace libzerocash */
 #endif /* UTIL_H_ */
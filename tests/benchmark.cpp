@@ -0,0 +1,627 @@
+/** @file
+ *****************************************************************************
+
+ Throughput benchmarks for libzerocash primitives.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#include "libzerocash/Coin.h"
+#include "libzerocash/CoinCommitment.h"
+#include "libzerocash/CommitmentIndex.h"
+#include "libzerocash/ConcurrentMerkleTree.h"
+#include "libzerocash/IncrementalMerkleTree.h"
+#include "libzerocash/FlatMerkleTree.h"
+#include "libzerocash/MappedMerkleTree.h"
+#include "libzerocash/MerkleTree.h"
+#include "libzerocash/PRF.h"
+#include "libzerocash/utils/HashProvider.h"
+#include "libzerocash/utils/ThreadPool.h"
+#include "libzerocash/utils/sha256.h"
+#include "libzerocash/utils/util.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace libzerocash;
+using namespace std;
+
+// Every heap allocation of the program goes through here, so that hashing
+// paths can be checked for allocations.
+static atomic<size_t> numAllocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	numAllocations++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+static double secondsSince(const chrono::steady_clock::time_point &start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const string &name, size_t items, double seconds)
+{
+	printf("%-48s %10zu items %10.4fs %12.0f items/s\n", name.c_str(), items, seconds, items / seconds);
+}
+
+static void randomLeaves(size_t count, vector< vector<bool> > &leaves)
+{
+	leaves.assign(count, vector<bool>(256));
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < 256; j++) {
+			leaves[i][j] = (rand() & 1);
+		}
+	}
+}
+
+/* Appending a block of commitments: one insertElement per leaf vs. a single batch */
+void benchmarkMerkleAppend(size_t batchSize, size_t numBatches)
+{
+	vector< vector<bool> > leaves;
+	randomLeaves(batchSize, leaves);
+
+	chrono::steady_clock::time_point start;
+	vector<bool> index;
+	vector< vector<bool> > indices;
+
+	{
+		IncrementalMerkleTree tree;
+		start = chrono::steady_clock::now();
+		for (size_t b = 0; b < numBatches; b++) {
+			for (size_t i = 0; i < leaves.size(); i++) {
+				tree.insertElement(leaves[i], index);
+			}
+		}
+		report("IncrementalMerkleTree insertElement loop", batchSize * numBatches, secondsSince(start));
+	}
+
+	{
+		IncrementalMerkleTree tree;
+		start = chrono::steady_clock::now();
+		for (size_t b = 0; b < numBatches; b++) {
+			tree.insertElements(leaves, indices);
+		}
+		report("IncrementalMerkleTree insertElements", batchSize * numBatches, secondsSince(start));
+	}
+
+	{
+		FlatIncrementalMerkleTree tree;
+		start = chrono::steady_clock::now();
+		for (size_t b = 0; b < numBatches; b++) {
+			for (size_t i = 0; i < leaves.size(); i++) {
+				tree.insertElement(leaves[i], index);
+			}
+		}
+		report("FlatIncrementalMerkleTree insertElement loop", batchSize * numBatches, secondsSince(start));
+	}
+
+	{
+		FlatIncrementalMerkleTree tree;
+		start = chrono::steady_clock::now();
+		for (size_t b = 0; b < numBatches; b++) {
+			tree.insertElements(leaves, indices);
+		}
+		report("FlatIncrementalMerkleTree insertElements", batchSize * numBatches, secondsSince(start));
+	}
+}
+
+/* Cold start: building a tree from a stored list of commitments, serial vs. all cores */
+void benchmarkMerkleBuild(size_t numLeaves)
+{
+	vector< vector<bool> > leaves;
+	randomLeaves(numLeaves, leaves);
+
+	ThreadPool serialPool(1);
+	ThreadPool &parallelPool = ThreadPool::getDefault();
+	chrono::steady_clock::time_point start;
+
+	ThreadPool *pools[] = { &serialPool, &parallelPool };
+	for (size_t p = 0; p < 2; p++) {
+		string threads = " (" + to_string(pools[p]->size() + 1) + " threads)";
+
+		start = chrono::steady_clock::now();
+		{ MerkleTree tree(leaves, 64, *pools[p]); }
+		report("MerkleTree build" + threads, numLeaves, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		{ IncrementalMerkleTree tree(leaves, ZEROCASH_DEFAULT_TREE_SIZE, *pools[p]); }
+		report("IncrementalMerkleTree build" + threads, numLeaves, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		{ FlatIncrementalMerkleTree tree(leaves, ZEROCASH_DEFAULT_TREE_SIZE, *pools[p]); }
+		report("FlatIncrementalMerkleTree build" + threads, numLeaves, secondsSince(start));
+	}
+}
+
+/* Hashing independent 64-byte blocks on each SHA-256 backend, and a level-by-level rebuild with each */
+void benchmarkSha256Engines(size_t numBlocks)
+{
+	vector<unsigned char> blocks(64 * numBlocks), hashes(32 * numBlocks);
+	for (size_t i = 0; i < blocks.size(); i++) {
+		blocks[i] = rand() & 0xff;
+	}
+
+	vector<MerkleDigest> leaves(numBlocks);
+	for (size_t i = 0; i < numBlocks; i++) {
+		memcpy(leaves[i].data(), &blocks[32 * i], 32);
+	}
+
+	const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+	vector<const SHA256_BACKEND*> backends = HashProvider::available();
+	ThreadPool serialPool(1);
+	chrono::steady_clock::time_point start;
+
+	for (size_t b = 0; b < backends.size(); b++) {
+		sha256_set_backend(backends[b]);
+		string name = backends[b]->name;
+
+		start = chrono::steady_clock::now();
+		sha256_compress_blocks(&blocks[0], &hashes[0], numBlocks);
+		report("sha256_compress_blocks (" + name + ")", numBlocks, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		{ FlatMerkleTree tree; tree.assign(leaves, serialPool); }
+		report("FlatMerkleTree assign (" + name + ")", numBlocks, secondsSince(start));
+	}
+
+	sha256_set_backend(defaultBackend);
+}
+
+/* One Merkle node hash: the padded init/update/final path vs. a single compression */
+void benchmarkTwoToOne(size_t numHashes)
+{
+	MerkleDigest left, right, hash;
+	left.fill(0x5a);
+	right.fill(0xa5);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (size_t i = 0; i < numHashes; i++) {
+		SHA256_CTX_mod ctx256;
+		sha256_init(&ctx256);
+		sha256_update(&ctx256, left.data(), left.size());
+		sha256_update(&ctx256, right.data(), right.size());
+		sha256_final(&ctx256, hash.data());
+		left[i % 32] ^= hash[0];
+	}
+	report("sha256_init/update/final (64 bytes)", numHashes, secondsSince(start));
+
+	start = chrono::steady_clock::now();
+	for (size_t i = 0; i < numHashes; i++) {
+		sha256_two_to_one(left.data(), right.data(), hash.data());
+		left[i % 32] ^= hash[0];
+	}
+	report("sha256_two_to_one", numHashes, secondsSince(start));
+
+	vector<bool> leftBits(256, true), rightBits(256, false), hashBits(256);
+	start = chrono::steady_clock::now();
+	for (size_t i = 0; i < numHashes / 16; i++) {
+		hashVectors(leftBits, rightBits, hashBits);
+	}
+	report("hashVectors (vector<bool>, no context)", numHashes / 16, secondsSince(start));
+
+	SHA256_CTX_mod ctx256;
+	start = chrono::steady_clock::now();
+	for (size_t i = 0; i < numHashes / 16; i++) {
+		hashVectors(&ctx256, leftBits, rightBits, hashBits);
+	}
+	report("hashVectors (vector<bool>, with context)", numHashes / 16, secondsSince(start));
+}
+
+/* Converting commitment-sized and Pour-input-sized bit vectors to bytes and back,
+   against a loop that moves one bit at a time */
+void benchmarkBitConversion(size_t numConversions)
+{
+	const size_t sizes[] = { 256, 2048 };
+
+	for (size_t s = 0; s < 2; s++) {
+		vector<bool> bits(sizes[s]);
+		vector<unsigned char> bytes(sizes[s] / 8);
+		for (size_t i = 0; i < bits.size(); i++) {
+			bits[i] = rand() & 1;
+		}
+		string size = " (" + to_string(sizes[s]) + " bits)";
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (size_t n = 0; n < numConversions; n++) {
+			for (size_t i = 0; i < bytes.size(); i++) {
+				unsigned char c = 0;
+				for (size_t j = 0; j < 8; j++) {
+					c = (c << 1) | bits[i * 8 + j];
+				}
+				bytes[i] = c;
+			}
+			for (size_t i = 0; i < bits.size(); i++) {
+				bits[i] = (bytes[i / 8] >> (7 - (i % 8))) & 1;
+			}
+		}
+		report("bit-by-bit round trip" + size, numConversions, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		for (size_t n = 0; n < numConversions; n++) {
+			convertVectorToBytes(bits, bytes.data());
+			convertBytesToVector(bytes.data(), bits);
+		}
+		report("convertVectorToBytes/BytesToVector" + size, numConversions, secondsSince(start));
+	}
+}
+
+/* Heap allocations per call of each hashing entry point */
+void benchmarkHashAllocations(size_t numHashes)
+{
+	vector<bool> leftBits(256, true), rightBits(256, false), longBits(1000, true), hashBits(256);
+	vector<unsigned char> leftBytes(32, 0x5a), rightBytes(32, 0xa5), longBytes(125, 0x33), hashBytesVector(32);
+	unsigned char hash[32];
+	SHA256_CTX_mod ctx256;
+
+	struct {
+		const char *name;
+		function<void()> call;
+	} paths[] = {
+		{ "hashBytes (125 bytes)", [&]() { hashBytes(longBytes.data(), longBytes.size(), hash); } },
+		{ "hashBytes (32 + 32 bytes)", [&]() { hashBytes(&ctx256, leftBytes.data(), 32, rightBytes.data(), 32, hash); } },
+		{ "hashVector (vector<bool>, 1000 bits)", [&]() { hashVector(longBits, hashBits); } },
+		{ "hashVectors (vector<bool>, 256 + 256 bits)", [&]() { hashVectors(leftBits, rightBits, hashBits); } },
+		{ "hashVectors (vector<bool>, 256 + 1000 bits)", [&]() { hashVectors(&ctx256, leftBits, longBits, hashBits); } },
+		{ "hashVectors (bytes, 32 + 32 bytes)", [&]() { hashVectors(leftBytes, rightBytes, hashBytesVector); } },
+	};
+
+	for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+		size_t before = numAllocations.load();
+		for (size_t i = 0; i < numHashes; i++) {
+			paths[p].call();
+		}
+		printf("%-48s %10.2f allocations/hash\n", paths[p].name, double(numAllocations.load() - before) / numHashes);
+	}
+}
+
+/* Persistent store: batched appends, reopening and witness queries */
+void benchmarkMappedTree(size_t numLeaves)
+{
+	char dirTemplate[] = "/tmp/benchmark.XXXXXX";
+	if (mkdtemp(dirTemplate) == NULL) {
+		return;
+	}
+	string directory(dirTemplate);
+
+	vector<MerkleDigest> batch(1024);
+	for (size_t i = 0; i < batch.size(); i++) {
+		for (size_t j = 0; j < batch[i].size(); j++) {
+			batch[i][j] = rand() & 0xff;
+		}
+	}
+
+	chrono::steady_clock::time_point start;
+	uint64_t position;
+
+	{
+		MappedMerkleTree tree(directory);
+		start = chrono::steady_clock::now();
+		for (size_t appended = 0; appended < numLeaves; appended += batch.size()) {
+			tree.appendBatch(batch, position);
+		}
+		tree.sync();
+		report("MappedMerkleTree appendBatch + sync", tree.size(), secondsSince(start));
+	}
+
+	{
+		start = chrono::steady_clock::now();
+		MappedMerkleTree tree(directory);
+		MerkleDigest root;
+		tree.getRoot(root);
+		report("MappedMerkleTree open + getRoot", 1, secondsSince(start));
+
+		vector<MerkleDigest> witness;
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < 100000; i++) {
+			tree.getWitness((uint64_t(rand()) * RAND_MAX + rand()) % tree.size(), witness);
+		}
+		report("MappedMerkleTree getWitness", 100000, secondsSince(start));
+	}
+
+	for (uint32_t level = 0; level <= ZEROCASH_DEFAULT_TREE_SIZE; level++) {
+		char name[32];
+		snprintf(name, sizeof(name), "/level-%02u.dat", level);
+		unlink((directory + name).c_str());
+	}
+	unlink((directory + "/tree.meta").c_str());
+	rmdir(directory.c_str());
+}
+
+/* Coin lookup: the former std::map of bit vectors vs. the open-addressing index */
+void benchmarkCommitmentIndex(size_t mapEntries, size_t indexEntries)
+{
+	vector<MerkleDigest> commitments(indexEntries);
+	for (size_t i = 0; i < indexEntries; i++) {
+		for (size_t j = 0; j < commitments[i].size(); j++) {
+			commitments[i][j] = rand() & 0xff;
+		}
+	}
+
+	chrono::steady_clock::time_point start;
+	size_t found = 0;
+
+	{
+		map<vector<bool>, int> coinlist;
+		vector< vector<bool> > keys(mapEntries, vector<bool>(256));
+		for (size_t i = 0; i < mapEntries; i++) {
+			convertBytesToVector(commitments[i].data(), keys[i]);
+		}
+
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < mapEntries; i++) {
+			coinlist[keys[i]] = i;
+		}
+		report("std::map<vector<bool>, int> insert", mapEntries, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < mapEntries; i++) {
+			found += coinlist.count(keys[(i * 7919) % mapEntries]);
+		}
+		report("std::map<vector<bool>, int> lookup", mapEntries, secondsSince(start));
+	}
+
+	{
+		CommitmentIndex index;
+		uint64_t position;
+
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < indexEntries; i++) {
+			index.insert(commitments[i], i);
+		}
+		report("CommitmentIndex insert", indexEntries, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		for (size_t i = 0; i < indexEntries; i++) {
+			found += index.find(commitments[(i * 7919) % indexEntries], position);
+		}
+		report("CommitmentIndex lookup", indexEntries, secondsSince(start));
+	}
+
+	if (found != mapEntries + indexEntries) {
+		printf("unexpected lookup misses\n");
+	}
+}
+
+/* Witness queries against a concurrent tree, with the writer idle and while it appends */
+void benchmarkConcurrentTree(size_t numLeaves, size_t batchSize, size_t numReaders)
+{
+	vector<MerkleDigest> leaves(2 * numLeaves);
+	for (size_t i = 0; i < leaves.size(); i++) {
+		for (size_t j = 0; j < leaves[i].size(); j++) {
+			leaves[i][j] = rand() & 0xff;
+		}
+	}
+
+	ConcurrentMerkleTree tree;
+	uint64_t position;
+	tree.appendBatch(vector<MerkleDigest>(leaves.begin(), leaves.begin() + numLeaves), position);
+
+	for (int ingest = 0; ingest < 2; ingest++) {
+		atomic<bool> done(false);
+		atomic<size_t> queries(0);
+		vector<thread> readers;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (size_t r = 0; r < numReaders; r++) {
+			readers.push_back(thread([&, r]() {
+				vector<MerkleDigest> witness;
+				size_t count = 0;
+				for (size_t query = r; !done.load(memory_order_relaxed); query++, count++) {
+					ConcurrentMerkleTree::ReadGuard snapshot(tree);
+					snapshot->getWitness((query * 7919) % snapshot->size(), witness);
+				}
+				queries += count;
+			}));
+		}
+
+		size_t appended = 0;
+		if (ingest) {
+			for (size_t i = numLeaves; i + batchSize <= leaves.size(); i += batchSize) {
+				tree.appendBatch(vector<MerkleDigest>(leaves.begin() + i, leaves.begin() + i + batchSize), position);
+				appended += batchSize;
+			}
+		} else {
+			this_thread::sleep_for(chrono::milliseconds(500));
+		}
+
+		done = true;
+		for (size_t r = 0; r < readers.size(); r++) {
+			readers[r].join();
+		}
+		double seconds = secondsSince(start);
+
+		report(ingest ? "ConcurrentMerkleTree getWitness (ingesting)" : "ConcurrentMerkleTree getWitness (idle)",
+		       queries.load(), seconds);
+		if (ingest) {
+			report("ConcurrentMerkleTree appendBatch", appended, seconds);
+		}
+	}
+}
+
+/* The startup calibration of the hash provider, and what it settled on */
+void benchmarkHashProvider(size_t numBlocks)
+{
+	vector<HashProvider::Calibration> calibration = HashProvider::calibrate(numBlocks);
+	for (size_t i = 0; i < calibration.size(); i++) {
+		printf("%-12s %s %12.0f single blocks/s %12.0f independent blocks/s\n",
+		       calibration[i].backend->name, calibration[i].correct ? "ok  " : "FAIL",
+		       calibration[i].compressPerSecond, calibration[i].blocksPerSecond);
+	}
+	printf("selected backend: %s\n", HashProvider::get().name);
+}
+
+/* Serial numbers of every coin of one address, as a wallet scan computes them */
+void benchmarkPRF(size_t numCoins)
+{
+	vector<unsigned char> a_sk(32);
+	vector<CoinNonce> rhos(numCoins);
+	vector<SerialNumber> sns;
+	for (size_t i = 0; i < 32; i++) {
+		a_sk[i] = rand() & 0xff;
+	}
+	for (size_t j = 0; j < numCoins; j++) {
+		for (size_t i = 0; i < 32; i++) {
+			rhos[j][i] = rand() & 0xff;
+		}
+	}
+
+	const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+	const SHA256_BACKEND *backends[] = { sha256_engine_backend(SHA256_ENGINE_SCALAR), defaultBackend };
+	chrono::steady_clock::time_point start;
+
+	for (size_t b = 0; b < 2; b++) {
+		sha256_set_backend(backends[b]);
+		string name = string(" (") + backends[b]->name + ")";
+
+		// Bit by bit, as PourTransaction used to
+		start = chrono::steady_clock::now();
+		vector<bool> a_sk_bv(256);
+		convertBytesVectorToVector(a_sk, a_sk_bv);
+		for (size_t j = 0; j < numCoins; j++) {
+			vector<bool> rho_bv(256), internal, sn_bv(256);
+			vector<unsigned char> sn(32);
+			convertBytesToVector(rhos[j].data(), rho_bv);
+			rho_bv.erase(rho_bv.end() - 2, rho_bv.end());
+			rho_bv.insert(rho_bv.begin(), 1);
+			rho_bv.insert(rho_bv.begin(), 0);
+			concatenateVectors(a_sk_bv, rho_bv, internal);
+			hashVector(internal, sn_bv);
+			convertVectorToBytesVector(sn_bv, sn);
+		}
+		report("serial numbers, bit vectors" + name, numCoins, secondsSince(start));
+
+		PRF prf(a_sk);
+
+		start = chrono::steady_clock::now();
+		SerialNumber sn;
+		for (size_t j = 0; j < numCoins; j++) {
+			prf.sn(rhos[j], sn);
+		}
+		report("serial numbers, PRF::sn" + name, numCoins, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		prf.sn(rhos, sns);
+		report("serial numbers, PRF::sn batch" + name, numCoins, secondsSince(start));
+	}
+
+	sha256_set_backend(defaultBackend);
+}
+
+void benchmarkCoinCommitments(size_t numCoins)
+{
+	vector< vector<unsigned char> > a_pks(numCoins, vector<unsigned char>(a_pk_size));
+	vector<CoinNonce> rhos(numCoins);
+	vector<CommitmentTrapdoor> rs(numCoins);
+	vector<uint64_t> values(numCoins);
+	for (size_t j = 0; j < numCoins; j++) {
+		for (size_t i = 0; i < a_pk_size; i++) {
+			a_pks[j][i] = rand() & 0xff;
+		}
+		for (size_t i = 0; i < rho_size; i++) {
+			rhos[j][i] = rand() & 0xff;
+		}
+		for (size_t i = 0; i < zc_r_size; i++) {
+			rs[j][i] = rand() & 0xff;
+		}
+		values[j] = rand();
+	}
+
+	const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+	const SHA256_BACKEND *backends[] = { sha256_engine_backend(SHA256_ENGINE_SCALAR), defaultBackend };
+	chrono::steady_clock::time_point start;
+
+	for (size_t b = 0; b < 2; b++) {
+		sha256_set_backend(backends[b]);
+		string name = string(" (") + backends[b]->name + ")";
+
+		// One coin at a time, as the Coin constructors do
+		start = chrono::steady_clock::now();
+		SHA256_CTX_mod ctx256;
+		for (size_t j = 0; j < numCoins; j++) {
+			unsigned char hash[k_size];
+			InternalCommitment k;
+			ValueBytes value;
+			hashBytes(&ctx256, a_pks[j].data(), a_pk_size, rhos[j].data(), rho_size, hash);
+			hashBytes(&ctx256, rs[j].data(), zc_r_size, hash, 16, k.data());
+			convertIntToBytes(values[j], value.data(), v_size);
+			CoinCommitment cm(value, k);
+		}
+		report("coin commitments, one at a time" + name, numCoins, secondsSince(start));
+
+		start = chrono::steady_clock::now();
+		vector<InternalCommitment> ks;
+		vector<MerkleDigest> cms;
+		Coin::computeCommitments(a_pks, rhos, rs, values, ks, cms);
+		report("coin commitments, batch" + name, numCoins, secondsSince(start));
+	}
+
+	sha256_set_backend(defaultBackend);
+}
+
+void benchmarkTreeMemory(size_t numLeaves)
+{
+	vector< vector<bool> > leaves;
+	randomLeaves(numLeaves, leaves);
+
+	IncrementalMerkleTree tree;
+	vector< vector<bool> > indices;
+	tree.insertElements(leaves, indices);
+
+	// Nodes used to carry their own hashing context
+	for (int pruned = 0; pruned < 2; pruned++) {
+		size_t bytes = tree.memoryUsage(), nodes = tree.numNodes();
+		printf("%-48s %10zu nodes %10.1f bytes/leaf (%.1f with a context per node)\n",
+		       pruned ? "IncrementalMerkleTree memory, pruned" : "IncrementalMerkleTree memory",
+		       nodes, double(bytes) / numLeaves, double(bytes + nodes * sizeof(SHA256_CTX_mod)) / numLeaves);
+		tree.prune();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t batchSize = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1024;
+	size_t numBatches = (argc > 2) ? strtoul(argv[2], NULL, 10) : 16;
+
+	benchmarkMerkleAppend(batchSize, numBatches);
+	benchmarkMerkleBuild(batchSize * numBatches * 16);
+	benchmarkTreeMemory(batchSize * numBatches);
+	benchmarkHashProvider(batchSize * numBatches * 4);
+	benchmarkSha256Engines(batchSize * numBatches * 64);
+	benchmarkTwoToOne(batchSize * numBatches * 64);
+	benchmarkHashAllocations(10000);
+	benchmarkBitConversion(100000);
+	benchmarkPRF(100000);
+	benchmarkCoinCommitments(100000);
+	benchmarkMappedTree(batchSize * numBatches * 64);
+	benchmarkCommitmentIndex(1000000, 10000000);
+	benchmarkConcurrentTree(batchSize * numBatches * 64, batchSize, 4);
+
+	printHashStats("benchmark");
+
+	return 0;
+}
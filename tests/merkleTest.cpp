@@ -10,11 +10,29 @@
  *****************************************************************************/
 
 #include "libzerocash/IncrementalMerkleTree.h"
+#include "libzerocash/CommitmentIndex.h"
+#include "libzerocash/ConcurrentMerkleTree.h"
+#include "libzerocash/EmptySubtreeTable.h"
+#include "libzerocash/FlatMerkleTree.h"
+#include "libzerocash/MappedMerkleTree.h"
 #include "libzerocash/MerkleTree.h"
+#include "libzerocash/utils/HashProvider.h"
+#include "libzerocash/utils/ThreadPool.h"
+#include "libzerocash/utils/sha256.h"
+#include "libzerocash/utils/util.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include <unistd.h>
+
 using namespace libzerocash;
 using namespace std;
 
@@ -37,6 +55,17 @@ void constructTestVector(std::vector< std::vector<bool> > &values)
 	}
 }
 
+std::vector< std::vector<bool> > randomLeaves(size_t numLeaves)
+{
+	std::vector< std::vector<bool> > values(numLeaves, std::vector<bool>(256));
+	for (size_t i = 0; i < numLeaves; i++) {
+		for (size_t j = 0; j < values[i].size(); j++) {
+			values[i][j] = (rand() & 1);
+		}
+	}
+	return values;
+}
+
 bool testCompactRep(IncrementalMerkleTree &inTree)
 {
 	IncrementalMerkleTreeCompact compact;
@@ -68,7 +97,896 @@ bool testCompactRep(IncrementalMerkleTree &inTree)
 	return true;
 }
 
+bool testFlatTree(uint32_t height, size_t numLeaves)
+{
+	IncrementalMerkleTree incTree(height);
+	FlatIncrementalMerkleTree flatTree(height);
+	std::vector< std::vector<bool> > indices, values = randomLeaves(numLeaves);
+
+	for (size_t i = 0; i < numLeaves; i++) {
+		std::vector<bool> index1, index2;
+		if (incTree.insertElement(values[i], index1) == false || flatTree.insertElement(values[i], index2) == false ||
+			index1 != index2) {
+			cout << "Flat tree: insertion mismatch at leaf " << i << endl;
+			return false;
+		}
+		indices.push_back(index1);
+	}
+
+	std::vector<bool> root1, root2;
+	incTree.getRootValue(root1);
+	flatTree.getRootValue(root2);
+	if (root1 != root2) {
+		cout << "Flat tree: root mismatch" << endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < numLeaves; i++) {
+		merkle_authentication_path path1(height), path2(height);
+		if (incTree.getWitness(indices[i], path1) == false || flatTree.getWitness(indices[i], path2) == false ||
+			path1 != path2) {
+			cout << "Flat tree: witness mismatch at leaf " << i << endl;
+			return false;
+		}
+	}
+
+	IncrementalMerkleTreeCompact compact1, compact2;
+	incTree.prune();
+	flatTree.prune();
+	incTree.getCompactRepresentation(compact1);
+	flatTree.getCompactRepresentation(compact2);
+	if (compact1.hashVec != compact2.hashVec || compact1.hashListBytes != compact2.hashListBytes) {
+		cout << "Flat tree: compact representation mismatch" << endl;
+		return false;
+	}
+
+	FlatIncrementalMerkleTree restored(compact2);
+	restored.getRootValue(root2);
+	if (root1 != root2) {
+		cout << "Flat tree: root mismatch after restoring compact representation" << endl;
+		return false;
+	}
+
+	cout << "Flat tree (height " << height << ", " << numLeaves << " leaves): TEST PASSED" << endl;
+	return true;
+}
+
+bool testEmptySubtreeTable()
+{
+	std::vector< std::vector<bool> > zeroLeaves(8, std::vector<bool>(256, false));
+	std::vector<bool> root1, root2;
+
+	// An explicitly built subtree of zero leaves must match the table entry
+	MerkleTree zeroTree(zeroLeaves, 20);
+	zeroTree.getSubtreeRootValue(root1);
+	if (root1 != EmptySubtreeTable::get(20, EmptySubtreeTable::HASHED).digestBits(3)) {
+		cout << "Empty subtree table: hashed digest mismatch" << endl;
+		return false;
+	}
+
+	// Padding taken from the table must give the same root as explicit zero leaves
+	std::vector< std::vector<bool> > values = randomLeaves(5);
+	MerkleTree sparseTree(values, 20);
+	values.resize(8, std::vector<bool>(256, false));
+	MerkleTree paddedTree(values, 20);
+
+	sparseTree.getRootValue(root1);
+	paddedTree.getRootValue(root2);
+	if (root1 != root2) {
+		cout << "Empty subtree table: padded root mismatch" << endl;
+		return false;
+	}
+
+	if (VectorIsZero(EmptySubtreeTable::get(20, EmptySubtreeTable::ZERO_SENTINEL).digestBits(20)) == false) {
+		cout << "Empty subtree table: zero sentinel digest is not zero" << endl;
+		return false;
+	}
+
+	cout << "Empty subtree table: TEST PASSED" << endl;
+	return true;
+}
+
+bool testBatchInsert(uint32_t height, size_t numBefore, size_t numBatch)
+{
+	IncrementalMerkleTree loopTree(height), batchTree(height);
+	FlatIncrementalMerkleTree flatTree(height);
+	std::vector< std::vector<bool> > before = randomLeaves(numBefore), batch = randomLeaves(numBatch);
+	std::vector< std::vector<bool> > loopIndices, batchIndices, flatIndices;
+
+	loopTree.insertVector(before);
+	batchTree.insertVector(before);
+	flatTree.insertVector(before);
+
+	for (size_t i = 0; i < batch.size(); i++) {
+		std::vector<bool> index;
+		loopTree.insertElement(batch[i], index);
+		loopIndices.push_back(index);
+	}
+
+	if (batchTree.insertElements(batch, batchIndices) == false || flatTree.insertElements(batch, flatIndices) == false) {
+		cout << "Batch insert: insertion failed" << endl;
+		return false;
+	}
+
+	if (loopIndices != batchIndices || loopIndices != flatIndices) {
+		cout << "Batch insert: index mismatch" << endl;
+		return false;
+	}
+
+	std::vector<bool> root1, root2, root3;
+	loopTree.getRootValue(root1);
+	batchTree.getRootValue(root2);
+	flatTree.getRootValue(root3);
+	if (root1 != root2 || root1 != root3) {
+		cout << "Batch insert: root mismatch" << endl;
+		return false;
+	}
+
+	cout << "Batch insert (height " << height << ", " << numBefore << " + " << numBatch << " leaves): TEST PASSED" << endl;
+	return true;
+}
+
+bool testParallelBuild(size_t numLeaves)
+{
+	std::vector< std::vector<bool> > values = randomLeaves(numLeaves);
+
+	ThreadPool serialPool(1), parallelPool(4);
+	std::vector<bool> root1, root2, root3, index;
+
+	// Level-parallel construction must match one insert at a time
+	IncrementalMerkleTree loopTree;
+	for (size_t i = 0; i < values.size(); i++) {
+		loopTree.insertElement(values[i], index);
+	}
+	IncrementalMerkleTree incTree(values, ZEROCASH_DEFAULT_TREE_SIZE, parallelPool);
+	FlatIncrementalMerkleTree flatTree(values, ZEROCASH_DEFAULT_TREE_SIZE, parallelPool);
+
+	loopTree.getRootValue(root1);
+	incTree.getRootValue(root2);
+	flatTree.getRootValue(root3);
+	if (root1 != root2 || root1 != root3) {
+		cout << "Parallel build: incremental root mismatch" << endl;
+		return false;
+	}
+
+	std::vector<bool> lastIndex(ZEROCASH_DEFAULT_TREE_SIZE);
+	for (size_t d = 0; d < lastIndex.size(); d++) {
+		lastIndex[d] = ((uint64_t(numLeaves - 1) >> (lastIndex.size() - 1 - d)) & 1);
+	}
+	merkle_authentication_path path1(ZEROCASH_DEFAULT_TREE_SIZE), path2(ZEROCASH_DEFAULT_TREE_SIZE);
+	if (loopTree.getWitness(lastIndex, path1) == false || incTree.getWitness(lastIndex, path2) == false ||
+		path1 != path2) {
+		cout << "Parallel build: incremental witness mismatch" << endl;
+		return false;
+	}
+
+	// The old Merkle tree must not depend on the number of threads
+	MerkleTree serialTree(values, 64, serialPool), parallelTree(values, 64, parallelPool);
+	serialTree.getRootValue(root1);
+	parallelTree.getRootValue(root2);
+	serialTree.getWitness(values.back(), path1);
+	parallelTree.getWitness(values.back(), path2);
+	if (root1 != root2 || path1 != path2) {
+		cout << "Parallel build: Merkle tree mismatch" << endl;
+		return false;
+	}
+
+	cout << "Parallel build (" << numLeaves << " leaves): TEST PASSED" << endl;
+	return true;
+}
+
+std::vector<std::string> mappedStoreFiles(uint32_t height)
+{
+	std::vector<std::string> names(1, "/tree.meta");
+	for (uint32_t level = 0; level <= height; level++) {
+		char name[32];
+		snprintf(name, sizeof(name), "/level-%02u.dat", level);
+		names.push_back(name);
+	}
+	return names;
+}
+
+void removeMappedStore(const std::string &directory, uint32_t height)
+{
+	std::vector<std::string> names = mappedStoreFiles(height);
+	for (size_t i = 0; i < names.size(); i++) {
+		unlink((directory + names[i]).c_str());
+	}
+	rmdir(directory.c_str());
+}
+
+std::vector<MerkleDigest> randomDigests(size_t count)
+{
+	std::vector<MerkleDigest> digests(count);
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < digests[i].size(); j++) {
+			digests[i][j] = rand() & 0xff;
+		}
+	}
+	return digests;
+}
+
+bool testMappedTree(uint32_t height, size_t numLeaves)
+{
+	char dirTemplate[] = "/tmp/merkleTest.XXXXXX";
+	if (mkdtemp(dirTemplate) == NULL) {
+		cout << "Mapped tree: could not create a temporary directory" << endl;
+		return false;
+	}
+	std::string directory(dirTemplate);
+
+	std::vector<MerkleDigest> leaves = randomDigests(numLeaves);
+
+	FlatMerkleTree flatTree(height);
+	bool result = true;
+	uint64_t position;
+
+	// Fill the first half, close the store, then reopen it and fill the rest
+	for (size_t half = 0; half < 2 && result; half++) {
+		MappedMerkleTree mappedTree(directory, height);
+		std::vector<MerkleDigest> batch;
+		size_t begin = half * (numLeaves / 2), end = half ? numLeaves : numLeaves / 2;
+
+		if (mappedTree.size() != begin) {
+			cout << "Mapped tree: wrong size after reopening" << endl;
+			result = false;
+			break;
+		}
+
+		for (size_t i = begin; i < end; i++) {
+			flatTree.append(leaves[i], position);
+			if (i % 3 == 0) {
+				result &= mappedTree.append(leaves[i], position);
+			} else {
+				batch.push_back(leaves[i]);
+				if (i % 3 == 2 || i + 1 == end) {
+					result &= mappedTree.appendBatch(batch, position);
+					batch.clear();
+				}
+			}
+		}
+
+		MerkleDigest root1, root2;
+		flatTree.getRoot(root1);
+		mappedTree.getRoot(root2);
+		result &= (root1 == root2);
+
+		for (size_t i = 0; i < end; i++) {
+			std::vector<MerkleDigest> witness1, witness2;
+			result &= flatTree.getWitness(i, witness1) && mappedTree.getWitness(i, witness2) && (witness1 == witness2);
+		}
+	}
+
+	removeMappedStore(directory, height);
+
+	if (result == false) {
+		cout << "Mapped tree: mismatch with the in-memory tree" << endl;
+		return false;
+	}
+
+	cout << "Mapped tree (height " << height << ", " << numLeaves << " leaves): TEST PASSED" << endl;
+	return true;
+}
+
+bool testMappedTreeCrash(uint32_t height, size_t numSynced, size_t numBatch)
+{
+	char dirTemplate[] = "/tmp/merkleTest.XXXXXX", copyTemplate[] = "/tmp/merkleTest.XXXXXX";
+	if (mkdtemp(dirTemplate) == NULL || mkdtemp(copyTemplate) == NULL) {
+		cout << "Mapped tree crash: could not create a temporary directory" << endl;
+		return false;
+	}
+	std::string directory(dirTemplate), copy(copyTemplate);
+
+	std::vector<MerkleDigest> synced = randomDigests(numSynced), batch = randomDigests(numBatch);
+	FlatMerkleTree flatTree(height);
+	MerkleDigest syncedRoot, fullRoot, root;
+	uint64_t position;
+	bool result = true;
+
+	for (size_t i = 0; i < synced.size(); i++) {
+		flatTree.append(synced[i], position);
+	}
+	flatTree.getRoot(syncedRoot);
+	for (size_t i = 0; i < batch.size(); i++) {
+		flatTree.append(batch[i], position);
+	}
+	flatTree.getRoot(fullRoot);
+
+	{
+		MappedMerkleTree mappedTree(directory, height);
+		result &= mappedTree.appendBatch(synced, position);
+		mappedTree.sync();
+		result &= mappedTree.appendBatch(batch, position);
+
+		// Copy the files as a crash would leave them: every level record of
+		// the batch written, the header still at the last sync.
+		std::vector<std::string> names = mappedStoreFiles(height);
+		for (size_t i = 0; i < names.size(); i++) {
+			std::ifstream in((directory + names[i]).c_str(), std::ios::binary);
+			std::ofstream out((copy + names[i]).c_str(), std::ios::binary);
+			out << in.rdbuf();
+		}
+	}
+
+	{
+		MappedMerkleTree reopened(copy, height);
+		reopened.getRoot(root);
+		result &= (reopened.size() == numSynced) && (root == syncedRoot);
+
+		result &= reopened.appendBatch(batch, position);
+		reopened.getRoot(root);
+		result &= (position == numSynced) && (root == fullRoot);
+	}
+
+	removeMappedStore(directory, height);
+	removeMappedStore(copy, height);
+
+	if (result == false) {
+		cout << "Mapped tree crash: wrong root after reopening an unsynced store" << endl;
+		return false;
+	}
+
+	cout << "Mapped tree crash (height " << height << ", " << numSynced << " + " << numBatch << " leaves): TEST PASSED" << endl;
+	return true;
+}
+
+bool testWitnessTracking(uint32_t height)
+{
+	IncrementalMerkleTree fullTree(height), prunedTree(height);
+	std::vector< std::vector<bool> > indices, batchIndices;
+	std::vector<bool> index;
+
+	std::vector< std::vector<bool> > values = randomLeaves(40);
+
+	// Track leaves 1 and 4, then keep only the frontier of the second tree
+	for (size_t i = 0; i < 5; i++) {
+		fullTree.insertElement(values[i], index);
+		prunedTree.insertElement(values[i], index);
+		indices.push_back(index);
+	}
+	if (prunedTree.trackWitness(indices[1]) == false || prunedTree.trackWitness(indices[4]) == false) {
+		cout << "Witness tracking: could not track leaves" << endl;
+		return false;
+	}
+	prunedTree.prune();
+
+	size_t batchStart = 20;
+	for (size_t i = 5; i < values.size(); i++) {
+		fullTree.insertElement(values[i], index);
+		indices.push_back(index);
+
+		// Mix single inserts and batches
+		if (i < 20) {
+			prunedTree.insertElement(values[i], index);
+			if (i == 9 && prunedTree.trackWitness(index) == false) {
+				cout << "Witness tracking: could not track a new leaf" << endl;
+				return false;
+			}
+			prunedTree.prune();
+		} else if (i % 7 == 6 || i + 1 == values.size()) {
+			std::vector< std::vector<bool> > batch(values.begin() + batchStart, values.begin() + i + 1);
+			prunedTree.insertElements(batch, batchIndices);
+			batchStart = i + 1;
+			prunedTree.prune();
+		} else {
+			continue;
+		}
+
+		size_t tracked[] = { 1, 4, 9 };
+		for (size_t t = 0; t < 3; t++) {
+			if (tracked[t] > i) {
+				continue;
+			}
+
+			merkle_authentication_path path1(height), path2(height);
+			if (fullTree.getWitness(indices[tracked[t]], path1) == false ||
+				prunedTree.getWitness(indices[tracked[t]], path2) == false || path1 != path2) {
+				cout << "Witness tracking: witness mismatch for leaf " << tracked[t] << " after " << i + 1 << " leaves" << endl;
+				return false;
+			}
+		}
+	}
+
+	cout << "Witness tracking (height " << height << "): TEST PASSED" << endl;
+	return true;
+}
+
+bool testRootHistory()
+{
+	IncrementalMerkleTree tree;
+	std::vector<MerkleRootType> roots;
+	std::vector<bool> index;
+	uint64_t leafCount;
+
+	std::vector< std::vector<bool> > values = randomLeaves(10);
+
+	tree.setRootHistoryLimit(5);
+	for (size_t i = 0; i < values.size(); i++) {
+		tree.insertElement(values[i], index);
+		roots.push_back(tree.getRoot());
+	}
+
+	// Only the last five roots are remembered, each with its leaf count
+	for (size_t i = 0; i < roots.size(); i++) {
+		bool recent = tree.isRecentRoot(roots[i], leafCount);
+		if (recent != (i >= 5) || (recent && leafCount != i + 1)) {
+			cout << "Root history: wrong answer for root " << i << endl;
+			return false;
+		}
+	}
+
+	// A batch adds a single root
+	std::vector< std::vector<bool> > batch(3, std::vector<bool>(256, true)), indices;
+	tree.insertElements(batch, indices);
+	if (tree.isRecentRoot(tree.getRoot(), leafCount) == false || leafCount != 13 || tree.isRecentRoot(roots[5])) {
+		cout << "Root history: wrong answer after a batch" << endl;
+		return false;
+	}
+
+	tree.setRootHistoryLimit(2);
+	if (tree.isRecentRoot(roots[8]) || tree.isRecentRoot(roots[9]) == false) {
+		cout << "Root history: wrong answer after shrinking the history" << endl;
+		return false;
+	}
+
+	cout << "Root history: TEST PASSED" << endl;
+	return true;
+}
+
+bool testCheckpointRewind(uint32_t height)
+{
+	IncrementalMerkleTree tree(height);
+	std::vector< std::vector<bool> > values = randomLeaves(48), indices;
+	std::vector<bool> index;
+
+	// Blocks of 8 leaves with a checkpoint after each; leaf 2 and 13 are tracked
+	std::vector<uint64_t> ids;
+	std::vector<MerkleRootType> roots;
+	for (size_t i = 0; i < 32; i++) {
+		tree.insertElement(values[i], index);
+		indices.push_back(index);
+		if (i == 2 || i == 13) {
+			tree.trackWitness(index);
+		}
+		if (i % 8 == 7) {
+			tree.prune();
+			ids.push_back(tree.checkpoint());
+			roots.push_back(tree.getRoot());
+		}
+	}
+
+	// Rewind to the end of the second block (16 leaves), then replay a different history
+	if (tree.rewind(ids[1]) == false || tree.size() != 16 || tree.getRoot() != roots[1] ||
+		tree.isRecentRoot(roots[2]) || tree.isRecentRoot(roots[1]) == false || tree.numCheckpoints() != 2) {
+		cout << "Checkpoint/rewind: wrong state after rewinding" << endl;
+		return false;
+	}
+
+	std::vector< std::vector<bool> > replay(values.begin(), values.begin() + 16);
+	for (size_t i = 32; i < 48; i++) {
+		tree.insertElement(values[i], index);
+		replay.push_back(values[i]);
+
+		IncrementalMerkleTree reference(replay, height);
+		std::vector<bool> root1, root2;
+		tree.getRootValue(root1);
+		reference.getRootValue(root2);
+		if (root1 != root2) {
+			cout << "Checkpoint/rewind: root mismatch after replaying " << replay.size() << " leaves" << endl;
+			return false;
+		}
+
+		size_t tracked[] = { 2, 13 };
+		for (size_t t = 0; t < 2; t++) {
+			merkle_authentication_path path1(height), path2(height);
+			if (tree.getWitness(indices[tracked[t]], path1) == false ||
+				reference.getWitness(indices[tracked[t]], path2) == false || path1 != path2) {
+				cout << "Checkpoint/rewind: witness mismatch for leaf " << tracked[t] << endl;
+				return false;
+			}
+		}
+	}
+
+	// Rewinding to the first block drops leaf 13 from the tracked set
+	if (tree.rewind(ids[0]) == false || tree.size() != 8 || tree.getRoot() != roots[0] ||
+		tree.numTrackedWitnesses() != 1 || tree.rewind(ids[1])) {
+		cout << "Checkpoint/rewind: wrong state after the second rewind" << endl;
+		return false;
+	}
+
+	// Restoring other contents drops the witnesses, roots and checkpoints of the old ones
+	IncrementalMerkleTree other(height);
+	for (size_t i = 40; i < 44; i++) {
+		other.insertElement(values[i], index);
+	}
+	IncrementalMerkleTreeCompact compact;
+	other.getCompactRepresentation(compact);
+	compact.hashList.erase(compact.hashList.begin(), compact.hashList.end() - height); // drop the byte padding
+	tree.fromCompactRepresentation(compact);
+	if (tree.size() != 4 || tree.getRoot() != other.getRoot() || tree.isRecentRoot(other.getRoot()) == false ||
+		tree.isRecentRoot(roots[0]) || tree.numTrackedWitnesses() != 0 || tree.numCheckpoints() != 0 ||
+		tree.rewind(ids[0]) || tree.checkpoint() <= ids[3]) {
+		cout << "Checkpoint/rewind: stale state after restoring a compact representation" << endl;
+		return false;
+	}
+
+	cout << "Checkpoint/rewind (height " << height << "): TEST PASSED" << endl;
+	return true;
+}
+
+bool testCommitmentIndex(size_t numCommitments)
+{
+	CommitmentIndex index;
+	std::vector<MerkleDigest> commitments(numCommitments);
+	uint64_t position;
+
+	for (size_t i = 0; i < numCommitments; i++) {
+		for (size_t j = 0; j < commitments[i].size(); j++) {
+			commitments[i][j] = rand() & 0xff;
+		}
+		index.insert(commitments[i], i);
+	}
+
+	// Re-inserting a commitment moves it
+	index.insert(commitments[0], numCommitments);
+
+	for (size_t i = 0; i < numCommitments; i++) {
+		if (index.find(commitments[i], position) == false || position != (i ? i : numCommitments)) {
+			cout << "Commitment index: lookup failed for commitment " << i << endl;
+			return false;
+		}
+	}
+
+	MerkleDigest missing;
+	missing.fill(0xff);
+	if (index.size() != numCommitments || index.find(missing, position)) {
+		cout << "Commitment index: wrong size or unexpected entry" << endl;
+		return false;
+	}
+
+	cout << "Commitment index (" << numCommitments << " entries): TEST PASSED" << endl;
+	return true;
+}
+
+bool testMultiBufferSha256(size_t maxBlocks)
+{
+	std::vector<unsigned char> blocks(64 * maxBlocks), expected(32 * maxBlocks), hashes(32 * maxBlocks);
+	for (size_t i = 0; i < blocks.size(); i++) {
+		blocks[i] = rand() & 0xff;
+	}
+
+	for (size_t i = 0; i < maxBlocks; i++) {
+		SHA256_CTX_mod ctx256;
+		sha256_init(&ctx256);
+		sha256_update(&ctx256, &blocks[64 * i], 64);
+		sha256_final(&ctx256, &expected[32 * i]);
+	}
+
+	const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+	vector<const SHA256_BACKEND*> backends = HashProvider::available();
+	bool result = true;
+
+	// Every available backend, on every count up to 'maxBlocks' (covers the partial lane groups)
+	for (size_t b = 0; b < backends.size(); b++) {
+		sha256_set_backend(backends[b]);
+
+		for (size_t count = 1; count <= maxBlocks; count++) {
+			std::fill(hashes.begin(), hashes.end(), 0);
+			sha256_compress_blocks(&blocks[0], &hashes[0], count);
+			if (!std::equal(hashes.begin(), hashes.begin() + 32 * count, expected.begin())) {
+				cout << "Multi-buffer SHA-256: " << backends[b]->name << " differs on " << count << " blocks" << endl;
+				result = false;
+				break;
+			}
+		}
+	}
+
+	sha256_set_backend(defaultBackend);
+
+	if (result) {
+		cout << "Multi-buffer SHA-256 (default backend " << defaultBackend->name << "): TEST PASSED" << endl;
+	}
+
+	return result;
+}
+
+bool testSha256Compress(size_t numBlocks)
+{
+	const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+	vector<const SHA256_BACKEND*> backends = HashProvider::available();
+	bool result = true;
+
+	for (size_t b = 0; b < backends.size(); b++) {
+		sha256_set_backend(backends[b]);
+
+		for (size_t n = 0; n < numBlocks; n++) {
+			unsigned char blocks[128], expected[32], hash[32];
+			for (size_t i = 0; i < sizeof(blocks); i++) {
+				blocks[i] = rand() & 0xff;
+			}
+
+			// Two-to-one hash of one block
+			SHA256_CTX_mod ctx256;
+			sha256_init(&ctx256);
+			sha256_update(&ctx256, blocks, 64);
+			sha256_final(&ctx256, expected);
+
+			sha256_two_to_one(blocks, blocks + 32, hash);
+			result &= std::equal(hash, hash + 32, expected);
+
+			// Chaining the compression function over two blocks
+			WORD state[8];
+			for (size_t i = 0; i < 8; i++) {
+				state[i] = (hash[4 * i] << 24) | (hash[4 * i + 1] << 16) | (hash[4 * i + 2] << 8) | hash[4 * i + 3];
+			}
+			sha256_compress(state, blocks + 64, hash);
+
+			sha256_init(&ctx256);
+			sha256_update(&ctx256, blocks, 128);
+			sha256_final(&ctx256, expected);
+			result &= std::equal(hash, hash + 32, expected);
+		}
+	}
+
+	sha256_set_backend(defaultBackend);
+
+	if (result) {
+		cout << "SHA-256 compression function: TEST PASSED" << endl;
+	} else {
+		cout << "SHA-256 compression function: results differ" << endl;
+	}
+
+	return result;
+}
+
+bool testHashWrappers()
+{
+	bool result = true;
+
+	// Bit lengths that are and are not whole bytes, on both sides
+	const size_t lengths[] = { 0, 8, 13, 256, 511, 512, 1024, 1031 };
+	const size_t numLengths = sizeof(lengths) / sizeof(lengths[0]);
+
+	for (size_t l = 0; l < numLengths; l++) {
+		for (size_t r = 0; r < numLengths; r++) {
+			std::vector<bool> left(lengths[l]), right(lengths[r]), concat, output1(256), output2(256);
+			for (size_t i = 0; i < left.size(); i++) {
+				left[i] = rand() & 1;
+			}
+			for (size_t i = 0; i < right.size(); i++) {
+				right[i] = rand() & 1;
+			}
+			concatenateVectors(left, right, concat);
+
+			std::vector<unsigned char> bytes((concat.size() + 7) / 8);
+			unsigned char hash[32];
+			convertVectorToBytes(concat, bytes.data());
+			hashBytes(bytes.data(), concat.size() / 8, hash);
+			convertBytesToVector(hash, output1);
+
+			hashVectors(left, right, output2);
+			result &= (output1 == output2);
+			hashVector(concat, output2);
+			result &= (output1 == output2);
+
+			if (lengths[l] % 8 == 0 && lengths[r] % 8 == 0) {
+				std::vector<unsigned char> leftBytes(lengths[l] / 8), rightBytes(lengths[r] / 8), hashBytesVector(32);
+				convertVectorToBytesVector(left, leftBytes);
+				convertVectorToBytesVector(right, rightBytes);
+				hashVectors(leftBytes, rightBytes, hashBytesVector);
+				result &= std::equal(hashBytesVector.begin(), hashBytesVector.end(), hash);
+			}
+		}
+	}
+
+	if (result) {
+		cout << "Hash wrappers: TEST PASSED" << endl;
+	} else {
+		cout << "Hash wrappers: results differ" << endl;
+	}
+
+	return result;
+}
+
+bool testBitConversion()
+{
+	bool result = true;
+
+	for (size_t numBits = 0; numBits <= 600; numBits++) {
+		std::vector<bool> bits(numBits), converted(numBits, true);
+		for (size_t i = 0; i < numBits; i++) {
+			bits[i] = rand() & 1;
+		}
+
+		// Reference: bit 8k + j is bit (7 - j) of byte k
+		std::vector<unsigned char> expected(numBits / 8, 0), bytes(numBits / 8 + 1, 0xff);
+		for (size_t i = 0; i < expected.size() * 8; i++) {
+			expected[i / 8] |= bits[i] << (7 - (i % 8));
+		}
+
+		convertVectorToBytes(bits, bytes.data());
+		result &= std::equal(expected.begin(), expected.end(), bytes.begin()) && (bytes.back() == 0xff);
+
+		// Trailing bits that do not fill a byte are left alone
+		convertBytesToVector(expected.data(), converted);
+		for (size_t i = 0; i < numBits; i++) {
+			result &= (converted[i] == ((i < expected.size() * 8) ? bits[i] : true));
+		}
+
+		std::vector<unsigned char> bytesVector(numBits / 8);
+		convertVectorToBytesVector(bits, bytesVector);
+		result &= (bytesVector == expected);
+
+		std::vector<bool> roundTrip;
+		convertBytesVectorToVector(expected, roundTrip);
+		result &= (roundTrip.size() == expected.size() * 8) && std::equal(roundTrip.begin(), roundTrip.end(), bits.begin());
+	}
+
+	if (result) {
+		cout << "Bit conversion: TEST PASSED" << endl;
+	} else {
+		cout << "Bit conversion: results differ" << endl;
+	}
+
+	return result;
+}
+
+bool testHashProvider()
+{
+	const SHA256_BACKEND *defaultBackend = &HashProvider::get();
+	bool result = true;
+
+	// Every candidate passes its own check, and the chosen one is usable
+	vector<HashProvider::Calibration> calibration = HashProvider::calibrate(64);
+	for (size_t i = 0; i < calibration.size(); i++) {
+		if (!calibration[i].correct) {
+			cout << "Hash provider: " << calibration[i].backend->name << " fails its check" << endl;
+			result = false;
+		}
+	}
+
+	// Hashing through each selected backend gives the same digests
+	unsigned char input[200], expected[32], hash[32];
+	for (size_t i = 0; i < sizeof(input); i++) {
+		input[i] = rand() & 0xff;
+	}
+	sha256_set_engine(SHA256_ENGINE_SCALAR);
+	hashBytes(input, sizeof(input), expected);
 
+	vector<const SHA256_BACKEND*> backends = HashProvider::available();
+	for (size_t b = 0; b < backends.size(); b++) {
+		result &= HashProvider::select(backends[b]->name);
+		result &= (&HashProvider::get() == backends[b]);
+		hashBytes(input, sizeof(input), hash);
+		result &= std::equal(hash, hash + 32, expected);
+	}
+
+	result &= !HashProvider::select("no-such-backend");
+	sha256_set_backend(defaultBackend);
+
+	if (result) {
+		cout << "Hash provider (selected " << defaultBackend->name << "): TEST PASSED" << endl;
+	} else {
+		cout << "Hash provider: results differ" << endl;
+	}
+
+	return result;
+}
+
+bool testTreeMemory(size_t numLeaves)
+{
+	std::vector< std::vector<bool> > values(numLeaves, std::vector<bool>(256, 1)), indices;
+	IncrementalMerkleTree tree(ZEROCASH_DEFAULT_TREE_SIZE);
+	bool result = tree.insertElements(values, indices);
+
+	// Every leaf has a node and a 256-bit value
+	size_t bytes = tree.memoryUsage(), nodes = tree.numNodes();
+	result &= (nodes > numLeaves && bytes >= nodes * (sizeof(IncrementalMerkleNode) + 32));
+
+	// Pruning frees nodes, and the tree still hashes the same as an unpruned one
+	tree.prune();
+	result &= (tree.numNodes() < nodes && tree.memoryUsage() < bytes);
+
+	std::vector<bool> root, unprunedRoot;
+	values.push_back(std::vector<bool>(256, 0));
+	IncrementalMerkleTree unpruned(ZEROCASH_DEFAULT_TREE_SIZE);
+	result &= unpruned.insertElements(values, indices);
+	result &= tree.insertElement(values.back(), indices[0]);
+	tree.getRootValue(root);
+	unpruned.getRootValue(unprunedRoot);
+	result &= (root == unprunedRoot);
+
+	if (result) {
+		cout << "Tree memory: TEST PASSED" << endl;
+	} else {
+		cout << "Tree memory: mismatch" << endl;
+	}
+
+	return result;
+}
+
+bool testConcurrentTree(uint32_t height, uint32_t shardHeight, size_t numLeaves, size_t numReaders)
+{
+	std::vector<MerkleDigest> leaves(numLeaves);
+	for (size_t i = 0; i < numLeaves; i++) {
+		for (size_t j = 0; j < leaves[i].size(); j++) {
+			leaves[i][j] = rand() & 0xff;
+		}
+	}
+
+	// Readers check that every witness of a snapshot leads to that snapshot's root
+	ConcurrentMerkleTree tree(height, shardHeight);
+	std::atomic<bool> done(false), consistent(true);
+	std::vector<std::thread> readers;
+
+	for (size_t r = 0; r < numReaders; r++) {
+		readers.push_back(std::thread([&, r]() {
+			for (size_t query = r; !done.load(); query++) {
+				ConcurrentMerkleTree::ReadGuard snapshot(tree);
+				if (snapshot->size() == 0) {
+					continue;
+				}
+
+				uint64_t position = (query * 7919) % snapshot->size();
+				std::vector<MerkleDigest> witness;
+				MerkleDigest node = leaves[position], root;
+
+				if (!snapshot->getWitness(position, witness)) {
+					consistent = false;
+				}
+				for (uint32_t level = 0; level < height; level++) {
+					const MerkleDigest &sibling = witness[height - 1 - level];
+					if ((position >> level) & 1) {
+						FlatMerkleTree::hashNode(sibling, node, node);
+					} else {
+						FlatMerkleTree::hashNode(node, sibling, node);
+					}
+				}
+
+				snapshot->getRoot(root);
+				if (node != root) {
+					consistent = false;
+				}
+			}
+		}));
+	}
+
+	FlatMerkleTree flatTree(height);
+	bool result = true;
+	uint64_t position;
+
+	for (size_t i = 0; i < numLeaves; ) {
+		size_t batchSize = std::min<size_t>(1 + rand() % 40, numLeaves - i);
+		std::vector<MerkleDigest> batch(leaves.begin() + i, leaves.begin() + i + batchSize);
+
+		result &= tree.appendBatch(batch, position) && (position == i);
+		result &= flatTree.appendBatch(batch, position);
+		i += batchSize;
+
+		MerkleDigest root1, root2;
+		flatTree.getRoot(root1);
+		tree.getRoot(root2);
+		result &= (root1 == root2) && (tree.size() == i);
+	}
+
+	done = true;
+	for (size_t r = 0; r < readers.size(); r++) {
+		readers[r].join();
+	}
+
+	for (size_t i = 0; i < numLeaves; i++) {
+		std::vector<MerkleDigest> witness1, witness2;
+		result &= flatTree.getWitness(i, witness1) && tree.getWitness(i, witness2) && (witness1 == witness2);
+	}
+
+	if (result && consistent) {
+		cout << "Concurrent tree (height " << height << ", shard height " << shardHeight << "): TEST PASSED" << endl;
+	} else {
+		cout << "Concurrent tree (height " << height << ", shard height " << shardHeight << "): results differ" << endl;
+	}
+
+	return result && consistent;
+}
 
 int main()
 {
@@ -98,4 +1016,42 @@ int main()
   cout << endl;
 
   testCompactRep(incTree);
+
+  testFlatTree(ZEROCASH_DEFAULT_TREE_SIZE, 13);
+  testFlatTree(4, 11);
+
+  testEmptySubtreeTable();
+
+  testBatchInsert(ZEROCASH_DEFAULT_TREE_SIZE, 3, 29);
+  testBatchInsert(5, 7, 25);
+
+  testParallelBuild(5000);
+
+  testMappedTree(ZEROCASH_DEFAULT_TREE_SIZE, 300);
+  testMappedTree(9, 512);
+  testMappedTreeCrash(ZEROCASH_DEFAULT_TREE_SIZE, 37, 60);
+  testMappedTreeCrash(6, 21, 11);
+
+  testWitnessTracking(ZEROCASH_DEFAULT_TREE_SIZE);
+  testWitnessTracking(6);
+
+  testRootHistory();
+
+  testCheckpointRewind(ZEROCASH_DEFAULT_TREE_SIZE);
+  testCheckpointRewind(6);
+
+  testCommitmentIndex(100000);
+
+  testMultiBufferSha256(40);
+  testSha256Compress(100);
+  testHashWrappers();
+  testBitConversion();
+  testHashProvider();
+  testTreeMemory(1000);
+
+  testConcurrentTree(ZEROCASH_DEFAULT_TREE_SIZE, CONCURRENT_MERKLE_SHARD_HEIGHT, 5000, 4);
+  testConcurrentTree(7, 3, 128, 4);
+  testConcurrentTree(3, 5, 8, 2);
+
+  printHashStats("merkleTest");
 }
@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <iostream>
+#include <thread>
 
 #include "timer.h"
 
@@ -18,10 +19,14 @@
 #include "libzerocash/Address.h"
 #include "libzerocash/CoinCommitment.h"
 #include "libzerocash/Coin.h"
+#include "libzerocash/FixedBytes.h"
 #include "libzerocash/IncrementalMerkleTree.h"
 #include "libzerocash/MerkleTree.h"
 #include "libzerocash/MintTransaction.h"
+#include "libzerocash/PRF.h"
 #include "libzerocash/PourTransaction.h"
+#include "libzerocash/PourVerificationService.h"
+#include "libzerocash/utils/HashProvider.h"
 #include "libzerocash/utils/util.h"
 
 using namespace std;
@@ -110,7 +115,296 @@ int CoinTest() {
 
     cout << "Successfully deserialized a coin.\n" << endl;
 
-    bool result = ((coin == coinNew) && (coin2 == coinNew2));
+    ///////////////////////////////////////////////////////////////////////////
+
+    const size_t numCoins = 16;
+    vector<libzerocash::PublicAddress> addrs(numCoins, pubAddress);
+    vector<uint64_t> values(numCoins);
+    for (size_t i = 0; i < numCoins; i++) {
+        values[i] = i * 1000;
+    }
+    vector<libzerocash::Coin> coins;
+    vector<libzerocash::MerkleDigest> cms;
+
+    libzerocash::timer_start("Coins");
+    libzerocash::Coin::createCoins(addrs, values, coins, cms);
+    libzerocash::timer_stop("Coins");
+
+    bool batchResult = (coins.size() == numCoins && cms.size() == numCoins);
+    for (size_t i = 0; batchResult && i < numCoins; i++) {
+        const libzerocash::CommitmentValue& cm = coins[i].getCoinCommitment().getCommitmentValue();
+        batchResult &= equal(cm.begin(), cm.end(), cms[i].begin());
+        batchResult &= libzerocash::MintTransaction(coins[i]).verify();
+        batchResult &= (libzerocash::MintTransaction(coins[i]).getMonetaryValue() == values[i]);
+    }
+
+    cout << "Successfully created a batch of coins.\n" << endl;
+
+    bool result = ((coin == coinNew) && (coin2 == coinNew2) && batchResult);
+
+    return result;
+}
+
+// H(a_sk || tag || input) built bit by bit, as PourTransaction used to
+template<typename Output, typename Input>
+static void prfReference(const std::vector<unsigned char>& a_sk, const std::vector<bool>& tag,
+                         const Input& input, Output& output)
+{
+    std::vector<bool> a_sk_bv(256), input_bv(256), internal, output_bv(256);
+    libzerocash::convertBytesVectorToVector(a_sk, a_sk_bv);
+    libzerocash::convertBytesToVector(input.data(), input_bv);
+    input_bv.erase(input_bv.end() - tag.size(), input_bv.end());
+    input_bv.insert(input_bv.begin(), tag.begin(), tag.end());
+    libzerocash::concatenateVectors(a_sk_bv, input_bv, internal);
+    libzerocash::hashVector(internal, output_bv);
+    libzerocash::convertVectorToBytes(output_bv, output.data());
+}
+
+bool PRFTest(size_t numCoins) {
+    cout << "\nPRF TEST\n" << endl;
+
+    const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+    vector<const SHA256_BACKEND*> backends = libzerocash::HashProvider::available();
+    bool result = true;
+
+    std::vector<unsigned char> a_sk(32);
+    std::vector<libzerocash::CoinNonce> rhos(numCoins);
+    std::vector<libzerocash::SignatureHash> h_Ss(numCoins);
+    std::vector<size_t> inputs(numCoins);
+    for (size_t i = 0; i < 32; i++) {
+        a_sk[i] = rand() & 0xff;
+    }
+    for (size_t j = 0; j < numCoins; j++) {
+        for (size_t i = 0; i < 32; i++) {
+            rhos[j][i] = rand() & 0xff;
+            h_Ss[j][i] = rand() & 0xff;
+        }
+        inputs[j] = rand() & 1;
+    }
+
+    const bool snTag[] = {0, 1}, pk0Tag[] = {1, 0, 0}, pk1Tag[] = {1, 0, 1};
+    std::vector<unsigned char> expectedAddr(32);
+    std::vector<libzerocash::SerialNumber> expectedSns(numCoins);
+    std::vector<libzerocash::PourMAC> expectedMacs(numCoins);
+    prfReference(a_sk, std::vector<bool>(256, 0), std::vector<unsigned char>(32, 0), expectedAddr);
+    for (size_t j = 0; j < numCoins; j++) {
+        prfReference(a_sk, std::vector<bool>(snTag, snTag + 2), rhos[j], expectedSns[j]);
+        prfReference(a_sk, inputs[j] ? std::vector<bool>(pk1Tag, pk1Tag + 3) : std::vector<bool>(pk0Tag, pk0Tag + 3),
+                     h_Ss[j], expectedMacs[j]);
+    }
+
+    // The scalar backend resumes from the cached rounds; the others do not
+    for (size_t b = 0; b < backends.size(); b++) {
+        sha256_set_backend(backends[b]);
+        libzerocash::PRF prf(a_sk);
+
+        std::vector<unsigned char> addr;
+        prf.addr(addr);
+        result &= (addr == expectedAddr);
+
+        for (size_t j = 0; j < numCoins; j++) {
+            libzerocash::SerialNumber sn;
+            libzerocash::PourMAC mac;
+            prf.sn(rhos[j], sn);
+            prf.pk(inputs[j], h_Ss[j], mac);
+            result &= (sn == expectedSns[j] && mac == expectedMacs[j]);
+        }
+
+        for (size_t count = 0; count <= numCoins; count++) {
+            std::vector<libzerocash::CoinNonce> someRhos(rhos.begin(), rhos.begin() + count);
+            std::vector<libzerocash::SerialNumber> sns;
+            std::vector<libzerocash::PourMAC> macs;
+            prf.sn(someRhos, sns);
+            result &= std::equal(sns.begin(), sns.end(), expectedSns.begin()) && sns.size() == count;
+
+            prf.snAndPk(someRhos, std::vector<size_t>(inputs.begin(), inputs.begin() + count),
+                        std::vector<libzerocash::SignatureHash>(h_Ss.begin(), h_Ss.begin() + count), sns, macs);
+            result &= std::equal(sns.begin(), sns.end(), expectedSns.begin()) && sns.size() == count;
+            result &= std::equal(macs.begin(), macs.end(), expectedMacs.begin()) && macs.size() == count;
+        }
+
+        if (!result) {
+            cout << "PRF: " << backends[b]->name << " differs" << endl;
+            break;
+        }
+    }
+
+    sha256_set_backend(defaultBackend);
+
+    return result;
+}
+
+bool FixedBytesTest(size_t numCoins) {
+    cout << "\nFIXED BYTES TEST\n" << endl;
+
+    bool result = true;
+
+    for (size_t j = 0; j < numCoins; j++) {
+        std::vector<unsigned char> val(v_size), k(k_size);
+        for (size_t i = 0; i < v_size; i++) {
+            val[i] = rand() & 0xff;
+        }
+        for (size_t i = 0; i < k_size; i++) {
+            k[i] = rand() & 0xff;
+        }
+
+        // The single-block commitment agrees with the bit vector one
+        libzerocash::CoinCommitment fromVectors(val, k);
+        libzerocash::CoinCommitment fromFixed = libzerocash::CoinCommitment(libzerocash::ValueBytes(val), libzerocash::InternalCommitment(k));
+        result &= (fromVectors == fromFixed);
+
+        // and serializes exactly as the vector it replaced
+        CDataStream fixedStream(SER_NETWORK, 7002), vectorStream(SER_NETWORK, 7002);
+        fixedStream << fromFixed;
+        vectorStream << fromFixed.getCommitmentValue().toVector();
+        result &= (fixedStream.str() == vectorStream.str());
+
+        libzerocash::CoinCommitment read;
+        fixedStream >> read;
+        result &= (read == fromFixed);
+    }
+
+    // Lengths other than the fixed one are refused
+    try {
+        libzerocash::SerialNumber sn(std::vector<unsigned char>(sn_size - 1));
+        result = false;
+    } catch (std::runtime_error &e) {
+    }
+
+    CDataStream shortStream(SER_NETWORK, 7002);
+    shortStream << std::vector<unsigned char>(cm_size - 1);
+    try {
+        libzerocash::CommitmentValue cm;
+        shortStream >> cm;
+        result = false;
+    } catch (std::ios_base::failure &e) {
+    }
+
+    return result;
+}
+
+bool CoinCommitmentTest(size_t maxCoins) {
+    cout << "\nCOIN COMMITMENT TEST\n" << endl;
+
+    const SHA256_BACKEND *defaultBackend = sha256_get_backend();
+    vector<const SHA256_BACKEND*> backends = libzerocash::HashProvider::available();
+    bool result = true;
+
+    std::vector< std::vector<unsigned char> > a_pks(maxCoins, std::vector<unsigned char>(a_pk_size));
+    std::vector<libzerocash::CoinNonce> rhos(maxCoins);
+    std::vector<libzerocash::CommitmentTrapdoor> rs(maxCoins);
+    std::vector<uint64_t> values(maxCoins);
+    for (size_t j = 0; j < maxCoins; j++) {
+        for (size_t i = 0; i < a_pk_size; i++) {
+            a_pks[j][i] = rand() & 0xff;
+        }
+        for (size_t i = 0; i < rho_size; i++) {
+            rhos[j][i] = rand() & 0xff;
+        }
+        for (size_t i = 0; i < zc_r_size; i++) {
+            rs[j][i] = rand() & 0xff;
+        }
+        values[j] = ((uint64_t)rand() << 32) | rand();
+    }
+
+    // k and cm one coin at a time, on byte vectors, as libzerocash::Coin used to
+    std::vector< std::vector<unsigned char> > expectedKs(maxCoins), expectedCms(maxCoins);
+    for (size_t j = 0; j < maxCoins; j++) {
+        std::vector<unsigned char> internal, outer, hash(k_size), value(v_size);
+        libzerocash::concatenateVectors(a_pks[j], rhos[j].toVector(), internal);
+        libzerocash::hashVector(internal, hash);
+        hash.resize(16);
+        libzerocash::concatenateVectors(rs[j].toVector(), hash, outer);
+        expectedKs[j].resize(k_size);
+        libzerocash::hashVector(outer, expectedKs[j]);
+
+        libzerocash::convertIntToBytesVector(values[j], value);
+        expectedCms[j] = libzerocash::CoinCommitment(value, expectedKs[j]).getCommitmentValue().toVector();
+    }
+
+    for (size_t b = 0; b < backends.size(); b++) {
+        sha256_set_backend(backends[b]);
+
+        for (size_t count = 0; count <= maxCoins; count++) {
+            std::vector<libzerocash::InternalCommitment> ks;
+            std::vector<libzerocash::MerkleDigest> cms;
+            libzerocash::Coin::computeCommitments(std::vector< std::vector<unsigned char> >(a_pks.begin(), a_pks.begin() + count),
+                                     std::vector<libzerocash::CoinNonce>(rhos.begin(), rhos.begin() + count),
+                                     std::vector<libzerocash::CommitmentTrapdoor>(rs.begin(), rs.begin() + count),
+                                     std::vector<uint64_t>(values.begin(), values.begin() + count),
+                                     ks, cms);
+
+            result &= (ks.size() == count && cms.size() == count);
+            for (size_t j = 0; result && j < count; j++) {
+                result &= (ks[j].toVector() == expectedKs[j]);
+                result &= std::equal(cms[j].begin(), cms[j].end(), expectedCms[j].begin());
+            }
+        }
+
+        if (!result) {
+            cout << "Coin commitments: " << backends[b]->name << " differs" << endl;
+            break;
+        }
+    }
+
+    sha256_set_backend(defaultBackend);
+
+    return result;
+}
+
+static SHA256_COUNTS hashCounts(SHA256_SITE site)
+{
+    SHA256_COUNTS counts;
+    sha256_stats_get(site, &counts);
+    return counts;
+}
+
+bool HashStatsTest() {
+    cout << "\nHASH COUNTER TEST\n" << endl;
+
+    bool result = true;
+    unsigned char block[64] = {0}, hash[SHA256_BLOCK_SIZE];
+    std::vector<unsigned char> a_sk(32, 1);
+
+    sha256_stats_reset();
+    sha256_two_to_one(block, block + 32, hash);
+    {
+        libzerocash::HashSiteScope tree(SHA256_SITE_TREE);
+        sha256_two_to_one(block, block + 32, hash);
+        sha256_compress_blocks(block, hash, 1);
+        {
+            libzerocash::HashSiteScope commitment(SHA256_SITE_COMMITMENT);
+            libzerocash::hashBytes(block, 64, hash);
+        }
+        sha256_two_to_one(block, block + 32, hash);
+    }
+
+    // libzerocash::PRF::snAndPk splits its work between serial numbers and MACs
+    libzerocash::PRF prf(a_sk);
+    std::vector<libzerocash::SerialNumber> sns;
+    std::vector<libzerocash::PourMAC> macs;
+    prf.snAndPk(std::vector<libzerocash::CoinNonce>(3), std::vector<size_t>(3, 1), std::vector<libzerocash::SignatureHash>(3), sns, macs);
+
+    // Hashing on another thread is counted against that thread's site
+    std::thread other([&block]() {
+        unsigned char otherHash[SHA256_BLOCK_SIZE];
+        sha256_two_to_one(block, block + 32, otherHash);
+    });
+    other.join();
+
+    if (sha256_stats_enabled()) {
+        result &= (hashCounts(SHA256_SITE_OTHER).compressions == 2 && hashCounts(SHA256_SITE_OTHER).bytes == 128);
+        result &= (hashCounts(SHA256_SITE_TREE).compressions == 3 && hashCounts(SHA256_SITE_TREE).bytes == 192);
+        result &= (hashCounts(SHA256_SITE_COMMITMENT).compressions == 1 && hashCounts(SHA256_SITE_COMMITMENT).bytes == 64);
+        result &= (hashCounts(SHA256_SITE_PRF).compressions == 3 && hashCounts(SHA256_SITE_MAC).compressions == 3);
+    } else {
+        for (int site = 0; site < SHA256_SITE_COUNT; site++) {
+            result &= (hashCounts((SHA256_SITE)site).compressions == 0 && hashCounts((SHA256_SITE)site).bytes == 0);
+        }
+    }
+
+    sha256_stats_reset();
+    result &= (hashCounts(SHA256_SITE_TREE).compressions == 0);
 
     return result;
 }
@@ -178,7 +472,7 @@ bool PourTxTest(const size_t tree_depth) {
 
     vector<bool> temp_comVal(cm_size * 8);
     for(size_t i = 0; i < coinValues.size(); i++) {
-        libzerocash::convertBytesVectorToVector(coins.at(i).getCoinCommitment().getCommitmentValue(), temp_comVal);
+        libzerocash::convertBytesToVector(coins.at(i).getCoinCommitment().getCommitmentValue().data(), temp_comVal);
         coinValues.at(i) = temp_comVal;
         libzerocash::printVectorAsHex("Coin => ", coinValues.at(i));
     }
@@ -260,6 +554,41 @@ bool PourTxTest(const size_t tree_depth) {
     bool pourtx_res = pourtxNew.verify(p, pubkeyHash, rt);
     libzerocash::timer_stop("Pour Transaction Verify");
 
+    // The last pour is checked against the wrong root, so only it must fail
+    vector<unsigned char> wrongRt(rt);
+    wrongRt[0] ^= 1;
+    vector<libzerocash::PourTransaction> pours = { pourtx, pourtxNew, pourtxNew };
+    vector<vector<unsigned char>> pubkeyHashes(pours.size(), pubkeyHash);
+    vector<vector<unsigned char>> rts = { rt, rt, wrongRt };
+    vector<bool> batchResults;
+
+    libzerocash::timer_start("Pour Transaction Batch Verify");
+    bool batch_res = libzerocash::PourTransaction::verifyBatch(p, pours, pubkeyHashes, rts, batchResults);
+    libzerocash::timer_stop("Pour Transaction Batch Verify");
+
+    pourtx_res &= !batch_res && batchResults == vector<bool>({ true, true, false });
+
+    pours.pop_back();
+    pubkeyHashes.pop_back();
+    rts.pop_back();
+    pourtx_res &= libzerocash::PourTransaction::verifyBatch(p, pours, pubkeyHashes, rts, batchResults);
+
+    // The same pours on the verification service, through both interfaces
+    {
+        libzerocash::PourVerificationService service(p, 2, 4);
+        std::future<bool> valid = service.verify(pourtxNew, pubkeyHash, rt);
+        std::future<bool> invalid = service.verify(pourtxNew, pubkeyHash, wrongRt);
+        std::promise<bool> callbackResult;
+        bool queued = service.tryVerify(pourtx, pubkeyHash, rt, [&callbackResult](bool result) { callbackResult.set_value(result); });
+
+        pourtx_res &= valid.get() && !invalid.get();
+        pourtx_res &= queued && callbackResult.get_future().get();
+
+        libzerocash::PourVerificationService::Metrics metrics = service.getMetrics();
+        cout << "Verification service: " << metrics.completed << " verified, p50 " << metrics.verifyP50
+             << "s, p99 " << metrics.verifyP99 << "s" << endl;
+    }
+
     return pourtx_res;
 }
 
@@ -282,7 +611,7 @@ bool MerkleTreeSimpleTest() {
 
     vector<bool> temp_comVal(cm_size * 8);
     for(size_t i = 0; i < coinValues.size(); i++) {
-        libzerocash::convertBytesVectorToVector(coins.at(i).getCoinCommitment().getCommitmentValue(), temp_comVal);
+        libzerocash::convertBytesToVector(coins.at(i).getCoinCommitment().getCommitmentValue().data(), temp_comVal);
         coinValues.at(i) = temp_comVal;
         libzerocash::printVectorAsHex(coinValues.at(i));
     }
@@ -415,7 +744,7 @@ bool SimpleTxTest(const size_t tree_depth) {
     vector<std::vector<bool>> coinValues(5);
     vector<bool> temp_comVal(cm_size * 8);
     for(size_t i = 0; i < coinValues.size(); i++) {
-        libzerocash::convertBytesVectorToVector(coins.at(i).getCoinCommitment().getCommitmentValue(), temp_comVal);
+        libzerocash::convertBytesToVector(coins.at(i).getCoinCommitment().getCommitmentValue().data(), temp_comVal);
         coinValues.at(i) = temp_comVal;
     }
 
@@ -523,7 +852,7 @@ bool ParamFilesTest(const size_t tree_depth, string pkFile, string vkFile) {
     vector<std::vector<bool>> coinValues(5);
     vector<bool> temp_comVal(cm_size * 8);
     for(size_t i = 0; i < coinValues.size(); i++) {
-        libzerocash::convertBytesVectorToVector(coins.at(i).getCoinCommitment().getCommitmentValue(), temp_comVal);
+        libzerocash::convertBytesToVector(coins.at(i).getCoinCommitment().getCommitmentValue().data(), temp_comVal);
         coinValues.at(i) = temp_comVal;
     }
 
@@ -598,16 +927,41 @@ int main(int argc, char **argv)
 
     start_profiling();
 	bool merkleSimpleResult = MerkleTreeSimpleTest();
+    libzerocash::printHashStats("MerkleTreeSimpleTest");
+    sha256_stats_reset();
     bool addressResult = AddressTest();
+    libzerocash::printHashStats("AddressTest");
+    sha256_stats_reset();
     bool coinResult = CoinTest();
+    libzerocash::printHashStats("CoinTest");
+    sha256_stats_reset();
+    bool prfResult = PRFTest(40);
+    libzerocash::printHashStats("PRFTest");
+    sha256_stats_reset();
+    bool fixedBytesResult = FixedBytesTest(40);
+    libzerocash::printHashStats("FixedBytesTest");
+    sha256_stats_reset();
+    bool coinCommitmentResult = CoinCommitmentTest(40);
+    libzerocash::printHashStats("CoinCommitmentTest");
+    sha256_stats_reset();
+    bool hashStatsResult = HashStatsTest();
     bool mintTxResult = MintTxTest();
+    libzerocash::printHashStats("MintTxTest");
+    sha256_stats_reset();
 
     bool pourTxResult = PourTxTest(tree_depth);
+    libzerocash::printHashStats("PourTxTest");
+    sha256_stats_reset();
     bool simpleTxResult = SimpleTxTest(tree_depth);
+    libzerocash::printHashStats("SimpleTxTest");
 
     cout << "\n" << endl;
     std::cout << "\nAddressTest result => " << addressResult << std::endl;
     std::cout << "\nCoinTest result => " << coinResult << std::endl;
+    std::cout << "\nPRFTest result => " << prfResult << std::endl;
+    std::cout << "\nFixedBytesTest result => " << fixedBytesResult << std::endl;
+    std::cout << "\nCoinCommitmentTest result => " << coinCommitmentResult << std::endl;
+    std::cout << "\nHashStatsTest result => " << hashStatsResult << std::endl;
     std::cout << "\nMerkleTreeSimpleTest result => " << merkleSimpleResult << std::endl;
     std::cout << "\nMintTxTest result => " << mintTxResult << std::endl;
     std::cout << "\nPourTxTest result => " << pourTxResult << std::endl;
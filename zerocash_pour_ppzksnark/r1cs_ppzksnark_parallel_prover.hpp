@@ -0,0 +1,72 @@
+/** @file
+ *****************************************************************************
+
+ Declaration of interfaces for a parallel prover for the R1CS ppzkSNARK.
+
+ This includes:
+ - the witness map of the R1CS-to-QAP reduction, on a thread pool
+ - the prover algorithm of the R1CS ppzkSNARK, on a thread pool
+
+ libsnark runs its prover on several cores only when built with OpenMP
+ (MULTICORE=1), which needs a static build and a specially built libsnark.
+ The functions here split the same work with libzerocash's ThreadPool, so
+ they work in ordinary builds:
+
+ - the linear combinations of the constraints are evaluated in chunks;
+ - the FFTs of the polynomials A, B and C run at the same time;
+ - each multi-exponentiation of the proof is split into chunks, which run
+   libsnark's serial multi-exponentiation and are summed at the end.
+
+ The proofs are distributed exactly like those of r1cs_ppzksnark_prover.
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef R1CS_PPZKSNARK_PARALLEL_PROVER_HPP_
+#define R1CS_PPZKSNARK_PARALLEL_PROVER_HPP_
+
+#include "libsnark/reductions/r1cs_to_qap/r1cs_to_qap.hpp"
+#include "libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp"
+#include "libzerocash/utils/ProfilingPause.h"
+#include "libzerocash/utils/ThreadPool.h"
+
+namespace libzerocash {
+
+using namespace libsnark;
+
+/**
+ * Smallest number of terms of a multi-exponentiation worth a chunk of its own.
+ */
+const size_t parallel_multi_exp_min_chunk = 1024;
+
+/**
+ * The witness map of the R1CS-to-QAP reduction, as r1cs_to_qap_witness_map,
+ * with the work split over the threads of 'pool'.
+ */
+template<typename FieldT>
+qap_witness<FieldT> r1cs_to_qap_witness_map_parallel(const r1cs_constraint_system<FieldT> &cs,
+                                                     const r1cs_primary_input<FieldT> &primary_input,
+                                                     const r1cs_auxiliary_input<FieldT> &auxiliary_input,
+                                                     const FieldT &d1,
+                                                     const FieldT &d2,
+                                                     const FieldT &d3,
+                                                     ThreadPool &pool);
+
+/**
+ * A prover algorithm for the R1CS ppzkSNARK, as r1cs_ppzksnark_prover, with
+ * the work split over the threads of 'pool'.
+ */
+template<typename ppT>
+r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_parallel_prover(const r1cs_ppzksnark_proving_key<ppT> &pk,
+                                                         const r1cs_ppzksnark_primary_input<ppT> &primary_input,
+                                                         const r1cs_ppzksnark_auxiliary_input<ppT> &auxiliary_input,
+                                                         ThreadPool &pool);
+
+} // libzerocash
+
+#include "zerocash_pour_ppzksnark/r1cs_ppzksnark_parallel_prover.tcc"
+
+#endif // R1CS_PPZKSNARK_PARALLEL_PROVER_HPP_
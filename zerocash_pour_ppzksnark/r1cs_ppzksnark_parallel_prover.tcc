@@ -0,0 +1,200 @@
+/** @file
+ *****************************************************************************
+
+ Implementation of interfaces for a parallel prover for the R1CS ppzkSNARK.
+
+ See r1cs_ppzksnark_parallel_prover.hpp .
+
+ *****************************************************************************
+ * @author     This file is part of libzerocash, developed by the Zerocash
+ *             project and contributors (see AUTHORS).
+ * @copyright  MIT license (see LICENSE file)
+ *****************************************************************************/
+
+#ifndef R1CS_PPZKSNARK_PARALLEL_PROVER_TCC_
+#define R1CS_PPZKSNARK_PARALLEL_PROVER_TCC_
+
+#include <functional>
+#include <mutex>
+
+#include "algebra/evaluation_domain/evaluation_domain.hpp"
+#include "algebra/scalar_multiplication/kc_multiexp.hpp"
+#include "algebra/scalar_multiplication/multiexp.hpp"
+#include "common/profiling.hpp"
+
+namespace libzerocash {
+
+/* the sum of chunk(lo, hi) over chunks that cover [begin, end) */
+template<typename T>
+T parallel_sum(ThreadPool &pool,
+               const size_t begin,
+               const size_t end,
+               const std::function<T(size_t, size_t)> &chunk)
+{
+    std::mutex sum_mutex;
+    T sum = T::zero();
+
+    pool.parallelFor(begin, end, parallel_multi_exp_min_chunk, [&](size_t lo, size_t hi) {
+        const T part = chunk(lo, hi);
+        std::lock_guard<std::mutex> lock(sum_mutex);
+        sum = sum + part;
+    });
+
+    return sum;
+}
+
+template<typename FieldT>
+qap_witness<FieldT> r1cs_to_qap_witness_map_parallel(const r1cs_constraint_system<FieldT> &cs,
+                                                     const r1cs_primary_input<FieldT> &primary_input,
+                                                     const r1cs_auxiliary_input<FieldT> &auxiliary_input,
+                                                     const FieldT &d1,
+                                                     const FieldT &d2,
+                                                     const FieldT &d3,
+                                                     ThreadPool &pool)
+{
+    /* sanity check */
+    assert(cs.is_satisfied(primary_input, auxiliary_input));
+
+    const std::shared_ptr<evaluation_domain<FieldT> > domain = get_evaluation_domain<FieldT>(cs.num_constraints() + cs.num_inputs() + 1);
+
+    r1cs_variable_assignment<FieldT> full_variable_assignment = primary_input;
+    full_variable_assignment.insert(full_variable_assignment.end(), auxiliary_input.begin(), auxiliary_input.end());
+
+    /* evaluations of the polynomials A, B and C on set S */
+    std::vector<FieldT> aA(domain->m, FieldT::zero()), aB(domain->m, FieldT::zero()), aC(domain->m, FieldT::zero());
+
+    /* account for the additional constraints input_i * 0 = 0 */
+    for (size_t i = 0; i <= cs.num_inputs(); ++i)
+    {
+        aA[i+cs.num_constraints()] = (i > 0 ? full_variable_assignment[i-1] : FieldT::one());
+    }
+    /* account for all other constraints */
+    pool.parallelFor(0, cs.num_constraints(), 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+        {
+            aA[i] += cs.constraints[i].a.evaluate(full_variable_assignment);
+            aB[i] += cs.constraints[i].b.evaluate(full_variable_assignment);
+            aC[i] += cs.constraints[i].c.evaluate(full_variable_assignment);
+        }
+    });
+
+    /* the three polynomials are independent, so their FFTs run side by side */
+    std::vector<FieldT>* const polynomials[3] = { &aA, &aB, &aC };
+    pool.parallelFor(0, 3, 1, [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; ++k)
+        {
+            domain->iFFT(*polynomials[k]);
+        }
+    });
+
+    /* add coefficients of the polynomial (d2*A + d1*B - d3) + d1*d2*Z */
+    std::vector<FieldT> coefficients_for_H(domain->m+1, FieldT::zero());
+    pool.parallelFor(0, domain->m, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+        {
+            coefficients_for_H[i] = d2*aA[i] + d1*aB[i];
+        }
+    });
+    coefficients_for_H[0] -= d3;
+    domain->add_poly_Z(d1*d2, coefficients_for_H);
+
+    /* evaluations of A, B and C on set T */
+    pool.parallelFor(0, 3, 1, [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; ++k)
+        {
+            domain->cosetFFT(*polynomials[k], FieldT::multiplicative_generator);
+        }
+    });
+
+    /* evaluation of H on set T; can overwrite aA because it is not used later */
+    std::vector<FieldT> &H_tmp = aA;
+    pool.parallelFor(0, domain->m, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+        {
+            H_tmp[i] = aA[i]*aB[i] - aC[i];
+        }
+    });
+    std::vector<FieldT>().swap(aB); // destroy aB
+    std::vector<FieldT>().swap(aC); // destroy aC
+
+    domain->divide_by_Z_on_coset(H_tmp);
+    domain->icosetFFT(H_tmp, FieldT::multiplicative_generator);
+
+    /* sum of H and the ZK-patch */
+    pool.parallelFor(0, domain->m, 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i)
+        {
+            coefficients_for_H[i] += H_tmp[i];
+        }
+    });
+
+    return qap_witness<FieldT>(cs.num_variables(), domain->m, cs.num_inputs(), d1, d2, d3, full_variable_assignment, std::move(coefficients_for_H));
+}
+
+template<typename ppT>
+r1cs_ppzksnark_proof<ppT> r1cs_ppzksnark_parallel_prover(const r1cs_ppzksnark_proving_key<ppT> &pk,
+                                                         const r1cs_ppzksnark_primary_input<ppT> &primary_input,
+                                                         const r1cs_ppzksnark_auxiliary_input<ppT> &auxiliary_input,
+                                                         ThreadPool &pool)
+{
+    typedef Fr<ppT> FieldT;
+    typedef typename std::vector<FieldT>::const_iterator scalar_iterator;
+
+    enter_block("Call to r1cs_ppzksnark_parallel_prover");
+
+    const FieldT d1 = FieldT::random_element(),
+        d2 = FieldT::random_element(),
+        d3 = FieldT::random_element();
+
+    knowledge_commitment<G1<ppT>, G1<ppT> > g_A;
+    knowledge_commitment<G2<ppT>, G1<ppT> > g_B;
+    knowledge_commitment<G1<ppT>, G1<ppT> > g_C;
+    G1<ppT> g_H;
+    G1<ppT> g_K;
+
+    {
+        /* libsnark enters profiling blocks inside the FFTs and multi-exponentiations that run on the pool */
+        ProfilingPause pause;
+
+        const qap_witness<FieldT> qap_wit = r1cs_to_qap_witness_map_parallel(pk.constraint_system, primary_input, auxiliary_input, d1, d2, d3, pool);
+        const size_t num_variables = qap_wit.num_variables();
+        const scalar_iterator ABCs = qap_wit.coefficients_for_ABCs.begin();
+        const scalar_iterator Hs = qap_wit.coefficients_for_H.begin();
+
+        /* the multi-exponentiations of r1cs_ppzksnark_prover, each split into chunks of variables [lo, hi) */
+        g_A = pk.A_query[0] + qap_wit.d1*pk.A_query[num_variables+1] +
+            parallel_sum<knowledge_commitment<G1<ppT>, G1<ppT> > >(pool, 0, num_variables, [&](size_t lo, size_t hi) {
+                return kc_multi_exp_with_mixed_addition<G1<ppT>, G1<ppT>, FieldT>(pk.A_query, 1+lo, 1+hi, ABCs+lo, ABCs+hi, 1, true);
+            });
+
+        g_B = pk.B_query[0] + qap_wit.d2*pk.B_query[num_variables+1] +
+            parallel_sum<knowledge_commitment<G2<ppT>, G1<ppT> > >(pool, 0, num_variables, [&](size_t lo, size_t hi) {
+                return kc_multi_exp_with_mixed_addition<G2<ppT>, G1<ppT>, FieldT>(pk.B_query, 1+lo, 1+hi, ABCs+lo, ABCs+hi, 1, true);
+            });
+
+        g_C = pk.C_query[0] + qap_wit.d3*pk.C_query[num_variables+1] +
+            parallel_sum<knowledge_commitment<G1<ppT>, G1<ppT> > >(pool, 0, num_variables, [&](size_t lo, size_t hi) {
+                return kc_multi_exp_with_mixed_addition<G1<ppT>, G1<ppT>, FieldT>(pk.C_query, 1+lo, 1+hi, ABCs+lo, ABCs+hi, 1, true);
+            });
+
+        g_H = parallel_sum<G1<ppT> >(pool, 0, qap_wit.degree()+1, [&](size_t lo, size_t hi) {
+                return multi_exp<G1<ppT>, FieldT>(pk.H_query.begin()+lo, pk.H_query.begin()+hi, Hs+lo, Hs+hi, 1, true);
+            });
+
+        g_K = (pk.K_query[0] +
+               qap_wit.d1*pk.K_query[num_variables+1] +
+               qap_wit.d2*pk.K_query[num_variables+2] +
+               qap_wit.d3*pk.K_query[num_variables+3]) +
+            parallel_sum<G1<ppT> >(pool, 0, num_variables, [&](size_t lo, size_t hi) {
+                return multi_exp_with_mixed_addition<G1<ppT>, FieldT>(pk.K_query.begin()+1+lo, pk.K_query.begin()+1+hi, ABCs+lo, ABCs+hi, 1, true);
+            });
+    }
+
+    leave_block("Call to r1cs_ppzksnark_parallel_prover");
+
+    return r1cs_ppzksnark_proof<ppT>(std::move(g_A), std::move(g_B), std::move(g_C), std::move(g_H), std::move(g_K));
+}
+
+} // libzerocash
+
+#endif // R1CS_PPZKSNARK_PARALLEL_PROVER_TCC_
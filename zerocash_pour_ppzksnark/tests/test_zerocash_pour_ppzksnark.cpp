@@ -306,6 +306,102 @@ void test_zerocash_pour_ppzksnark(const size_t num_old_coins, const size_t num_n
                                                                            proof);
     printf("Verification result: %s\n", verification_result ? "pass" : "FAIL");
     assert(verification_result);
+
+    /* a reusable prover builds the circuit once and gives proofs that verify every time, on one thread or several */
+    zerocash_pour_prover<ppT> prover(keypair.pk);
+    for (size_t round = 0; round < 3; ++round)
+    {
+        if (round == 2)
+        {
+            prover.set_num_threads(4);
+        }
+
+        const zerocash_pour_proof<ppT> reused_proof = prover.prove(old_coin_authentication_paths,
+                                                                   old_coin_merkle_tree_positions,
+                                                                   merkle_tree_root,
+                                                                   new_address_public_keys,
+                                                                   old_address_secret_keys,
+                                                                   new_address_commitment_nonces,
+                                                                   old_address_commitment_nonces,
+                                                                   new_coin_serial_number_nonces,
+                                                                   old_coin_serial_number_nonces,
+                                                                   new_coin_values,
+                                                                   public_value,
+                                                                   old_coin_values,
+                                                                   signature_public_key_hash);
+
+        const bool reused_verification_result = zerocash_pour_ppzksnark_verifier<ppT>(keypair.vk,
+                                                                                      merkle_tree_root,
+                                                                                      old_coin_serial_numbers,
+                                                                                      new_coin_commitments,
+                                                                                      public_value,
+                                                                                      signature_public_key_hash,
+                                                                                      signature_public_key_hash_macs,
+                                                                                      reused_proof);
+        printf("Verification result with a reused prover (round %zu, %zu threads): %s\n", round, prover.get_num_threads(), reused_verification_result ? "pass" : "FAIL");
+        assert(reused_verification_result);
+    }
+
+    /* a processed verification key gives the same result */
+    const r1cs_ppzksnark_primary_input<ppT> primary_input = zerocash_pour_input_map<FieldT>(num_old_coins,
+                                                                                           num_new_coins,
+                                                                                           merkle_tree_root,
+                                                                                           old_coin_serial_numbers,
+                                                                                           new_coin_commitments,
+                                                                                           public_value,
+                                                                                           signature_public_key_hash,
+                                                                                           signature_public_key_hash_macs);
+    const zerocash_pour_processed_verification_key<ppT> pvk = zerocash_pour_ppzksnark_verifier_process_vk<ppT>(keypair.vk);
+    const bool online_verification_result = zerocash_pour_ppzksnark_online_verifier<ppT>(pvk, primary_input, proof);
+    printf("Online verification result: %s\n", online_verification_result ? "pass" : "FAIL");
+    assert(online_verification_result);
+
+    /* batch verification finds the one proof checked against a wrong input */
+    r1cs_ppzksnark_primary_input<ppT> wrong_primary_input = primary_input;
+    wrong_primary_input[0] = wrong_primary_input[0] + FieldT::one();
+
+    std::vector<bool> batch_results;
+    const bool batch_verification_result = zerocash_pour_ppzksnark_batch_verifier<ppT>(keypair.vk,
+                                                                                      { primary_input, primary_input, primary_input },
+                                                                                      { proof, proof, proof },
+                                                                                      batch_results);
+    printf("Batch verification result: %s\n", batch_verification_result ? "pass" : "FAIL");
+    assert(batch_verification_result);
+
+    const bool wrong_batch_verification_result = zerocash_pour_ppzksnark_batch_verifier<ppT>(pvk,
+                                                                                            { primary_input, wrong_primary_input, primary_input },
+                                                                                            { proof, proof, proof },
+                                                                                            batch_results);
+    printf("Batch verification result with a wrong input: %s\n", !wrong_batch_verification_result ? "pass" : "FAIL");
+    assert(!wrong_batch_verification_result);
+    assert(batch_results == std::vector<bool>({ true, false, true }));
+
+    /* and the proofs that fail for other reasons: a forged proof, and an input of the wrong size */
+    zerocash_pour_proof<ppT> forged_proof = proof;
+    forged_proof.g_K = forged_proof.g_K + G1<ppT>::one();
+    r1cs_ppzksnark_primary_input<ppT> short_primary_input = primary_input;
+    short_primary_input.pop_back();
+
+    const bool mixed_batch_verification_result = zerocash_pour_ppzksnark_batch_verifier<ppT>(pvk,
+                                                                                            { primary_input, primary_input, short_primary_input, primary_input },
+                                                                                            { proof, forged_proof, proof, proof },
+                                                                                            batch_results);
+    printf("Batch verification result with a forged proof: %s\n", !mixed_batch_verification_result ? "pass" : "FAIL");
+    assert(!mixed_batch_verification_result);
+    assert(batch_results == std::vector<bool>({ true, false, false, true }));
+
+    /* two forged proofs whose changes cancel out when the proofs are added up do not pass together */
+    zerocash_pour_proof<ppT> forged_proof_plus = proof, forged_proof_minus = proof;
+    forged_proof_plus.g_H = forged_proof_plus.g_H + G1<ppT>::one();
+    forged_proof_minus.g_H = forged_proof_minus.g_H - G1<ppT>::one();
+
+    const bool cancelling_batch_verification_result = zerocash_pour_ppzksnark_batch_verifier<ppT>(pvk,
+                                                                                                 { primary_input, primary_input, primary_input },
+                                                                                                 { proof, forged_proof_plus, forged_proof_minus },
+                                                                                                 batch_results);
+    printf("Batch verification result with forged proofs that cancel out: %s\n", !cancelling_batch_verification_result ? "pass" : "FAIL");
+    assert(!cancelling_batch_verification_result);
+    assert(batch_results == std::vector<bool>({ true, false, false }));
 }
 
 int main(int argc, const char * argv[])
@@ -7,10 +7,14 @@
  - class for proving key
  - class for verification key
  - class for key pair (proving key & verification key)
+ - class for processed verification key
  - class for proof
  - generator algorithm
  - prover algorithm
+ - class for a reusable prover
  - verifier algorithm
+ - verification key processing and online verifier algorithm
+ - batch verifier algorithm
 
  The ppzkSNARK is obtained by using an R1CS ppzkSNARK relative to an R1CS
  realization of the NP statement "Pour". The implementation follows, extends,
@@ -39,8 +43,13 @@
 #ifndef ZEROCASH_POUR_PPZKSNARK_HPP_
 #define ZEROCASH_POUR_PPZKSNARK_HPP_
 
+#include <memory>
+#include <mutex>
+
 #include "libsnark/common/data_structures/merkle_tree.hpp"
 #include "libsnark/zk_proof_systems/ppzksnark/r1cs_ppzksnark/r1cs_ppzksnark.hpp"
+#include "zerocash_pour_ppzksnark/r1cs_ppzksnark_parallel_prover.hpp"
+#include "zerocash_pour_ppzksnark/zerocash_pour_gadget.hpp"
 
 namespace libzerocash {
 
@@ -166,6 +175,32 @@ public:
     friend std::istream& operator>> <ppzksnark_ppT>(std::istream &in, zerocash_pour_keypair<ppzksnark_ppT> &pk);
 };
 
+/************************ Processed verification key *************************/
+
+/**
+ * A processed verification key for the Pour ppzkSNARK.
+ *
+ * Holds the Miller-loop precomputations for the fixed points of a
+ * verification key, which every verification would otherwise redo.
+ */
+template<typename ppzksnark_ppT>
+class zerocash_pour_processed_verification_key {
+public:
+    size_t num_old_coins;
+    size_t num_new_coins;
+    r1cs_ppzksnark_processed_verification_key<ppzksnark_ppT> r1cs_pvk;
+
+    zerocash_pour_processed_verification_key() = default;
+    zerocash_pour_processed_verification_key(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &other) = default;
+    zerocash_pour_processed_verification_key(zerocash_pour_processed_verification_key<ppzksnark_ppT> &&other) = default;
+    zerocash_pour_processed_verification_key(const size_t num_old_coins,
+                                             const size_t num_new_coins,
+                                             r1cs_ppzksnark_processed_verification_key<ppzksnark_ppT> &&r1cs_pvk) :
+        num_old_coins(num_old_coins), num_new_coins(num_new_coins),
+        r1cs_pvk(std::move(r1cs_pvk)) {}
+    zerocash_pour_processed_verification_key<ppzksnark_ppT>& operator=(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &other) = default;
+};
+
 /*********************************** Proof ***********************************/
 
 /**
@@ -191,7 +226,8 @@ zerocash_pour_keypair<ppzksnark_ppT> zerocash_pour_ppzksnark_generator(const siz
 /**
  * A prover algorithm for the Pour ppzkSNARK.
  *
- * TODO: add description
+ * Builds the Pour circuit for this proof only; see zerocash_pour_prover for
+ * proving repeatedly with the same key.
  */
 template<typename ppzksnark_ppT>
 zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_ppzksnark_prover(const zerocash_pour_proving_key<ppzksnark_ppT> &pk,
@@ -209,6 +245,61 @@ zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_ppzksnark_prover(const zerocash
                                                                   const std::vector<bit_vector> &old_coin_values,
                                                                   const bit_vector &signature_public_key_hash);
 
+/********************************** Prover ***********************************/
+
+/**
+ * A reusable prover for the Pour ppzkSNARK.
+ *
+ * The Pour circuit depends only on (num_old_coins, num_new_coins, tree_depth),
+ * so the prover builds the protoboard, the gadget and its constraints once,
+ * when constructed, and each call to prove only regenerates the witness.
+ * The result is the same as that of zerocash_pour_ppzksnark_prover, which
+ * builds a throwaway prover on every call.
+ *
+ * The constraint system stays in memory for the lifetime of the prover, and
+ * the proving key must outlive it. A prover holds the witness of the proof
+ * in progress, so calls to prove from several threads take turns.
+ *
+ * A prover with more than one thread computes each proof with
+ * r1cs_ppzksnark_parallel_prover on a pool of its own, so that it uses
+ * several cores without an OpenMP build of libsnark.
+ */
+template<typename ppzksnark_ppT>
+class zerocash_pour_prover {
+public:
+    typedef Fr<ppzksnark_ppT> FieldT;
+
+    /* 0 threads means one per hardware thread */
+    explicit zerocash_pour_prover(const zerocash_pour_proving_key<ppzksnark_ppT> &pk,
+                                  const size_t num_threads = 1);
+    zerocash_pour_prover(const zerocash_pour_prover<ppzksnark_ppT> &other) = delete;
+    zerocash_pour_prover<ppzksnark_ppT>& operator=(const zerocash_pour_prover<ppzksnark_ppT> &other) = delete;
+
+    void set_num_threads(const size_t num_threads);
+    size_t get_num_threads() const;
+
+    zerocash_pour_proof<ppzksnark_ppT> prove(const std::vector<merkle_authentication_path> &old_coin_authentication_paths,
+                                             const std::vector<size_t> &old_coin_merkle_tree_positions,
+                                             const bit_vector &merkle_tree_root,
+                                             const std::vector<bit_vector> &new_address_public_keys,
+                                             const std::vector<bit_vector> &old_address_secret_keys,
+                                             const std::vector<bit_vector> &new_address_commitment_nonces,
+                                             const std::vector<bit_vector> &old_address_commitment_nonces,
+                                             const std::vector<bit_vector> &new_coin_serial_number_nonces,
+                                             const std::vector<bit_vector> &old_coin_serial_number_nonces,
+                                             const std::vector<bit_vector> &new_coin_values,
+                                             const bit_vector &public_value,
+                                             const std::vector<bit_vector> &old_coin_values,
+                                             const bit_vector &signature_public_key_hash);
+
+private:
+    const zerocash_pour_proving_key<ppzksnark_ppT> &pk;
+    protoboard<FieldT> pb; // must be constructed before g, which refers to it
+    zerocash_pour_gadget<FieldT> g;
+    std::unique_ptr<ThreadPool> pool; // none when proving on the calling thread only
+    mutable std::mutex mutex; // held while pb holds a witness, or while pool changes
+};
+
 /**
  * A verifier algorithm for the Pour ppzkSNARK.
  */
@@ -222,6 +313,59 @@ bool zerocash_pour_ppzksnark_verifier(const zerocash_pour_verification_key<ppzks
                                       const std::vector<bit_vector> &signature_public_key_hash_macs,
                                       const zerocash_pour_proof<ppzksnark_ppT> &proof);
 
+/**
+ * A verifier algorithm for the Pour ppzkSNARK, given the primary input
+ * computed by zerocash_pour_input_map.
+ */
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_verifier(const zerocash_pour_verification_key<ppzksnark_ppT> &vk,
+                                      const r1cs_ppzksnark_primary_input<ppzksnark_ppT> &primary_input,
+                                      const zerocash_pour_proof<ppzksnark_ppT> &proof);
+
+/**
+ * Converts a verification key into a processed verification key.
+ */
+template<typename ppzksnark_ppT>
+zerocash_pour_processed_verification_key<ppzksnark_ppT> zerocash_pour_ppzksnark_verifier_process_vk(const zerocash_pour_verification_key<ppzksnark_ppT> &vk);
+
+/**
+ * A verifier algorithm for the Pour ppzkSNARK that takes a processed
+ * verification key, and otherwise accepts the same proofs as
+ * zerocash_pour_ppzksnark_verifier.
+ */
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_online_verifier(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &pvk,
+                                             const r1cs_ppzksnark_primary_input<ppzksnark_ppT> &primary_input,
+                                             const zerocash_pour_proof<ppzksnark_ppT> &proof);
+
+/**
+ * A batch verifier algorithm for the Pour ppzkSNARK.
+ *
+ * Verifies each proof against its primary input, all under the same
+ * verification key. The pairing checks of all the proofs are combined with
+ * random 128-bit coefficients into a single product of Miller loops, which
+ * takes one final exponentiation instead of five per proof. A batch with an
+ * invalid proof passes only with negligible probability; if the combined
+ * check fails, the proofs are verified one by one to find the invalid ones.
+ *
+ * Sets results[i] to whether proof i is valid, and returns true if all are.
+ */
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_batch_verifier(const zerocash_pour_verification_key<ppzksnark_ppT> &vk,
+                                            const std::vector<r1cs_ppzksnark_primary_input<ppzksnark_ppT> > &primary_inputs,
+                                            const std::vector<zerocash_pour_proof<ppzksnark_ppT> > &proofs,
+                                            std::vector<bool> &results);
+
+/**
+ * A batch verifier algorithm for the Pour ppzkSNARK that takes a processed
+ * verification key.
+ */
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_batch_verifier(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &pvk,
+                                            const std::vector<r1cs_ppzksnark_primary_input<ppzksnark_ppT> > &primary_inputs,
+                                            const std::vector<zerocash_pour_proof<ppzksnark_ppT> > &proofs,
+                                            std::vector<bool> &results);
+
 } // libzerocash
 
 #include "zerocash_pour_ppzksnark/zerocash_pour_ppzksnark.tcc"
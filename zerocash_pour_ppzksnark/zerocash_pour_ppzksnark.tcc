@@ -14,7 +14,9 @@
 #ifndef ZEROCASH_POUR_PPZKSNARK_TCC_
 #define ZEROCASH_POUR_PPZKSNARK_TCC_
 
-#include "zerocash_pour_ppzksnark/zerocash_pour_gadget.hpp"
+#include <algorithm>
+#include <random>
+
 #include "common/profiling.hpp"
 
 namespace libzerocash {
@@ -140,28 +142,54 @@ zerocash_pour_keypair<ppzksnark_ppT> zerocash_pour_ppzksnark_generator(const siz
 }
 
 template<typename ppzksnark_ppT>
-zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_ppzksnark_prover(const zerocash_pour_proving_key<ppzksnark_ppT> &pk,
-                                                                  const std::vector<merkle_authentication_path> &old_coin_authentication_paths,
-                                                                  const std::vector<size_t> &old_coin_merkle_tree_positions,
-                                                                  const bit_vector &merkle_tree_root,
-                                                                  const std::vector<bit_vector> &new_address_public_keys,
-                                                                  const std::vector<bit_vector> &old_address_secret_keys,
-                                                                  const std::vector<bit_vector> &new_address_commitment_nonces,
-                                                                  const std::vector<bit_vector> &old_address_commitment_nonces,
-                                                                  const std::vector<bit_vector> &new_coin_serial_number_nonces,
-                                                                  const std::vector<bit_vector> &old_coin_serial_number_nonces,
-                                                                  const std::vector<bit_vector> &new_coin_values,
-                                                                  const bit_vector &public_value,
-                                                                  const std::vector<bit_vector> &old_coin_values,
-                                                                  const bit_vector &signature_public_key_hash)
+zerocash_pour_prover<ppzksnark_ppT>::zerocash_pour_prover(const zerocash_pour_proving_key<ppzksnark_ppT> &pk,
+                                                          const size_t num_threads) :
+    pk(pk),
+    pb(),
+    g(pb, pk.num_old_coins, pk.num_new_coins, pk.tree_depth, "zerocash_pour")
 {
-    typedef Fr<ppzksnark_ppT> FieldT;
+    enter_block("Generating Pour constraint system for the prover");
+    g.generate_r1cs_constraints();
+    leave_block("Generating Pour constraint system for the prover");
 
-    enter_block("Call to zerocash_pour_ppzksnark_prover");
+    set_num_threads(num_threads);
+}
 
-    protoboard<FieldT> pb;
-    zerocash_pour_gadget<FieldT > g(pb, pk.num_old_coins, pk.num_new_coins, pk.tree_depth, "zerocash_pour");
-    g.generate_r1cs_constraints();
+template<typename ppzksnark_ppT>
+void zerocash_pour_prover<ppzksnark_ppT>::set_num_threads(const size_t num_threads)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    pool.reset(num_threads != 1 ? new ThreadPool(num_threads) : nullptr);
+}
+
+template<typename ppzksnark_ppT>
+size_t zerocash_pour_prover<ppzksnark_ppT>::get_num_threads() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    /* the thread that calls prove works alongside the workers of the pool */
+    return (pool ? pool->size() + 1 : 1);
+}
+
+template<typename ppzksnark_ppT>
+zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_prover<ppzksnark_ppT>::prove(const std::vector<merkle_authentication_path> &old_coin_authentication_paths,
+                                                                              const std::vector<size_t> &old_coin_merkle_tree_positions,
+                                                                              const bit_vector &merkle_tree_root,
+                                                                              const std::vector<bit_vector> &new_address_public_keys,
+                                                                              const std::vector<bit_vector> &old_address_secret_keys,
+                                                                              const std::vector<bit_vector> &new_address_commitment_nonces,
+                                                                              const std::vector<bit_vector> &old_address_commitment_nonces,
+                                                                              const std::vector<bit_vector> &new_coin_serial_number_nonces,
+                                                                              const std::vector<bit_vector> &old_coin_serial_number_nonces,
+                                                                              const std::vector<bit_vector> &new_coin_values,
+                                                                              const bit_vector &public_value,
+                                                                              const std::vector<bit_vector> &old_coin_values,
+                                                                              const bit_vector &signature_public_key_hash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    enter_block("Call to zerocash_pour_prover::prove");
+
+    /* every variable of the gadget is assigned anew, so nothing is left over from the previous proof */
     g.generate_r1cs_witness(old_coin_authentication_paths,
                             old_coin_merkle_tree_positions,
                             merkle_tree_root,
@@ -176,7 +204,47 @@ zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_ppzksnark_prover(const zerocash
                             old_coin_values,
                             signature_public_key_hash);
     assert(pb.is_satisfied());
-    zerocash_pour_proof<ppzksnark_ppT> proof = r1cs_ppzksnark_prover<ppzksnark_ppT>(pk.r1cs_pk, pb.primary_input(), pb.auxiliary_input());
+    zerocash_pour_proof<ppzksnark_ppT> proof = (pool ?
+                                                r1cs_ppzksnark_parallel_prover<ppzksnark_ppT>(pk.r1cs_pk, pb.primary_input(), pb.auxiliary_input(), *pool) :
+                                                r1cs_ppzksnark_prover<ppzksnark_ppT>(pk.r1cs_pk, pb.primary_input(), pb.auxiliary_input()));
+
+    leave_block("Call to zerocash_pour_prover::prove");
+
+    return proof;
+}
+
+template<typename ppzksnark_ppT>
+zerocash_pour_proof<ppzksnark_ppT> zerocash_pour_ppzksnark_prover(const zerocash_pour_proving_key<ppzksnark_ppT> &pk,
+                                                                  const std::vector<merkle_authentication_path> &old_coin_authentication_paths,
+                                                                  const std::vector<size_t> &old_coin_merkle_tree_positions,
+                                                                  const bit_vector &merkle_tree_root,
+                                                                  const std::vector<bit_vector> &new_address_public_keys,
+                                                                  const std::vector<bit_vector> &old_address_secret_keys,
+                                                                  const std::vector<bit_vector> &new_address_commitment_nonces,
+                                                                  const std::vector<bit_vector> &old_address_commitment_nonces,
+                                                                  const std::vector<bit_vector> &new_coin_serial_number_nonces,
+                                                                  const std::vector<bit_vector> &old_coin_serial_number_nonces,
+                                                                  const std::vector<bit_vector> &new_coin_values,
+                                                                  const bit_vector &public_value,
+                                                                  const std::vector<bit_vector> &old_coin_values,
+                                                                  const bit_vector &signature_public_key_hash)
+{
+    enter_block("Call to zerocash_pour_ppzksnark_prover");
+
+    zerocash_pour_prover<ppzksnark_ppT> prover(pk);
+    zerocash_pour_proof<ppzksnark_ppT> proof = prover.prove(old_coin_authentication_paths,
+                                                            old_coin_merkle_tree_positions,
+                                                            merkle_tree_root,
+                                                            new_address_public_keys,
+                                                            old_address_secret_keys,
+                                                            new_address_commitment_nonces,
+                                                            old_address_commitment_nonces,
+                                                            new_coin_serial_number_nonces,
+                                                            old_coin_serial_number_nonces,
+                                                            new_coin_values,
+                                                            public_value,
+                                                            old_coin_values,
+                                                            signature_public_key_hash);
 
     leave_block("Call to zerocash_pour_ppzksnark_prover");
 
@@ -204,12 +272,180 @@ bool zerocash_pour_ppzksnark_verifier(const zerocash_pour_verification_key<ppzks
                                                                              public_value,
                                                                              signature_public_key_hash,
                                                                              signature_public_key_hash_macs);
-    const bool ans = r1cs_ppzksnark_verifier_strong_IC<ppzksnark_ppT>(vk.r1cs_vk, input, proof);
+    const bool ans = zerocash_pour_ppzksnark_verifier<ppzksnark_ppT>(vk, input, proof);
     leave_block("Call to zerocash_pour_ppzksnark_verifier");
 
     return ans;
 }
 
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_verifier(const zerocash_pour_verification_key<ppzksnark_ppT> &vk,
+                                      const r1cs_ppzksnark_primary_input<ppzksnark_ppT> &primary_input,
+                                      const zerocash_pour_proof<ppzksnark_ppT> &proof)
+{
+    return r1cs_ppzksnark_verifier_strong_IC<ppzksnark_ppT>(vk.r1cs_vk, primary_input, proof);
+}
+
+template<typename ppzksnark_ppT>
+zerocash_pour_processed_verification_key<ppzksnark_ppT> zerocash_pour_ppzksnark_verifier_process_vk(const zerocash_pour_verification_key<ppzksnark_ppT> &vk)
+{
+    enter_block("Call to zerocash_pour_ppzksnark_verifier_process_vk");
+    zerocash_pour_processed_verification_key<ppzksnark_ppT> pvk(vk.num_old_coins,
+                                                                vk.num_new_coins,
+                                                                r1cs_ppzksnark_verifier_process_vk<ppzksnark_ppT>(vk.r1cs_vk));
+    leave_block("Call to zerocash_pour_ppzksnark_verifier_process_vk");
+
+    return pvk;
+}
+
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_online_verifier(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &pvk,
+                                             const r1cs_ppzksnark_primary_input<ppzksnark_ppT> &primary_input,
+                                             const zerocash_pour_proof<ppzksnark_ppT> &proof)
+{
+    return r1cs_ppzksnark_online_verifier_strong_IC<ppzksnark_ppT>(pvk.r1cs_pvk, primary_input, proof);
+}
+
+/* a random coefficient of 128 bits for the batch verifier, from the system's entropy source */
+template<typename FieldT>
+FieldT zerocash_pour_batch_coefficient(std::random_device &rd)
+{
+    const FieldT two_to_32 = FieldT(1l << 32);
+    FieldT r = FieldT::zero();
+    for (size_t i = 0; i < 4; ++i)
+    {
+        r = r * two_to_32 + FieldT(rd(), true);
+    }
+
+    return r;
+}
+
+/*
+ * The pairing checks of the r1cs_ppzksnark verifier, for the proofs of the
+ * batch at once. Each check of each proof gets its own random coefficient,
+ * and the terms of each check are gathered by the fixed point they are
+ * paired with, so that the batch costs one Miller loop per proof (the QAP
+ * check pairs two points of the proof) plus eight.
+ */
+template<typename ppzksnark_ppT>
+bool zerocash_pour_batch_pairing_check(const r1cs_ppzksnark_processed_verification_key<ppzksnark_ppT> &pvk,
+                                       const std::vector<r1cs_ppzksnark_primary_input<ppzksnark_ppT> > &primary_inputs,
+                                       const std::vector<zerocash_pour_proof<ppzksnark_ppT> > &proofs,
+                                       const std::vector<size_t> &batch)
+{
+    typedef Fr<ppzksnark_ppT> FieldT;
+
+    std::random_device rd;
+
+    G1<ppzksnark_ppT> A_alphaA = G1<ppzksnark_ppT>::zero();       /* paired with alphaA_g2 */
+    G2<ppzksnark_ppT> B_alphaB = G2<ppzksnark_ppT>::zero();       /* paired with alphaB_g1 */
+    G1<ppzksnark_ppT> C_alphaC = G1<ppzksnark_ppT>::zero();       /* paired with alphaC_g2 */
+    G1<ppzksnark_ppT> G2_one_terms = G1<ppzksnark_ppT>::zero();   /* paired with the G2 generator */
+    G1<ppzksnark_ppT> H_rC_Z = G1<ppzksnark_ppT>::zero();         /* paired with rC_Z_g2 */
+    G1<ppzksnark_ppT> K_gamma = G1<ppzksnark_ppT>::zero();        /* paired with gamma_g2 */
+    G1<ppzksnark_ppT> AC_gamma_beta = G1<ppzksnark_ppT>::zero();  /* paired with gamma_beta_g2 */
+    G2<ppzksnark_ppT> B_gamma_beta = G2<ppzksnark_ppT>::zero();   /* paired with gamma_beta_g1 */
+    Fqk<ppzksnark_ppT> QAP_A_B = Fqk<ppzksnark_ppT>::one();
+
+    for (const size_t i : batch)
+    {
+        const zerocash_pour_proof<ppzksnark_ppT> &proof = proofs[i];
+        const G1<ppzksnark_ppT> acc = pvk.encoded_IC_query.template accumulate_chunk<FieldT>(primary_inputs[i].begin(), primary_inputs[i].end(), 0).first;
+        const G1<ppzksnark_ppT> A_acc = proof.g_A.g + acc;
+
+        const FieldT r_A = zerocash_pour_batch_coefficient<FieldT>(rd);
+        const FieldT r_B = zerocash_pour_batch_coefficient<FieldT>(rd);
+        const FieldT r_C = zerocash_pour_batch_coefficient<FieldT>(rd);
+        const FieldT r_QAP = zerocash_pour_batch_coefficient<FieldT>(rd);
+        const FieldT r_K = zerocash_pour_batch_coefficient<FieldT>(rd);
+
+        /* knowledge commitments: e(A, alphaA) = e(A', 1), e(alphaB, B) = e(B', 1), e(C, alphaC) = e(C', 1) */
+        A_alphaA = A_alphaA + r_A * proof.g_A.g;
+        B_alphaB = B_alphaB + r_B * proof.g_B.g;
+        C_alphaC = C_alphaC + r_C * proof.g_C.g;
+        G2_one_terms = G2_one_terms + r_A * proof.g_A.h + r_B * proof.g_B.h + r_C * proof.g_C.h;
+
+        /* QAP divisibility: e(A + acc, B) = e(H, rC_Z) * e(C, 1) */
+        QAP_A_B = QAP_A_B * ppzksnark_ppT::miller_loop(ppzksnark_ppT::precompute_G1(r_QAP * A_acc),
+                                                       ppzksnark_ppT::precompute_G2(proof.g_B.g));
+        H_rC_Z = H_rC_Z + r_QAP * proof.g_H;
+        G2_one_terms = G2_one_terms + r_QAP * proof.g_C.g;
+
+        /* same coefficients: e(K, gamma) = e(A + acc + C, gamma beta) * e(gamma beta, B) */
+        K_gamma = K_gamma + r_K * proof.g_K;
+        AC_gamma_beta = AC_gamma_beta + r_K * (A_acc + proof.g_C.g);
+        B_gamma_beta = B_gamma_beta + r_K * proof.g_B.g;
+    }
+
+    /* right-hand sides are negated, so all the checks together hold if the product is one */
+    const Fqk<ppzksnark_ppT> product =
+        QAP_A_B *
+        ppzksnark_ppT::double_miller_loop(ppzksnark_ppT::precompute_G1(A_alphaA), pvk.vk_alphaA_g2_precomp,
+                                          pvk.vk_alphaB_g1_precomp, ppzksnark_ppT::precompute_G2(B_alphaB)) *
+        ppzksnark_ppT::double_miller_loop(ppzksnark_ppT::precompute_G1(C_alphaC), pvk.vk_alphaC_g2_precomp,
+                                          ppzksnark_ppT::precompute_G1(-G2_one_terms), pvk.pp_G2_one_precomp) *
+        ppzksnark_ppT::double_miller_loop(ppzksnark_ppT::precompute_G1(-H_rC_Z), pvk.vk_rC_Z_g2_precomp,
+                                          ppzksnark_ppT::precompute_G1(K_gamma), pvk.vk_gamma_g2_precomp) *
+        ppzksnark_ppT::double_miller_loop(ppzksnark_ppT::precompute_G1(-AC_gamma_beta), pvk.vk_gamma_beta_g2_precomp,
+                                          pvk.vk_gamma_beta_g1_precomp, ppzksnark_ppT::precompute_G2(-B_gamma_beta));
+
+    return ppzksnark_ppT::final_exponentiation(product) == GT<ppzksnark_ppT>::one();
+}
+
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_batch_verifier(const zerocash_pour_verification_key<ppzksnark_ppT> &vk,
+                                            const std::vector<r1cs_ppzksnark_primary_input<ppzksnark_ppT> > &primary_inputs,
+                                            const std::vector<zerocash_pour_proof<ppzksnark_ppT> > &proofs,
+                                            std::vector<bool> &results)
+{
+    return zerocash_pour_ppzksnark_batch_verifier<ppzksnark_ppT>(zerocash_pour_ppzksnark_verifier_process_vk<ppzksnark_ppT>(vk),
+                                                                 primary_inputs, proofs, results);
+}
+
+template<typename ppzksnark_ppT>
+bool zerocash_pour_ppzksnark_batch_verifier(const zerocash_pour_processed_verification_key<ppzksnark_ppT> &zerocash_pour_pvk,
+                                            const std::vector<r1cs_ppzksnark_primary_input<ppzksnark_ppT> > &primary_inputs,
+                                            const std::vector<zerocash_pour_proof<ppzksnark_ppT> > &proofs,
+                                            std::vector<bool> &results)
+{
+    enter_block("Call to zerocash_pour_ppzksnark_batch_verifier");
+    assert(primary_inputs.size() == proofs.size());
+
+    const r1cs_ppzksnark_processed_verification_key<ppzksnark_ppT> &pvk = zerocash_pour_pvk.r1cs_pvk;
+
+    /* proofs that fail the checks without pairings are left out of the batch */
+    results.assign(proofs.size(), false);
+    std::vector<size_t> batch;
+    for (size_t i = 0; i < proofs.size(); ++i)
+    {
+        if (primary_inputs[i].size() == pvk.encoded_IC_query.domain_size() && proofs[i].is_well_formed())
+        {
+            batch.emplace_back(i);
+        }
+    }
+
+    if (batch.empty() || zerocash_pour_batch_pairing_check<ppzksnark_ppT>(pvk, primary_inputs, proofs, batch))
+    {
+        for (const size_t i : batch)
+        {
+            results[i] = true;
+        }
+    }
+    else
+    {
+        enter_block("Verify the proofs of a failed batch one by one");
+        for (const size_t i : batch)
+        {
+            results[i] = r1cs_ppzksnark_online_verifier_strong_IC<ppzksnark_ppT>(pvk, primary_inputs[i], proofs[i]);
+        }
+        leave_block("Verify the proofs of a failed batch one by one");
+    }
+
+    leave_block("Call to zerocash_pour_ppzksnark_batch_verifier");
+
+    return std::find(results.begin(), results.end(), false) == results.end();
+}
+
 } // libzerocash
 
 #endif // ZEROCASH_POUR_PPZKSNARK_TCC_